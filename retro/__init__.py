@@ -2,7 +2,18 @@ import os
 import sys
 
 import retro.data
-from retro._retro import Movie, RetroEmulator, core_path
+from retro._retro import (
+    OUTPUT_ALL,
+    OUTPUT_AUDIO,
+    OUTPUT_RAM,
+    OUTPUT_VIDEO,
+    Movie,
+    Replay,
+    RetroEmulator,
+    SnapshotPool,
+    VecRetroEmulator,
+    core_path,
+)
 from retro.enums import Actions, Observations, State
 from retro.retro_env import RetroEnv
 
@@ -15,7 +26,14 @@ with open(os.path.join(os.path.dirname(__file__), "VERSION.txt")) as f:
 
 __all__ = [
     "Movie",
+    "Replay",
     "RetroEmulator",
+    "VecRetroEmulator",
+    "SnapshotPool",
+    "OUTPUT_ALL",
+    "OUTPUT_AUDIO",
+    "OUTPUT_RAM",
+    "OUTPUT_VIDEO",
     "Actions",
     "State",
     "Observations",
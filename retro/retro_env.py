@@ -1,4 +1,3 @@
-import gc
 import gzip
 import json
 import os
@@ -29,10 +28,18 @@ class RetroEnv(gym.Env):
         info=None,
         use_restricted_actions=retro.Actions.FILTERED,
         record=False,
+        record_format="bk2",
         players=1,
         inttype=retro.data.Integrations.STABLE,
         obs_type=retro.Observations.IMAGE,
         render_mode="human",
+        screen_buffers=0,
+        obs_size=None,
+        grayscale=False,
+        frame_stack=1,
+        frame_skip=1,
+        max_pool=False,
+        info_array=False,
     ):
         if not hasattr(self, "spec"):
             self.spec = None
@@ -45,6 +52,32 @@ class RetroEnv(gym.Env):
         self.initial_state = None
         self.players = players
 
+        # Observations are rendered into a ring of reused buffers if requested,
+        # each one only valid until the ring wraps around
+        self._screen_ring = [None] * screen_buffers
+        self._screen_index = 0
+
+        # Image observations can be converted to grayscale, area-downscaled to
+        # obs_size (height, width) and stacked along a new leading axis. This
+        # all happens natively in the same pass that converts the frame.
+        self.obs_size = tuple(obs_size) if obs_size else None
+        self.grayscale = grayscale
+        self.frame_stack = frame_stack
+        self._frames = None
+
+        # Each step repeats the action for frame_skip frames natively, summing
+        # rewards until the scenario is done and optionally max-pooling the
+        # last two screens. The repeat always runs to the end, since only the
+        # last screens are rendered
+        self.frame_skip = frame_skip
+        self.max_pool = max_pool
+
+        # info can carry every variable as one reused int64 array instead of a
+        # dict; data.variable_index() maps names to positions in it. Only
+        # variables declared in the data file have positions, so this fails
+        # once a script or data.set_value() has made a custom value
+        self.info_array = info_array
+
         # Don't return multiple rewards in multiplayer mode by default
         # as stable-baselines3 vectorized environments doesn't support it
         self.multi_rewards = False
@@ -96,9 +129,6 @@ class RetroEnv(gym.Env):
 
         self.system = retro.get_romfile_system(rom_path)
 
-        # We can't have more than one emulator per process. Before creating an
-        # emulator, ensure that unused ones are garbage-collected
-        gc.collect()
         self.em = retro.RetroEmulator(rom_path)
         self.em.configure_data(self.data)
         self.em.step()
@@ -135,8 +165,8 @@ class RetroEnv(gym.Env):
         if self._obs_type == retro.Observations.RAM:
             shape = self.get_ram().shape
         else:
-            img = [self.get_screen(p) for p in range(players)]
-            shape = img[0].shape
+            shape = self.get_observation().shape
+            self._frames = None
         self.observation_space = gym.spaces.Box(
             low=0,
             high=255,
@@ -149,18 +179,21 @@ class RetroEnv(gym.Env):
         self.movie_id = 0
         self.movie_path = None
         if record is True:
-            self.auto_record()
+            self.auto_record(movie_format=record_format)
         elif record is not False:
-            self.auto_record(record)
+            self.auto_record(record, record_format)
 
         self.render_mode = render_mode
+        self._outputs = retro.OUTPUT_ALL
+        if self._obs_type == retro.Observations.RAM and render_mode is None:
+            self._outputs &= ~retro.OUTPUT_VIDEO
 
     def _update_obs(self):
         if self._obs_type == retro.Observations.RAM:
             self.ram = self.get_ram()
             return self.ram
         elif self._obs_type == retro.Observations.IMAGE:
-            self.img = self.get_screen()
+            self.img = self.get_observation()
             return self.img
         else:
             raise ValueError(f"Unrecognized observation type: {self._obs_type}")
@@ -196,17 +229,17 @@ class RetroEnv(gym.Env):
             raise RuntimeError("Please call env.reset() before env.step()")
 
         for p, ap in enumerate(self.action_to_array(a)):
-            if self.movie:
-                for i in range(self.num_buttons):
-                    self.movie.set_key(i, ap[i], p)
             self.em.set_button_mask(ap, p)
 
-        if self.movie:
-            self.movie.step()
-        self.em.step()
-        self.data.update_ram()
+        rewards, done = self.em.step(
+            self.frame_skip,
+            self.data,
+            self.max_pool,
+            self.movie,
+            self._outputs,
+        )
         ob = self._update_obs()
-        rew, done, info = self.compute_step()
+        rew, done, info = self.compute_step(rewards, done)
 
         if self.render_mode == "human":
             self.render()
@@ -226,12 +259,14 @@ class RetroEnv(gym.Env):
             self.record_movie(
                 os.path.join(
                     self.movie_path,
-                    "%s-%s-%06d.bk2" % (self.gamename, rel_statename, self.movie_id),
+                    "%s-%s-%06d.%s"
+                    % (self.gamename, rel_statename, self.movie_id, self.movie_format),
                 ),
             )
             self.movie_id += 1
         if self.movie:
             self.movie.step()
+        self._frames = None
         self.data.reset()
         self.data.update_ram()
 
@@ -243,7 +278,10 @@ class RetroEnv(gym.Env):
     def render(self):
         mode = self.render_mode
 
-        img = self.get_screen() if self.img is None else self.img
+        if self.img is None or self.grayscale or self.obs_size or self.frame_stack > 1:
+            img = self.get_screen()
+        else:
+            img = self.img
         if mode == "rgb_array":
             return img
         elif mode == "human":
@@ -274,26 +312,53 @@ class RetroEnv(gym.Env):
         self.data.set_value(name, val)
 
     def get_ram(self):
-        blocks = []
-        for offset in sorted(self.data.memory.blocks):
-            arr = np.frombuffer(self.data.memory.blocks[offset], dtype=np.uint8)
-            blocks.append(arr)
-        return np.concatenate(blocks)
+        memory = self.data.memory
+        ram = self._screen_buffer((memory.size,))
+        memory.gather(ram)
+        return ram
 
-    def get_screen(self, player=0):
-        img = self.em.get_screen()
+    def _screen_rect(self, player=0):
         x, y, w, h = self.data.crop_info(player)
-        if not w or x + w > img.shape[1]:
-            w = img.shape[1]
-        else:
-            w += x
-        if not h or y + h > img.shape[0]:
-            h = img.shape[0]
-        else:
-            h += y
-        if x == 0 and y == 0 and w == img.shape[1] and h == img.shape[0]:
+        width, height = self.em.get_resolution()
+        if not w or x + w > width:
+            w = width - x
+        if not h or y + h > height:
+            h = height - y
+        return x, y, w, h
+
+    def _screen_buffer(self, shape):
+        if not self._screen_ring:
+            return np.empty(shape, np.uint8)
+        img = self._screen_ring[self._screen_index]
+        if img is None or img.shape != shape:
+            img = np.empty(shape, np.uint8)
+            self._screen_ring[self._screen_index] = img
+        self._screen_index = (self._screen_index + 1) % len(self._screen_ring)
+        return img
+
+    def get_screen(self, player=0):
+        x, y, w, h = self._screen_rect(player)
+        img = self._screen_buffer((h, w, 3))
+        self.em.get_screen_into(img, x, y, w, h)
+        return img
+
+    def get_observation(self, player=0):
+        x, y, w, h = self._screen_rect(player)
+        shape = self.obs_size or (h, w)
+        if not self.grayscale:
+            shape += (3,)
+        if self.frame_stack <= 1:
+            img = self._screen_buffer(shape)
+            self.em.get_screen_into(img, x, y, w, h)
             return img
-        return img[y:h, x:w]
+        if self._frames is None or self._frames.shape[1:] != shape:
+            self._frames = np.empty((self.frame_stack,) + shape, np.uint8)
+            self.em.get_screen_into(self._frames[-1], x, y, w, h)
+            self._frames[:-1] = self._frames[-1]
+        else:
+            self._frames[:-1] = self._frames[1:]
+            self.em.get_screen_into(self._frames[-1], x, y, w, h)
+        return self._frames.copy()
 
     def load_state(self, statename, inttype=retro.data.Integrations.DEFAULT):
         if not statename.endswith(".state"):
@@ -307,12 +372,17 @@ class RetroEnv(gym.Env):
 
         self.statename = statename
 
-    def compute_step(self):
+    def compute_step(self, rewards=None, done=None):
+        if rewards is None:
+            rewards = [self.data.current_reward(p) for p in range(self.players)]
+        if done is None:
+            done = self.data.is_done()
         if self.players > 1 and self.multi_rewards:
-            reward = [self.data.current_reward(p) for p in range(self.players)]
+            reward = rewards[: self.players]
         else:
-            reward = self.data.current_reward()
-        done = self.data.is_done()
+            reward = rewards[0]
+        if self.info_array:
+            return reward, done, {"variables": self.data.lookup_array()}
         return reward, done, self.data.lookup_all()
 
     def record_movie(self, path):
@@ -328,7 +398,12 @@ class RetroEnv(gym.Env):
             self.movie.close()
             self.movie = None
 
-    def auto_record(self, path=None):
+    def auto_record(self, path=None, movie_format="bk2"):
+        # Movies are written as BK2 or as RMV, which embeds keyframes for
+        # seeking; Movie picks the format from the file extension
+        if movie_format not in ("bk2", "rmv"):
+            raise ValueError(f"Unrecognized movie format: {movie_format}")
         if not path:
             path = os.getcwd()
         self.movie_path = path
+        self.movie_format = movie_format
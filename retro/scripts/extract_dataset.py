@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+import argparse
+import os
+import sys
+
+import retro
+
+
+def find_movies(paths):
+    movies = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, dirs, files in os.walk(path):
+                dirs.sort()
+                movies.extend(
+                    os.path.join(root, f)
+                    for f in sorted(files)
+                    if os.path.splitext(f)[1] in (".bk2", ".rmv")
+                )
+        else:
+            movies.append(path)
+    return movies
+
+
+def extract_dataset(
+    movies,
+    output_dir,
+    threads=0,
+    chunk_frames=1000,
+    format="npz",
+    observations=True,
+    rewards=True,
+    compression=-1,
+    inttype=retro.data.Integrations.ALL,
+):
+    """
+    Replay movies in parallel and write each one's frames to numbered shards
+    of numpy arrays in output_dir, laid out like the movies' directories.
+    Returns one result dict per movie.
+    """
+    outputs = 0
+    if observations:
+        outputs |= retro.OUTPUT_VIDEO
+    if rewards:
+        outputs |= retro.OUTPUT_RAM
+    replay = retro.Replay(threads, chunk_frames, format, outputs, compression)
+    os.makedirs(output_dir, exist_ok=True)
+    results = []
+
+    def fail(movie, error):
+        results.append(
+            {"movie": movie, "ok": False, "frames": 0, "shards": [], "error": error},
+        )
+
+    # Shards are named by each movie's path below the deepest directory all
+    # the movies share, so movies with the same file name don't collide
+    root = os.path.commonpath([os.path.dirname(os.path.abspath(m)) for m in movies] or ["."])
+    prefixes = set()
+    for movie in movies:
+        name = os.path.splitext(os.path.relpath(os.path.abspath(movie), root))[0]
+        prefix = os.path.join(output_dir, name)
+        if prefix in prefixes:
+            fail(movie, "Another movie already writes to " + prefix)
+            continue
+        try:
+            game = retro.Movie(movie).get_game()
+            rom = retro.data.get_romfile_path(game, inttype)
+        except (RuntimeError, FileNotFoundError) as e:
+            fail(movie, str(e))
+            continue
+        prefixes.add(prefix)
+        os.makedirs(os.path.dirname(prefix), exist_ok=True)
+        replay.add(
+            movie,
+            rom,
+            prefix,
+            data=retro.data.get_file_path(game, "data.json", inttype),
+            scenario=retro.data.get_file_path(game, "scenario.json", inttype),
+        )
+    return results + replay.run()
+
+
+def main(argv=sys.argv[1:]):
+    parser = argparse.ArgumentParser(
+        description="Replay movies and write their frames as numpy shards",
+    )
+    parser.add_argument("movies", type=str, nargs="+", help="movie files or directories")
+    parser.add_argument("--output", "-o", type=str, default=".")
+    parser.add_argument("--jobs", "-j", type=int, default=0)
+    parser.add_argument("--chunk-frames", "-n", type=int, default=1000)
+    parser.add_argument("--format", "-f", choices=["npz", "npy"], default="npz")
+    parser.add_argument("--no-video", "-V", action="store_true")
+    parser.add_argument("--no-rewards", "-R", action="store_true")
+    parser.add_argument(
+        "--compression",
+        "-z",
+        type=int,
+        default=-1,
+        choices=range(-1, 10),
+        help="npz deflate level, 0 to store uncompressed",
+    )
+    args = parser.parse_args(argv)
+
+    results = extract_dataset(
+        find_movies(args.movies),
+        args.output,
+        threads=args.jobs,
+        chunk_frames=args.chunk_frames,
+        format=args.format,
+        observations=not args.no_video,
+        rewards=not args.no_rewards,
+        compression=args.compression,
+    )
+    failed = 0
+    for result in results:
+        if not result["ok"]:
+            failed += 1
+            print("{}: {}".format(result["movie"], result["error"]), file=sys.stderr)
+    print(
+        "Wrote {} frames from {} movies".format(
+            sum(r["frames"] for r in results),
+            len(results) - failed,
+        ),
+    )
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,110 @@
+#include "audio.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Retro;
+using namespace std;
+
+void AudioBuffer::configure(double inputRate, double fps, double outputRate, unsigned channels, size_t capacity) {
+	if (outputRate <= 0 || inputRate <= 0) {
+		outputRate = inputRate;
+	}
+	if (!capacity) {
+		size_t perFrame = fps > 0 ? ceil(outputRate / fps) : 0;
+		capacity = max<size_t>(perFrame * 8, 1024);
+	}
+	m_capacity = 1;
+	while (m_capacity < capacity) {
+		m_capacity <<= 1;
+	}
+	m_channels = channels == 1 ? 1 : 2;
+	m_outputRate = outputRate;
+	m_step = outputRate != inputRate ? inputRate / outputRate : 0;
+	m_buffer.assign(m_capacity * 2 * m_channels, 0);
+	m_head = 0;
+	m_frames = 0;
+	m_phase = 0;
+	m_primed = false;
+}
+
+void AudioBuffer::begin() {
+	m_frames = 0;
+}
+
+const int16_t* AudioBuffer::data() const {
+	size_t start = (m_head + m_capacity - m_frames) & (m_capacity - 1);
+	return &m_buffer[start * m_channels];
+}
+
+void AudioBuffer::push(int16_t left, int16_t right) {
+	size_t low = m_head * m_channels;
+	size_t high = (m_head + m_capacity) * m_channels;
+	if (m_channels == 1) {
+		int16_t mono = (int(left) + int(right)) >> 1;
+		m_buffer[low] = mono;
+		m_buffer[high] = mono;
+	} else {
+		m_buffer[low] = left;
+		m_buffer[low + 1] = right;
+		m_buffer[high] = left;
+		m_buffer[high + 1] = right;
+	}
+	m_head = (m_head + 1) & (m_capacity - 1);
+	if (m_frames < m_capacity) {
+		++m_frames;
+	}
+}
+
+void AudioBuffer::write(int16_t left, int16_t right) {
+	int16_t frame[2] = { left, right };
+	write(frame, 1);
+}
+
+void AudioBuffer::write(const int16_t* stereo, size_t frames) {
+	if (!m_capacity) {
+		return;
+	}
+	if (m_step) {
+		for (size_t i = 0; i < frames; ++i) {
+			const int16_t* cur = &stereo[i * 2];
+			if (!m_primed) {
+				m_prev[0] = cur[0];
+				m_prev[1] = cur[1];
+				m_primed = true;
+				continue;
+			}
+			for (; m_phase < 1; m_phase += m_step) {
+				int16_t left = lround(m_prev[0] + (cur[0] - m_prev[0]) * m_phase);
+				int16_t right = lround(m_prev[1] + (cur[1] - m_prev[1]) * m_phase);
+				push(left, right);
+			}
+			m_phase -= 1;
+			m_prev[0] = cur[0];
+			m_prev[1] = cur[1];
+		}
+		return;
+	}
+	if (m_channels == 1) {
+		for (size_t i = 0; i < frames; ++i) {
+			push(stereo[i * 2], stereo[i * 2 + 1]);
+		}
+		return;
+	}
+
+	// Stereo at the native rate is stored as-is
+	m_frames = min(m_frames + frames, m_capacity);
+	if (frames > m_capacity) {
+		stereo += (frames - m_capacity) * 2;
+		frames = m_capacity;
+	}
+	while (frames) {
+		size_t chunk = min(frames, m_capacity - m_head);
+		memcpy(&m_buffer[m_head * 2], stereo, chunk * 4);
+		memcpy(&m_buffer[(m_head + m_capacity) * 2], stereo, chunk * 4);
+		m_head = (m_head + chunk) & (m_capacity - 1);
+		stereo += chunk * 2;
+		frames -= chunk;
+	}
+}
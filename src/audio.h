@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Retro {
+
+// Fixed-capacity ring of audio frames. Every frame is stored twice, one
+// capacity apart, so the most recent frames are always contiguous and can be
+// handed out without copying. Stereo input can be downmixed to mono and
+// linearly resampled as it is written.
+class AudioBuffer {
+public:
+	// A rate or capacity of 0 keeps the input rate or picks a capacity that
+	// holds several video frames of audio
+	void configure(double inputRate, double fps, double outputRate = 0, unsigned channels = 2, size_t capacity = 0);
+
+	// Starts a new span; data() and frames() only cover what is written after
+	void begin();
+
+	void write(const int16_t* stereo, size_t frames);
+	void write(int16_t left, int16_t right);
+
+	const int16_t* data() const;
+	size_t frames() const { return m_frames; }
+	unsigned channels() const { return m_channels; }
+	double rate() const { return m_outputRate; }
+	size_t capacity() const { return m_capacity; }
+
+private:
+	void push(int16_t left, int16_t right);
+
+	std::vector<int16_t> m_buffer;
+	size_t m_capacity = 0;
+	size_t m_head = 0;
+	size_t m_frames = 0;
+	unsigned m_channels = 2;
+	double m_outputRate = 0;
+
+	// Resampler state; m_step is 0 when the rate is unchanged
+	double m_step = 0;
+	double m_phase = 0;
+	int16_t m_prev[2]{};
+	bool m_primed = false;
+};
+}
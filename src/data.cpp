@@ -94,6 +94,7 @@ bool GameData::load(istream* file) {
 	for (auto var = info->cbegin(); var != info->cend(); ++var) {
 		if (var->find("address") == var->cend() || var->find("type") == var->cend()) {
 			oldVars.swap(m_vars);
+			compileVariables();
 			return false;
 		}
 		string dtype = var->at("type");
@@ -102,11 +103,13 @@ bool GameData::load(istream* file) {
 		}
 		try {
 			Variable v(dtype, var->at("address"), var->value("mask", UINT64_MAX));
-			setVariable(var.key(), v);
+			m_vars.erase(var.key());
+			m_vars.emplace(var.key(), v);
 		} catch (std::out_of_range) {
 			continue;
 		}
 	}
+	compileVariables();
 	return true;
 }
 
@@ -158,6 +161,12 @@ void GameData::reset() {
 	m_lastMem.reset();
 	m_cloneMem.reset();
 	m_vars.clear();
+	m_compiledVars.clear();
+	m_varSlots.clear();
+	m_slotNames.clear();
+	m_samples[0].clear();
+	m_samples[1].clear();
+	++m_varsVersion;
 	m_searches.clear();
 	m_searchOldMem.clear();
 }
@@ -167,8 +176,61 @@ void GameData::restart() {
 }
 
 void GameData::updateRam() {
-	m_lastMem = move(m_cloneMem);
-	m_cloneMem.clone(m_mem);
+	if (m_compiledLayout != m_mem.layout()) {
+		compileVariables();
+	}
+	if (m_fullRamHistory) {
+		m_lastMem = move(m_cloneMem);
+		m_cloneMem.clone(m_mem);
+		return;
+	}
+	m_currentSamples ^= 1;
+	vector<Sample>& samples = m_samples[m_currentSamples];
+	for (size_t i = 0; i < m_compiledVars.size(); ++i) {
+		samples[i] = sample(i);
+	}
+}
+
+void GameData::setFullRamHistory(bool full) {
+	m_fullRamHistory = full;
+	m_lastMem.reset();
+	m_cloneMem.reset();
+	for (auto& samples : m_samples) {
+		samples.assign(m_compiledVars.size(), {});
+	}
+}
+
+void GameData::compileVariables() {
+	vector<CompiledVariable> compiled;
+	unordered_map<string, size_t> slots;
+	vector<Sample> samples[2];
+	compiled.reserve(m_vars.size());
+	m_slotNames.clear();
+	for (const auto& var : m_vars) {
+		slots.emplace(var.first, compiled.size());
+		m_slotNames.push_back(var.first);
+		compiled.emplace_back(m_mem.compile(var.second));
+		// Samples hold decoded values, so they survive a layout change
+		const auto& old = m_varSlots.find(var.first);
+		bool same = old != m_varSlots.end() && m_compiledVars[old->second].var == var.second;
+		for (unsigned i = 0; i < 2; ++i) {
+			samples[i].push_back(same ? m_samples[i][old->second] : Sample{});
+		}
+	}
+	m_compiledVars = move(compiled);
+	m_varSlots = move(slots);
+	m_samples[0] = move(samples[0]);
+	m_samples[1] = move(samples[1]);
+	m_compiledLayout = m_mem.layout();
+	++m_varsVersion;
+}
+
+GameData::Sample GameData::sample(size_t slot) const {
+	try {
+		return { m_mem.read(m_compiledVars[slot]), true };
+	} catch (out_of_range&) {
+		return {};
+	}
 }
 
 void GameData::setTypes(const vector<DataType> types) {
@@ -212,11 +274,11 @@ Variant GameData::lookupValue(const string& name) const {
 	if (variant != m_customVars.end()) {
 		return *variant->second;
 	}
-	auto v = m_vars.find(name);
-	if (v == m_vars.end()) {
+	auto v = m_varSlots.find(name);
+	if (v == m_varSlots.end()) {
 		throw invalid_argument(name);
 	}
-	return m_mem[v->second];
+	return m_mem.read(m_compiledVars[v->second]);
 }
 
 Datum GameData::lookupValue(const TypedSearchResult& result) {
@@ -228,18 +290,47 @@ int64_t GameData::lookupValue(const TypedSearchResult& result) const {
 }
 
 int64_t GameData::lookupDelta(const string& name) const {
-	const auto& v = m_vars.find(name);
-	if (v == m_vars.end()) {
+	const auto& v = m_varSlots.find(name);
+	if (v == m_varSlots.end()) {
 		return 0;
 	}
-	int64_t newVal = m_cloneMem[v->second];
+	return slotDelta(v->second);
+}
 
-	if (!m_lastMem.ok()) {
-		return 0;
+size_t GameData::variableSlot(const string& name) const {
+	const auto& v = m_varSlots.find(name);
+	if (v == m_varSlots.end()) {
+		return SIZE_MAX;
 	}
-	int64_t oldVal = m_lastMem[v->second];
+	return v->second;
+}
 
-	return newVal - oldVal;
+int64_t GameData::slotValue(size_t slot) const {
+	return m_mem.read(m_compiledVars[slot]);
+}
+
+int64_t GameData::slotDelta(size_t slot) const {
+	if (m_fullRamHistory) {
+		const CompiledVariable& var = m_compiledVars[slot];
+		int64_t newVal = m_cloneMem.read(var);
+
+		if (!m_lastMem.ok()) {
+			return 0;
+		}
+		int64_t oldVal = m_lastMem.read(var);
+
+		return newVal - oldVal;
+	}
+
+	const Sample& newVal = m_samples[m_currentSamples][slot];
+	const Sample& oldVal = m_samples[m_currentSamples ^ 1][slot];
+	if (!newVal.mapped) {
+		throw out_of_range("No known mapping");
+	}
+	if (!oldVal.mapped) {
+		return 0;
+	}
+	return newVal.value - oldVal.value;
 }
 
 unordered_map<string, Datum> GameData::lookupAll() {
@@ -258,9 +349,9 @@ unordered_map<string, Datum> GameData::lookupAll() {
 
 unordered_map<string, int64_t> GameData::lookupAll() const {
 	unordered_map<string, int64_t> data;
-	for (auto var = m_vars.cbegin(); var != m_vars.cend(); ++var) {
+	for (auto var = m_varSlots.cbegin(); var != m_varSlots.cend(); ++var) {
 		try {
-			data.emplace(var->first, m_mem[var->second]);
+			data.emplace(var->first, m_mem.read(m_compiledVars[var->second]));
 		} catch (...) {
 		}
 	}
@@ -270,6 +361,12 @@ unordered_map<string, int64_t> GameData::lookupAll() const {
 	return data;
 }
 
+void GameData::lookupAll(int64_t* values) const {
+	for (size_t i = 0; i < m_compiledVars.size(); ++i) {
+		values[i] = sample(i).value;
+	}
+}
+
 void GameData::setValue(const std::string& name, int64_t v) {
 	auto variant = m_customVars.find(name);
 	if (variant != m_customVars.end()) {
@@ -307,15 +404,21 @@ Variable GameData::getVariable(const string& name) const {
 }
 
 void GameData::setVariable(const string& name, const Variable& var) {
-	removeVariable(name);
+	m_vars.erase(name);
 	m_vars.emplace(name, var);
+	compileVariables();
+	// A variable declared between updates has no sample from the last one, so
+	// its current value is the best estimate
+	size_t slot = m_varSlots[name];
+	Sample& current = m_samples[m_currentSamples][slot];
+	if (!current.mapped) {
+		current = sample(slot);
+	}
 }
 
 void GameData::removeVariable(const string& name) {
-	auto iter = m_vars.find(name);
-	if (iter != m_vars.end()) {
-		m_vars.erase(iter);
-	}
+	m_vars.erase(name);
+	compileVariables();
 }
 
 unordered_map<string, Variable> GameData::listVariables() const {
@@ -499,10 +602,7 @@ bool Scenario::load(istream* file, const std::string& path) {
 		}
 
 		const auto& condition = done->find("condition");
-		m_doneCondition = DoneCondition::ANY;
-		if (condition != done->cend() && *condition == "all") {
-			m_doneCondition = DoneCondition::ALL;
-		}
+		setDoneCondition(condition != done->cend() && *condition == "all" ? DoneCondition::ALL : DoneCondition::ANY);
 
 		const auto& script = done->find("script");
 		if (script != done->cend()) {
@@ -781,6 +881,7 @@ void Scenario::reset() {
 	}
 	m_doneVars.clear();
 	m_doneCondition = DoneCondition::ANY;
+	m_dirty = true;
 }
 
 bool Scenario::loadScript(const string& filename, const string& scope) {
@@ -847,10 +948,27 @@ void Scenario::restart() {
 }
 
 void Scenario::update() {
-	m_done = calculateDone();
-	for (unsigned i = 0; i < MAX_PLAYERS; ++i) {
-		m_reward[i] = calculateReward(i);
-		m_totalReward[i] += m_reward[i];
+	if (m_dirty || m_compiledVersion != m_data.variablesVersion()) {
+		m_compiled = compile();
+	}
+	// Script-set custom values can shadow memory variables, so they take the
+	// interpreted path
+	if (m_compiled && !m_data.hasCustomValues()) {
+		for (size_t i = 0; i < m_slots.size(); ++i) {
+			m_values[i] = m_data.slotValue(m_slots[i]);
+			m_deltas[i] = m_data.slotDelta(m_slots[i]);
+		}
+		m_done = evaluateDone();
+		for (unsigned i = 0; i < MAX_PLAYERS; ++i) {
+			m_reward[i] = evaluateReward(i);
+			m_totalReward[i] += m_reward[i];
+		}
+	} else {
+		m_done = calculateDone();
+		for (unsigned i = 0; i < MAX_PLAYERS; ++i) {
+			m_reward[i] = calculateReward(i);
+			m_totalReward[i] += m_reward[i];
+		}
 	}
 	++m_frame;
 }
@@ -905,7 +1023,7 @@ float Scenario::calculateReward(unsigned player) const {
 
 	float reward = m_rewardTime[player].calculate(1, 1);
 	for (auto var = m_rewardVars[player].cbegin(); var != m_rewardVars[player].cend(); ++var) {
-		reward += var->second.calculate(m_data.lookupValue(var->first), m_data.lookupDelta(var->first));
+		reward += var->second.calculate(static_cast<int64_t>(data()->lookupValue(var->first)), m_data.lookupDelta(var->first));
 	}
 	return reward;
 }
@@ -915,7 +1033,7 @@ bool Scenario::calculateDone() const {
 		return ScriptContext::get(m_doneFunc.second)->callFunction(m_doneFunc.first);
 	}
 	for (auto var = m_doneVars.cbegin(); var != m_doneVars.cend(); ++var) {
-		int done = var->second.test(m_data.lookupValue(var->first), m_data.lookupDelta(var->first));
+		int done = var->second.test(static_cast<int64_t>(data()->lookupValue(var->first)), m_data.lookupDelta(var->first));
 		if (done > 0 && m_doneCondition == DoneCondition::ANY) {
 			return true;
 		}
@@ -935,9 +1053,98 @@ bool Scenario::calculateDone() const {
 	return m_doneCondition == DoneCondition::ALL;
 }
 
+bool Scenario::compile() {
+	m_dirty = false;
+	m_compiledVersion = m_data.variablesVersion();
+	m_slots.clear();
+	m_doneProgram.clear();
+	for (unsigned i = 0; i < MAX_PLAYERS; ++i) {
+		m_rewardTerms[i].clear();
+		m_rewardBase[i] = m_rewardTime[i].calculate(1, 1);
+		for (const auto& var : m_rewardVars[i]) {
+			size_t slot = compileSlot(var.first);
+			if (slot == SIZE_MAX) {
+				return false;
+			}
+			m_rewardTerms[i].push_back({ slot, var.second });
+		}
+	}
+	if (!compileNode(m_doneVars, m_doneNodes, m_doneCondition)) {
+		return false;
+	}
+	m_values.resize(m_slots.size());
+	m_deltas.resize(m_slots.size());
+	m_doneStack.reserve(m_doneProgram.size());
+	return true;
+}
+
+bool Scenario::compileNode(const unordered_map<string, DoneSpec>& vars, const unordered_map<string, shared_ptr<DoneNode>>& nodes, DoneCondition condition) {
+	for (const auto& var : vars) {
+		size_t slot = compileSlot(var.first);
+		if (slot == SIZE_MAX) {
+			return false;
+		}
+		m_doneProgram.push_back({ slot, 0, condition, var.second });
+	}
+	for (const auto& node : nodes) {
+		if (!compileNode(node.second->vars, node.second->nodes, node.second->condition)) {
+			return false;
+		}
+	}
+	m_doneProgram.push_back({ SIZE_MAX, vars.size() + nodes.size(), condition, {} });
+	return true;
+}
+
+size_t Scenario::compileSlot(const string& name) {
+	size_t var = m_data.variableSlot(name);
+	if (var == SIZE_MAX) {
+		// Leave unknown variables to the interpreted path so it can report them
+		return SIZE_MAX;
+	}
+	auto slot = find(m_slots.begin(), m_slots.end(), var);
+	if (slot != m_slots.end()) {
+		return slot - m_slots.begin();
+	}
+	m_slots.push_back(var);
+	return m_slots.size() - 1;
+}
+
+float Scenario::evaluateReward(unsigned player) const {
+	if (m_rewardFunc[player].first.size()) {
+		return ScriptContext::get(m_rewardFunc[player].second)->callFunction(m_rewardFunc[player].first);
+	}
+
+	float reward = m_rewardBase[player];
+	for (const auto& term : m_rewardTerms[player]) {
+		reward += term.spec.calculate(m_values[term.slot], m_deltas[term.slot]);
+	}
+	return reward;
+}
+
+bool Scenario::evaluateDone() {
+	if (m_doneFunc.first.size()) {
+		return ScriptContext::get(m_doneFunc.second)->callFunction(m_doneFunc.first);
+	}
+	m_doneStack.clear();
+	for (const auto& step : m_doneProgram) {
+		if (step.slot != SIZE_MAX) {
+			m_doneStack.push_back(step.spec.test(m_values[step.slot], m_deltas[step.slot]));
+			continue;
+		}
+		bool all = step.condition == DoneCondition::ALL;
+		bool done = all;
+		for (size_t i = m_doneStack.size() - step.operands; i < m_doneStack.size(); ++i) {
+			done = all ? done && m_doneStack[i] : done || m_doneStack[i];
+		}
+		m_doneStack.resize(m_doneStack.size() - step.operands);
+		m_doneStack.push_back(done);
+	}
+	return m_doneStack.back();
+}
+
 bool Scenario::isDone(const DoneNode& subnode) const {
 	for (auto var = subnode.vars.cbegin(); var != subnode.vars.cend(); ++var) {
-		int done = var->second.test(m_data.lookupValue(var->first), m_data.lookupDelta(var->first));
+		int done = var->second.test(static_cast<int64_t>(data()->lookupValue(var->first)), m_data.lookupDelta(var->first));
 		if (done > 0 && subnode.condition == DoneCondition::ANY) {
 			return true;
 		}
@@ -1043,6 +1250,7 @@ string Scenario::name(Operation op) {
 
 void Scenario::setRewardVariable(const string& name, const RewardSpec& var, unsigned player) {
 	m_rewardVars[player].emplace(name, var);
+	m_dirty = true;
 }
 
 void Scenario::setRewardFunction(const string& name, const string& scope, unsigned player) {
@@ -1051,18 +1259,22 @@ void Scenario::setRewardFunction(const string& name, const string& scope, unsign
 
 void Scenario::setRewardTime(const RewardSpec& spec, unsigned player) {
 	m_rewardTime[player] = spec;
+	m_dirty = true;
 }
 
 void Scenario::setDoneVariable(const string& name, const DoneSpec& var) {
 	m_doneVars.emplace(name, var);
+	m_dirty = true;
 }
 
 void Scenario::setDoneNode(const string& name, shared_ptr<DoneNode> node) {
 	m_doneNodes.emplace(name, move(node));
+	m_dirty = true;
 }
 
 void Scenario::setDoneCondition(Scenario::DoneCondition condition) {
 	m_doneCondition = condition;
+	m_dirty = true;
 }
 
 void Scenario::setDoneFunction(const string& name, const string& scope) {
@@ -47,12 +47,29 @@ public:
 	int64_t lookupValue(const TypedSearchResult&) const;
 	std::unordered_map<std::string, Datum> lookupAll();
 	std::unordered_map<std::string, int64_t> lookupAll() const;
+	// Writes every variable in slot order; unmapped ones read as 0. Custom
+	// values made by setValue have no slot, so they aren't included
+	void lookupAll(int64_t* values) const;
 
 	void setValue(const std::string& name, int64_t);
 	void setValue(const std::string& name, const Variant&);
 
 	int64_t lookupDelta(const std::string& name) const;
 
+	// Slots stay valid until variablesVersion() changes
+	size_t variableSlot(const std::string& name) const;
+	const std::vector<std::string>& variableNames() const { return m_slotNames; }
+	int64_t slotValue(size_t slot) const;
+	int64_t slotDelta(size_t slot) const;
+	uint64_t variablesVersion() const { return m_varsVersion; }
+
+	// By default updateRam only samples declared variables for lookupDelta.
+	// Full history clones all of RAM every update instead, so deltas of
+	// variables declared since the last update match the old behavior.
+	void setFullRamHistory(bool);
+	bool fullRamHistory() const { return m_fullRamHistory; }
+	bool hasCustomValues() const { return !m_customVars.empty(); }
+
 	Variable getVariable(const std::string& name) const;
 	void setVariable(const std::string& name, const Variable&);
 	void removeVariable(const std::string& name);
@@ -74,6 +91,14 @@ public:
 #endif
 
 private:
+	struct Sample {
+		int64_t value = 0;
+		bool mapped = false;
+	};
+
+	void compileVariables();
+	Sample sample(size_t slot) const;
+
 	AddressSpace m_mem;
 	AddressSpace m_cloneMem;
 	AddressSpace m_lastMem;
@@ -83,6 +108,14 @@ private:
 	std::vector<std::string> m_buttons;
 
 	std::unordered_map<std::string, Variable> m_vars;
+	std::vector<CompiledVariable> m_compiledVars;
+	std::unordered_map<std::string, size_t> m_varSlots;
+	std::vector<std::string> m_slotNames;
+	uint64_t m_compiledLayout = 0;
+	uint64_t m_varsVersion = 0;
+	std::vector<Sample> m_samples[2];
+	unsigned m_currentSamples = 0;
+	bool m_fullRamHistory = false;
 	std::unordered_map<std::string, Search> m_searches;
 	std::unordered_map<std::string, AddressSpace> m_searchOldMem;
 	std::unordered_map<std::string, std::unique_ptr<Variant>> m_customVars;
@@ -196,6 +229,29 @@ public:
 	DoneCondition doneCondition() const { return m_doneCondition; }
 
 private:
+	// Specs flattened against GameData's compiled variables. Each distinct
+	// variable is read once per frame into a slot, reward terms are summed in
+	// map order so totals match the interpreted path, and done trees become a
+	// postfix program of tests and ANY/ALL combines.
+	struct RewardTerm {
+		size_t slot;
+		RewardSpec spec;
+	};
+
+	struct DoneStep {
+		size_t slot; // SIZE_MAX for a combine
+		size_t operands;
+		DoneCondition condition;
+		DoneSpec spec;
+	};
+
+	bool compile();
+	bool compileNode(const std::unordered_map<std::string, DoneSpec>& vars,
+		const std::unordered_map<std::string, std::shared_ptr<DoneNode>>& nodes, DoneCondition);
+	size_t compileSlot(const std::string& name);
+	float evaluateReward(unsigned player) const;
+	bool evaluateDone();
+
 	bool isDone(const DoneNode&) const;
 
 	float calculateReward(unsigned player) const;
@@ -217,6 +273,17 @@ private:
 
 	std::map<int, std::set<int>> m_actions;
 
+	bool m_dirty = true;
+	bool m_compiled = false;
+	uint64_t m_compiledVersion = 0;
+	std::vector<size_t> m_slots;
+	std::vector<int64_t> m_values;
+	std::vector<int64_t> m_deltas;
+	std::vector<RewardTerm> m_rewardTerms[MAX_PLAYERS];
+	float m_rewardBase[MAX_PLAYERS] = { 0 };
+	std::vector<DoneStep> m_doneProgram;
+	std::vector<uint8_t> m_doneStack;
+
 	float m_reward[MAX_PLAYERS] = { 0 };
 	float m_totalReward[MAX_PLAYERS] = { 0 };
 	bool m_done = false;
@@ -1,9 +1,12 @@
 #include <cassert>
 #ifndef _WIN32
 #include <dlfcn.h>
+#include <unistd.h>
 #endif
 #include <fstream>
 #include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -23,7 +26,15 @@ using namespace std;
 
 namespace Retro {
 
-static Emulator* s_loadedEmulator = nullptr;
+// libretro callbacks carry no user data, so route them to whichever emulator is
+// currently calling into its core on this thread
+static thread_local Emulator* s_activeEmulator = nullptr;
+
+// Cores keep their state in globals, so every live emulator of a given core
+// needs its own image of the library. The first user gets the installed
+// library, any further ones get a private copy.
+static mutex s_coreMutex;
+static set<string> s_coresInUse;
 
 static map<string, const char*> s_envVariables = {
 	{ "genesis_plus_gx_bram", "per game" },
@@ -31,28 +42,78 @@ static map<string, const char*> s_envVariables = {
 	{ "genesis_plus_gx_blargg_ntsc_filter", "disabled" }
 };
 
-static void (*retro_init)(void);
-static void (*retro_deinit)(void);
-static unsigned (*retro_api_version)(void);
-static void (*retro_get_system_info)(struct retro_system_info* info);
-static void (*retro_get_system_av_info)(struct retro_system_av_info* info);
-static void (*retro_reset)(void);
-static void (*retro_run)(void);
-static size_t (*retro_serialize_size)(void);
-static bool (*retro_serialize)(void* data, size_t size);
-static bool (*retro_unserialize)(const void* data, size_t size);
-static bool (*retro_load_game)(const struct retro_game_info* game);
-static void (*retro_unload_game)(void);
-static void* (*retro_get_memory_data)(unsigned id);
-static size_t (*retro_get_memory_size)(unsigned id);
-static void (*retro_cheat_reset)(void);
-static void (*retro_cheat_set)(unsigned index, bool enabled, const char* code);
-static void (*retro_set_environment)(retro_environment_t);
-static void (*retro_set_video_refresh)(retro_video_refresh_t);
-static void (*retro_set_audio_sample)(retro_audio_sample_t);
-static void (*retro_set_audio_sample_batch)(retro_audio_sample_batch_t);
-static void (*retro_set_input_poll)(retro_input_poll_t);
-static void (*retro_set_input_state)(retro_input_state_t);
+struct Emulator::CoreSymbols {
+	void (*retro_init)(void);
+	void (*retro_deinit)(void);
+	unsigned (*retro_api_version)(void);
+	void (*retro_get_system_info)(struct retro_system_info* info);
+	void (*retro_get_system_av_info)(struct retro_system_av_info* info);
+	void (*retro_reset)(void);
+	void (*retro_run)(void);
+	size_t (*retro_serialize_size)(void);
+	bool (*retro_serialize)(void* data, size_t size);
+	bool (*retro_unserialize)(const void* data, size_t size);
+	bool (*retro_load_game)(const struct retro_game_info* game);
+	void (*retro_unload_game)(void);
+	void* (*retro_get_memory_data)(unsigned id);
+	size_t (*retro_get_memory_size)(unsigned id);
+	void (*retro_cheat_reset)(void);
+	void (*retro_cheat_set)(unsigned index, bool enabled, const char* code);
+	void (*retro_set_environment)(retro_environment_t);
+	void (*retro_set_video_refresh)(retro_video_refresh_t);
+	void (*retro_set_audio_sample)(retro_audio_sample_t);
+	void (*retro_set_audio_sample_batch)(retro_audio_sample_batch_t);
+	void (*retro_set_input_poll)(retro_input_poll_t);
+	void (*retro_set_input_state)(retro_input_state_t);
+};
+
+static string copyCore(const string& path) {
+	size_t dot = path.find_last_of('.');
+	string ext = dot == string::npos ? string() : path.substr(dot);
+#ifdef _WIN32
+	char dir[MAX_PATH];
+	char name[MAX_PATH];
+	if (!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, "rtr", 0, name)) {
+		return {};
+	}
+	DeleteFileA(name);
+	string copy = string(name) + ext;
+	if (!CopyFileA(path.c_str(), copy.c_str(), FALSE)) {
+		return {};
+	}
+	return copy;
+#else
+	const char* tmpdir = getenv("TMPDIR");
+	string copy = string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/retro-core-XXXXXX" + ext;
+	int fd = mkstemps(&copy[0], ext.size());
+	if (fd < 0) {
+		return {};
+	}
+	ifstream in(path, ios::binary);
+	char buffer[65536];
+	bool ok = in.good();
+	while (ok && in) {
+		in.read(buffer, sizeof(buffer));
+		const char* out = buffer;
+		size_t remaining = in.gcount();
+		while (remaining) {
+			ssize_t written = write(fd, out, remaining);
+			if (written <= 0) {
+				ok = false;
+				break;
+			}
+			out += written;
+			remaining -= written;
+		}
+	}
+	close(fd);
+	if (!ok || in.bad()) {
+		unlink(copy.c_str());
+		return {};
+	}
+	return copy;
+#endif
+}
 
 Emulator::Emulator() {
 }
@@ -69,10 +130,6 @@ Emulator::~Emulator() {
 	}
 }
 
-bool Emulator::isLoaded() {
-	return s_loadedEmulator;
-}
-
 bool Emulator::loadRom(const string& romPath) {
 	if (m_romLoaded) {
 		unloadRom();
@@ -122,52 +179,59 @@ bool Emulator::loadRom(const string& romPath) {
 	}
 	in.close();
 
-	auto res = retro_load_game(&gameInfo);
+	s_activeEmulator = this;
+	auto res = m_sym->retro_load_game(&gameInfo);
 	delete[] romData;
 	if (!res) {
 		return false;
 	}
-	retro_get_system_av_info(&m_avInfo);
+	m_sym->retro_get_system_av_info(&m_avInfo);
 	fixScreenSize(romPath);
+	m_audio.configure(m_avInfo.timing.sample_rate, m_avInfo.timing.fps, m_audioRate, m_audioChannels);
 
 	m_romLoaded = true;
 	m_romPath = romPath;
 	return true;
 }
 
-void Emulator::run() {
-	assert(s_loadedEmulator == this);
-	m_audioData.clear();
-	retro_run();
+void Emulator::run(unsigned outputs) {
+	assert(m_coreHandle);
+	s_activeEmulator = this;
+	m_outputs = outputs;
+	m_audio.begin();
+	m_sym->retro_run();
+}
+
+void Emulator::configureAudio(double rate, unsigned channels) {
+	m_audioRate = rate;
+	m_audioChannels = channels;
+	if (m_romLoaded) {
+		m_audio.configure(m_avInfo.timing.sample_rate, m_avInfo.timing.fps, m_audioRate, m_audioChannels);
+	}
 }
 
 void Emulator::reset() {
-	assert(s_loadedEmulator == this);
+	assert(m_coreHandle);
+	s_activeEmulator = this;
 
 	memset(m_buttonMask, 0, sizeof(m_buttonMask));
 
 	retro_system_info systemInfo;
-	retro_get_system_info(&systemInfo);
+	m_sym->retro_get_system_info(&systemInfo);
 	if (!strcmp(systemInfo.library_name, "Stella")) {
 		// Stella does not properly clear everything when reseting or loading a savestate
 		string romPath = m_romPath;
 
-#ifdef _WIN32
-		FreeLibrary(m_coreHandle);
-#else
-		dlclose(m_coreHandle);
-#endif
-		m_coreHandle = nullptr;
-		s_loadedEmulator = nullptr;
+		closeCore();
 		m_romLoaded = false;
 		loadRom(m_romPath);
 		if (m_addressSpace) {
 			m_addressSpace->reset();
-			m_addressSpace->addBlock(Retro::ramBase(m_core), retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM), retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM));
+			m_addressSpace->addBlock(Retro::ramBase(m_core), m_sym->retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM), m_sym->retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM));
 		}
 	}
 
-	retro_reset();
+	m_sym->retro_reset();
 }
 
 void Emulator::unloadCore() {
@@ -177,21 +241,17 @@ void Emulator::unloadCore() {
 	if (m_romLoaded) {
 		unloadRom();
 	}
-	retro_deinit();
-#ifdef _WIN32
-	FreeLibrary(m_coreHandle);
-#else
-	dlclose(m_coreHandle);
-#endif
-	m_coreHandle = nullptr;
-	s_loadedEmulator = nullptr;
+	s_activeEmulator = this;
+	m_sym->retro_deinit();
+	closeCore();
 }
 
 void Emulator::unloadRom() {
 	if (!m_romLoaded) {
 		return;
 	}
-	retro_unload_game();
+	s_activeEmulator = this;
+	m_sym->retro_unload_game();
 	m_romLoaded = false;
 	m_romPath.clear();
 	m_addressSpace = nullptr;
@@ -199,95 +259,149 @@ void Emulator::unloadRom() {
 }
 
 bool Emulator::serialize(void* data, size_t size) {
-	assert(s_loadedEmulator == this);
-	return retro_serialize(data, size);
+	assert(m_coreHandle);
+	s_activeEmulator = this;
+	return m_sym->retro_serialize(data, size);
 }
 
 bool Emulator::unserialize(const void* data, size_t size) {
-	assert(s_loadedEmulator == this);
+	assert(m_coreHandle);
+	s_activeEmulator = this;
 	try {
 		retro_system_info systemInfo;
-		retro_get_system_info(&systemInfo);
+		m_sym->retro_get_system_info(&systemInfo);
 		if (!strcmp(systemInfo.library_name, "Stella")) {
 			reset();
 		}
 
-		return retro_unserialize(data, size);
+		return m_sym->retro_unserialize(data, size);
 	} catch (...) {
 		return false;
 	}
 }
 
 size_t Emulator::serializeSize() {
-	assert(s_loadedEmulator == this);
-	return retro_serialize_size();
+	assert(m_coreHandle);
+	s_activeEmulator = this;
+	return m_sym->retro_serialize_size();
 }
 
 void Emulator::clearCheats() {
-	assert(s_loadedEmulator == this);
-	retro_cheat_reset();
+	assert(m_coreHandle);
+	s_activeEmulator = this;
+	m_sym->retro_cheat_reset();
 }
 
 void Emulator::setCheat(unsigned index, bool enabled, const char* code) {
-	assert(s_loadedEmulator == this);
-	retro_cheat_set(index, enabled, code);
+	assert(m_coreHandle);
+	s_activeEmulator = this;
+	m_sym->retro_cheat_set(index, enabled, code);
 }
 
 bool Emulator::loadCore(const string& corePath) {
-	if (s_loadedEmulator) {
+	if (m_coreHandle) {
 		return false;
 	}
 
+	string libPath = corePath;
+	{
+		lock_guard<mutex> lock(s_coreMutex);
+		if (s_coresInUse.count(corePath)) {
+			libPath = copyCore(corePath);
+			if (libPath.empty()) {
+				return false;
+			}
+			m_coreCopy = libPath;
+		} else {
+			s_coresInUse.insert(corePath);
+		}
+		m_coreLibrary = corePath;
+	}
+
 #ifdef _WIN32
-	m_coreHandle = LoadLibrary(corePath.c_str());
+	m_coreHandle = LoadLibrary(libPath.c_str());
 #else
-	m_coreHandle = dlopen(corePath.c_str(), RTLD_LAZY);
+	m_coreHandle = dlopen(libPath.c_str(), RTLD_LAZY);
+	if (!m_coreCopy.empty()) {
+		// The mapping outlives the file, so the copy doesn't need to stay around
+		unlink(m_coreCopy.c_str());
+	}
 #endif
 	if (!m_coreHandle) {
+		closeCore();
 		return false;
 	}
 
-	retro_init = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_init"));
-	retro_deinit = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_deinit"));
-	retro_api_version = reinterpret_cast<unsigned int (*)()>(GETSYM(m_coreHandle, "retro_api_version"));
-	retro_get_system_info = reinterpret_cast<void (*)(struct retro_system_info*)>(GETSYM(m_coreHandle, "retro_get_system_info"));
-	retro_get_system_av_info = reinterpret_cast<void (*)(struct retro_system_av_info*)>(GETSYM(m_coreHandle, "retro_get_system_av_info"));
-	retro_reset = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_reset"));
-	retro_run = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_run"));
-	retro_serialize_size = reinterpret_cast<size_t (*)()>(GETSYM(m_coreHandle, "retro_serialize_size"));
-	retro_serialize = reinterpret_cast<bool (*)(void*, size_t)>(GETSYM(m_coreHandle, "retro_serialize"));
-	retro_unserialize = reinterpret_cast<bool (*)(const void*, size_t)>(GETSYM(m_coreHandle, "retro_unserialize"));
-	retro_load_game = reinterpret_cast<bool (*)(const struct retro_game_info*)>(GETSYM(m_coreHandle, "retro_load_game"));
-	retro_unload_game = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_unload_game"));
-	retro_get_memory_data = reinterpret_cast<void* (*) (unsigned int)>(GETSYM(m_coreHandle, "retro_get_memory_data"));
-	retro_get_memory_size = reinterpret_cast<size_t (*)(unsigned int)>(GETSYM(m_coreHandle, "retro_get_memory_size"));
-	retro_cheat_reset = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_cheat_reset"));
-	retro_cheat_set = reinterpret_cast<void (*)(unsigned int, bool, const char*)>(GETSYM(m_coreHandle, "retro_cheat_set"));
-	retro_set_environment = reinterpret_cast<void (*)(retro_environment_t)>(GETSYM(m_coreHandle, "retro_set_environment"));
-	retro_set_video_refresh = reinterpret_cast<void (*)(retro_video_refresh_t)>(GETSYM(m_coreHandle, "retro_set_video_refresh"));
-	retro_set_audio_sample = reinterpret_cast<void (*)(retro_audio_sample_t)>(GETSYM(m_coreHandle, "retro_set_audio_sample"));
-	retro_set_audio_sample_batch = reinterpret_cast<void (*)(retro_audio_sample_batch_t)>(GETSYM(m_coreHandle, "retro_set_audio_sample_batch"));
-	retro_set_input_poll = reinterpret_cast<void (*)(retro_input_poll_t)>(GETSYM(m_coreHandle, "retro_set_input_poll"));
-	retro_set_input_state = reinterpret_cast<void (*)(short (*)(unsigned int, unsigned int, unsigned int, unsigned int))>(GETSYM(m_coreHandle, "retro_set_input_state"));
+	m_sym = make_unique<CoreSymbols>();
+	m_sym->retro_init = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_init"));
+	m_sym->retro_deinit = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_deinit"));
+	m_sym->retro_api_version = reinterpret_cast<unsigned int (*)()>(GETSYM(m_coreHandle, "retro_api_version"));
+	m_sym->retro_get_system_info = reinterpret_cast<void (*)(struct retro_system_info*)>(GETSYM(m_coreHandle, "retro_get_system_info"));
+	m_sym->retro_get_system_av_info = reinterpret_cast<void (*)(struct retro_system_av_info*)>(GETSYM(m_coreHandle, "retro_get_system_av_info"));
+	m_sym->retro_reset = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_reset"));
+	m_sym->retro_run = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_run"));
+	m_sym->retro_serialize_size = reinterpret_cast<size_t (*)()>(GETSYM(m_coreHandle, "retro_serialize_size"));
+	m_sym->retro_serialize = reinterpret_cast<bool (*)(void*, size_t)>(GETSYM(m_coreHandle, "retro_serialize"));
+	m_sym->retro_unserialize = reinterpret_cast<bool (*)(const void*, size_t)>(GETSYM(m_coreHandle, "retro_unserialize"));
+	m_sym->retro_load_game = reinterpret_cast<bool (*)(const struct retro_game_info*)>(GETSYM(m_coreHandle, "retro_load_game"));
+	m_sym->retro_unload_game = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_unload_game"));
+	m_sym->retro_get_memory_data = reinterpret_cast<void* (*) (unsigned int)>(GETSYM(m_coreHandle, "retro_get_memory_data"));
+	m_sym->retro_get_memory_size = reinterpret_cast<size_t (*)(unsigned int)>(GETSYM(m_coreHandle, "retro_get_memory_size"));
+	m_sym->retro_cheat_reset = reinterpret_cast<void (*)()>(GETSYM(m_coreHandle, "retro_cheat_reset"));
+	m_sym->retro_cheat_set = reinterpret_cast<void (*)(unsigned int, bool, const char*)>(GETSYM(m_coreHandle, "retro_cheat_set"));
+	m_sym->retro_set_environment = reinterpret_cast<void (*)(retro_environment_t)>(GETSYM(m_coreHandle, "retro_set_environment"));
+	m_sym->retro_set_video_refresh = reinterpret_cast<void (*)(retro_video_refresh_t)>(GETSYM(m_coreHandle, "retro_set_video_refresh"));
+	m_sym->retro_set_audio_sample = reinterpret_cast<void (*)(retro_audio_sample_t)>(GETSYM(m_coreHandle, "retro_set_audio_sample"));
+	m_sym->retro_set_audio_sample_batch = reinterpret_cast<void (*)(retro_audio_sample_batch_t)>(GETSYM(m_coreHandle, "retro_set_audio_sample_batch"));
+	m_sym->retro_set_input_poll = reinterpret_cast<void (*)(retro_input_poll_t)>(GETSYM(m_coreHandle, "retro_set_input_poll"));
+	m_sym->retro_set_input_state = reinterpret_cast<void (*)(retro_input_state_t)>(GETSYM(m_coreHandle, "retro_set_input_state"));
 
 	// The default according to the docs
 	m_imgDepth = 15;
-	s_loadedEmulator = this;
+	s_activeEmulator = this;
 
-	retro_set_environment(cbEnvironment);
-	retro_set_video_refresh(cbVideoRefresh);
-	retro_set_audio_sample(cbAudioSample);
-	retro_set_audio_sample_batch(cbAudioSampleBatch);
-	retro_set_input_poll(cbInputPoll);
-	retro_set_input_state(cbInputState);
-	retro_init();
+	m_sym->retro_set_environment(cbEnvironment);
+	m_sym->retro_set_video_refresh(cbVideoRefresh);
+	m_sym->retro_set_audio_sample(cbAudioSample);
+	m_sym->retro_set_audio_sample_batch(cbAudioSampleBatch);
+	m_sym->retro_set_input_poll(cbInputPoll);
+	m_sym->retro_set_input_state(cbInputState);
+	m_sym->retro_init();
 
 	return true;
 }
 
+void Emulator::closeCore() {
+	if (m_coreHandle) {
+#ifdef _WIN32
+		FreeLibrary(m_coreHandle);
+#else
+		dlclose(m_coreHandle);
+#endif
+		m_coreHandle = nullptr;
+	}
+	{
+		lock_guard<mutex> lock(s_coreMutex);
+		if (m_coreCopy.empty()) {
+			s_coresInUse.erase(m_coreLibrary);
+		}
+	}
+#ifdef _WIN32
+	if (!m_coreCopy.empty()) {
+		DeleteFileA(m_coreCopy.c_str());
+	}
+#endif
+	m_coreCopy.clear();
+	m_coreLibrary.clear();
+	m_sym.reset();
+	if (s_activeEmulator == this) {
+		s_activeEmulator = nullptr;
+	}
+}
+
 void Emulator::fixScreenSize(const string& romName) {
 	retro_system_info systemInfo;
-	retro_get_system_info(&systemInfo);
+	m_sym->retro_get_system_info(&systemInfo);
 	if (!strcmp(systemInfo.library_name, "Genesis Plus GX")) {
 		switch (romName.back()) {
 		case 'd': // Mega Drive
@@ -355,21 +469,21 @@ static void cbLog(enum retro_log_level level, const char *fmt, ...) {
 }
 
 bool Emulator::cbEnvironment(unsigned cmd, void* data) {
-	assert(s_loadedEmulator);
+	assert(s_activeEmulator);
 	switch (cmd) {
 	case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
 		switch (*reinterpret_cast<retro_pixel_format*>(data)) {
 		case RETRO_PIXEL_FORMAT_XRGB8888:
-			s_loadedEmulator->m_imgDepth = 32;
+			s_activeEmulator->m_imgDepth = 32;
 			break;
 		case RETRO_PIXEL_FORMAT_RGB565:
-			s_loadedEmulator->m_imgDepth = 16;
+			s_activeEmulator->m_imgDepth = 16;
 			break;
 		case RETRO_PIXEL_FORMAT_0RGB1555:
-			s_loadedEmulator->m_imgDepth = 15;
+			s_activeEmulator->m_imgDepth = 15;
 			break;
 		default:
-			s_loadedEmulator->m_imgDepth = 0;
+			s_activeEmulator->m_imgDepth = 0;
 			break;
 		}
 		return true;
@@ -382,20 +496,32 @@ bool Emulator::cbEnvironment(unsigned cmd, void* data) {
 		return false;
 	}
 	case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
-		if (!s_loadedEmulator->m_corePath) {
-			s_loadedEmulator->m_corePath = strdup(corePath().c_str());
+		if (!s_activeEmulator->m_corePath) {
+			s_activeEmulator->m_corePath = strdup(corePath().c_str());
 		}
-		*reinterpret_cast<const char**>(data) = s_loadedEmulator->m_corePath;
+		*reinterpret_cast<const char**>(data) = s_activeEmulator->m_corePath;
 		return true;
 	case RETRO_ENVIRONMENT_GET_CAN_DUPE:
 		*reinterpret_cast<bool*>(data) = true;
 		return true;
+	case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE:
+		if (data) {
+			int enable = 0;
+			if (s_activeEmulator->m_outputs & OUTPUT_VIDEO) {
+				enable |= 1;
+			}
+			if (s_activeEmulator->m_outputs & OUTPUT_AUDIO) {
+				enable |= 2;
+			}
+			*reinterpret_cast<int*>(data) = enable;
+		}
+		return true;
 	case RETRO_ENVIRONMENT_SET_MEMORY_MAPS:
-		s_loadedEmulator->m_map.clear();
+		s_activeEmulator->m_map.clear();
 		for (size_t i = 0; i < static_cast<const retro_memory_map*>(data)->num_descriptors; ++i) {
-			s_loadedEmulator->m_map.emplace_back(static_cast<const retro_memory_map*>(data)->descriptors[i]);
+			s_activeEmulator->m_map.emplace_back(static_cast<const retro_memory_map*>(data)->descriptors[i]);
 		}
-		s_loadedEmulator->reconfigureAddressSpace();
+		s_activeEmulator->reconfigureAddressSpace();
 		return true;
 	// Logs needs to be handled even when not used, otherwise some cores (ex: mame2003_plus) will crash
 	// Also very useful when integrating new emulators to debug issues within the core itself
@@ -411,34 +537,39 @@ bool Emulator::cbEnvironment(unsigned cmd, void* data) {
 }
 
 void Emulator::cbVideoRefresh(const void* data, unsigned, unsigned, size_t pitch) {
-	assert(s_loadedEmulator);
+	assert(s_activeEmulator);
 	if (data) {
-		s_loadedEmulator->m_imgData = data;
+		s_activeEmulator->m_imgData = data;
 	}
 	if (pitch) {
-		s_loadedEmulator->m_imgPitch = pitch;
+		s_activeEmulator->m_imgPitch = pitch;
 	}
 }
 
 void Emulator::cbAudioSample(int16_t left, int16_t right) {
-	assert(s_loadedEmulator);
-	s_loadedEmulator->m_audioData.push_back(left);
-	s_loadedEmulator->m_audioData.push_back(right);
+	assert(s_activeEmulator);
+	if (!(s_activeEmulator->m_outputs & OUTPUT_AUDIO)) {
+		return;
+	}
+	s_activeEmulator->m_audio.write(left, right);
 }
 
 size_t Emulator::cbAudioSampleBatch(const int16_t* data, size_t frames) {
-	assert(s_loadedEmulator);
-	s_loadedEmulator->m_audioData.insert(s_loadedEmulator->m_audioData.end(), data, &data[frames * 2]);
+	assert(s_activeEmulator);
+	if (!(s_activeEmulator->m_outputs & OUTPUT_AUDIO)) {
+		return frames;
+	}
+	s_activeEmulator->m_audio.write(data, frames);
 	return frames;
 }
 
 void Emulator::cbInputPoll() {
-	assert(s_loadedEmulator);
+	assert(s_activeEmulator);
 }
 
 int16_t Emulator::cbInputState(unsigned port, unsigned, unsigned, unsigned id) {
-	assert(s_loadedEmulator);
-	return s_loadedEmulator->m_buttonMask[port][id];
+	assert(s_activeEmulator);
+	return s_activeEmulator->m_buttonMask[port][id];
 }
 
 void Emulator::configureData(GameData* data) {
@@ -446,8 +577,8 @@ void Emulator::configureData(GameData* data) {
 	m_addressSpace->reset();
 	Retro::configureData(data, m_core);
 	reconfigureAddressSpace();
-	if (m_addressSpace->blocks().empty() && retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM)) {
-		m_addressSpace->addBlock(Retro::ramBase(m_core), retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM), retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM));
+	if (m_addressSpace->blocks().empty() && m_sym->retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM)) {
+		m_addressSpace->addBlock(Retro::ramBase(m_core), m_sym->retro_get_memory_size(RETRO_MEMORY_SYSTEM_RAM), m_sym->retro_get_memory_data(RETRO_MEMORY_SYSTEM_RAM));
 	}
 }
 
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "audio.h"
 #include "libretro.h"
 #include "memory.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <cstring>
@@ -16,6 +18,14 @@ namespace Retro {
 const int N_BUTTONS = 16;
 const int MAX_PLAYERS = 2;
 
+// Outputs a frame needs to produce. Anything not requested may be skipped.
+enum Output : unsigned {
+	OUTPUT_VIDEO = 1 << 0,
+	OUTPUT_AUDIO = 1 << 1,
+	OUTPUT_RAM = 1 << 2, // Not used by the emulator itself; tells callers to refresh game data
+	OUTPUT_ALL = OUTPUT_VIDEO | OUTPUT_AUDIO | OUTPUT_RAM,
+};
+
 class GameData;
 class Emulator {
 public:
@@ -23,11 +33,11 @@ public:
 	~Emulator();
 	Emulator(const Emulator&) = delete;
 
-	static bool isLoaded();
+	bool isLoaded() const { return m_coreHandle; }
 
 	bool loadRom(const std::string& romPath);
 
-	void run();
+	void run(unsigned outputs = OUTPUT_ALL);
 	void reset();
 	AddressSpace* getAddressSpace();
 	const void* getImageData() { return m_imgData; }
@@ -36,9 +46,14 @@ public:
 	int getImagePitch() { return m_imgPitch; }
 	int getImageDepth() { return m_imgDepth; }
 	double getFrameRate() { return m_avInfo.timing.fps; }
-	int getAudioSamples() { return m_audioData.size() / 2; }
-	double getAudioRate() { return m_avInfo.timing.sample_rate; }
-	const int16_t* getAudioData() { return m_audioData.data(); }
+	int getAudioSamples() { return m_audio.frames(); }
+	double getAudioRate() { return m_audio.rate(); }
+	unsigned getAudioChannels() { return m_audio.channels(); }
+	const int16_t* getAudioData() { return m_audio.data(); }
+
+	// Resamples audio to rate (0 keeps the core's rate) and downmixes it to
+	// mono if channels is 1
+	void configureAudio(double rate, unsigned channels);
 	void unloadCore();
 	void unloadRom();
 
@@ -58,7 +73,10 @@ public:
 	std::vector<std::string> keybinds() const;
 
 private:
+	struct CoreSymbols;
+
 	bool loadCore(const std::string& corePath);
+	void closeCore();
 	void fixScreenSize(const std::string& romName);
 	void reconfigureAddressSpace();
 
@@ -76,8 +94,13 @@ private:
 	size_t m_imgPitch = 0;
 	int m_imgDepth = 0;
 
-	// Audio buffer; accumulated during run()
-	std::vector<int16_t> m_audioData;
+	// Outputs requested by the current run()
+	unsigned m_outputs = OUTPUT_ALL;
+
+	// Audio produced by the last run()
+	AudioBuffer m_audio;
+	double m_audioRate = 0;
+	unsigned m_audioChannels = 2;
 	AddressSpace* m_addressSpace = nullptr;
 
 	retro_system_av_info m_avInfo = {};
@@ -90,6 +113,9 @@ private:
 #else
 	void* m_coreHandle = nullptr;
 #endif
+	std::unique_ptr<CoreSymbols> m_sym;
+	std::string m_coreLibrary;
+	std::string m_coreCopy;
 	bool m_romLoaded = false;
 	std::string m_core;
 	std::string m_romPath;
@@ -0,0 +1,255 @@
+#include "imageops-kernels.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace Retro;
+
+#ifdef __AVX2__
+// These mirror the SSSE3 kernels in imageops.cpp, processing twice as many pixels per
+// iteration. AVX2 shuffles only work within 128-bit lanes, so inputs are first permuted
+// so that each lane holds one SSSE3-sized group, and the results are permuted back.
+// Leftover columns are handed to the base kernels.
+
+static inline __m256i _lanes(__m128i mask) {
+	return _mm256_broadcastsi128_si256(mask);
+}
+
+static inline __m256i _loadu(const void* in) {
+	return _mm256_loadu_si256(static_cast<const __m256i*>(in));
+}
+
+/* R + G + B of each pixel, scaled to 8 bits per channel */
+static inline __m256i _sum565(__m256i pix) {
+	__m256i r = _mm256_srli_epi16(_mm256_and_si256(pix, _mm256_set1_epi16(0xF800)), 8);
+	__m256i g = _mm256_srli_epi16(_mm256_and_si256(pix, _mm256_set1_epi16(0x07E0)), 3);
+	__m256i b = _mm256_slli_epi16(_mm256_and_si256(pix, _mm256_set1_epi16(0x001F)), 3);
+	return _mm256_add_epi16(_mm256_add_epi16(r, g), b);
+}
+
+/* B + G and R of each pixel as pairs of 16-bit values */
+static inline __m256i _pairsX888(__m256i pix) {
+	return _mm256_maddubs_epi16(pix, _mm256_set1_epi32(0x00010101));
+}
+
+// Packs 8 16-bit values from each lane into 16 contiguous bytes
+static inline void _store16x16(__m256i pix, uint8_t* out) {
+	pix = _mm256_packus_epi16(pix, pix);
+	pix = _mm256_permute4x64_epi64(pix, 0x08);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(pix));
+}
+
+// Packs the first 4 16-bit values of each lane into 8 contiguous bytes
+static inline void _store8x16(__m256i pix, uint8_t* out) {
+	pix = _mm256_packus_epi16(pix, pix);
+	uint32_t lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(pix));
+	uint32_t hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(pix, 1));
+	reinterpret_cast<uint32_t*>(out)[0] = lo;
+	reinterpret_cast<uint32_t*>(out)[1] = hi;
+}
+
+static void image565To888(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const __m256i maskR16 = _mm256_set1_epi16(0xF800);
+	const __m256i maskG16 = _mm256_set1_epi16(0x07E0);
+	const __m256i maskB16 = _mm256_set1_epi16(0x001F);
+	const __m256i rblend00 = _lanes(_mm_set_epi8(0x0A, 0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80, 0x04, 0x80, 0x80, 0x02, 0x80, 0x80, 0x00));
+	const __m256i rblend10 = _lanes(_mm_set_epi8(0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80));
+	const __m256i rblend11 = _lanes(_mm_set_epi8(0x80, 0x04, 0x80, 0x80, 0x02, 0x80, 0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80));
+	const __m256i rblend21 = _lanes(_mm_set_epi8(0x80, 0x80, 0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A, 0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80));
+	const __m256i gblend00 = _lanes(_mm_set_epi8(0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80, 0x04, 0x80, 0x80, 0x02, 0x80, 0x80, 0x00, 0x80));
+	const __m256i gblend10 = _lanes(_mm_set_epi8(0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A));
+	const __m256i gblend11 = _lanes(_mm_set_epi8(0x04, 0x80, 0x80, 0x02, 0x80, 0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80));
+	const __m256i gblend21 = _lanes(_mm_set_epi8(0x80, 0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A, 0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80));
+	const __m256i bblend00 = _lanes(_mm_set_epi8(0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80, 0x04, 0x80, 0x80, 0x02, 0x80, 0x80, 0x00, 0x80, 0x80));
+	const __m256i bblend10 = _lanes(_mm_set_epi8(0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A, 0x80));
+	const __m256i bblend11 = _lanes(_mm_set_epi8(0x80, 0x80, 0x02, 0x80, 0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80));
+	const __m256i bblend21 = _lanes(_mm_set_epi8(0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A, 0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80, 0x04));
+
+	for (size_t y = 0; y < h; ++y) {
+		uint8_t* row = out;
+		size_t x = 0;
+		for (; x + 31 < w; x += 32) {
+			__m256i v0 = _loadu(&in[x]);
+			__m256i v1 = _loadu(&in[x + 16]);
+			/* Pixels 0-7 | 16-23 and 8-15 | 24-31 */
+			__m256i pix0 = _mm256_permute2x128_si256(v0, v1, 0x20);
+			__m256i pix1 = _mm256_permute2x128_si256(v0, v1, 0x31);
+
+			__m256i r0 = _mm256_srli_epi16(_mm256_and_si256(pix0, maskR16), 8);
+			__m256i g0 = _mm256_srli_epi16(_mm256_and_si256(pix0, maskG16), 3);
+			__m256i b0 = _mm256_slli_epi16(_mm256_and_si256(pix0, maskB16), 3);
+			__m256i r1 = _mm256_srli_epi16(_mm256_and_si256(pix1, maskR16), 8);
+			__m256i g1 = _mm256_srli_epi16(_mm256_and_si256(pix1, maskG16), 3);
+			__m256i b1 = _mm256_slli_epi16(_mm256_and_si256(pix1, maskB16), 3);
+
+			__m256i out0 = _mm256_shuffle_epi8(r0, rblend00);
+			out0 = _mm256_or_si256(out0, _mm256_shuffle_epi8(g0, gblend00));
+			out0 = _mm256_or_si256(out0, _mm256_shuffle_epi8(b0, bblend00));
+
+			__m256i out1 = _mm256_shuffle_epi8(r0, rblend10);
+			out1 = _mm256_or_si256(out1, _mm256_shuffle_epi8(g0, gblend10));
+			out1 = _mm256_or_si256(out1, _mm256_shuffle_epi8(b0, bblend10));
+			out1 = _mm256_or_si256(out1, _mm256_shuffle_epi8(r1, rblend11));
+			out1 = _mm256_or_si256(out1, _mm256_shuffle_epi8(g1, gblend11));
+			out1 = _mm256_or_si256(out1, _mm256_shuffle_epi8(b1, bblend11));
+
+			__m256i out2 = _mm256_shuffle_epi8(r1, rblend21);
+			out2 = _mm256_or_si256(out2, _mm256_shuffle_epi8(g1, gblend21));
+			out2 = _mm256_or_si256(out2, _mm256_shuffle_epi8(b1, bblend21));
+
+			/* Low lanes hold pixels 0-15, high lanes 16-31 */
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&row[0]), _mm256_permute2x128_si256(out0, out1, 0x20));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&row[32]), _mm256_permute2x128_si256(out2, out0, 0x30));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&row[64]), _mm256_permute2x128_si256(out1, out2, 0x31));
+			row += 96;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->image565To888(&in[x], row, w - x, 1, stride);
+		}
+		in += stride / 2;
+		out += w * 3;
+	}
+}
+
+static void imageX888To888(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	/* B0 G0 R0 X0 B1 G1 R1 X1 B2 G2 R2 X2 B3 G3 R3 X3 -> R0 G0 B0 R1 G1 B1 R2 G2 B2 R3 G3 B3 00 00 00 00 */
+	const __m256i blend = _lanes(_mm_set_epi8(0x80, 0x80, 0x80, 0x80, 0x0C, 0x0D, 0x0E, 0x08, 0x09, 0x0A, 0x04, 0x05, 0x06, 0x00, 0x01, 0x02));
+	/* Gather the 12 used bytes of each lane into the bottom 24 bytes */
+	const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	for (size_t y = 0; y < h; ++y) {
+		uint8_t* row = out;
+		size_t x = 0;
+		// Each store writes 8 bytes past the pixels it converts, so leave room for them
+		for (; x + 10 < w; x += 8) {
+			__m256i pix = _mm256_shuffle_epi8(_loadu(&in[x]), blend);
+			pix = _mm256_permutevar8x32_epi32(pix, pack);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row), pix);
+			row += 24;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->imageX888To888(&in[x], row, w - x, 1, stride);
+		}
+		in += stride / 4;
+		out += w * 3;
+	}
+}
+
+// Gray halves and quarters add up R + G + B over each block, like the base
+// kernels. Horizontal adds stay within lanes, so each lane gets its own run
+// of pixels.
+static void imageHalve565ToGray(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 2;
+	for (size_t y = 0; y + 1 < h; y += 2) {
+		size_t x = 0;
+		for (; x + 31 < w; x += 32) {
+			__m256i v0 = _mm256_add_epi16(_sum565(_loadu(&in[x])), _sum565(_loadu(&in[x + row])));
+			__m256i v1 = _mm256_add_epi16(_sum565(_loadu(&in[x + 16])), _sum565(_loadu(&in[x + 16 + row])));
+			/* Pixels 0-7 | 16-23 and 8-15 | 24-31 */
+			__m256i sums = _mm256_hadd_epi16(_mm256_permute2x128_si256(v0, v1, 0x20), _mm256_permute2x128_si256(v0, v1, 0x31));
+			_store16x16(_mm256_srli_epi16(sums, 4), out);
+			out += 16;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->imageHalve565ToGray(&in[x], out, w - x, 2, stride);
+			out += (w - x) / 2;
+		}
+		in += row * 2;
+	}
+}
+
+static void imageHalveX888ToGray(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 4;
+	for (size_t y = 0; y + 1 < h; y += 2) {
+		size_t x = 0;
+		for (; x + 31 < w; x += 32) {
+			__m256i v[4];
+			for (size_t i = 0; i < 4; ++i) {
+				v[i] = _mm256_add_epi16(_pairsX888(_loadu(&in[x + i * 8])), _pairsX888(_loadu(&in[x + i * 8 + row])));
+			}
+			/* Low lanes take pixels 0-15, high lanes 16-31 */
+			__m256i sums0 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[0], v[2], 0x20), _mm256_permute2x128_si256(v[0], v[2], 0x31));
+			__m256i sums1 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[1], v[3], 0x20), _mm256_permute2x128_si256(v[1], v[3], 0x31));
+			_store16x16(_mm256_srli_epi16(_mm256_hadd_epi16(sums0, sums1), 4), out);
+			out += 16;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->imageHalveX888ToGray(&in[x], out, w - x, 2, stride);
+			out += (w - x) / 2;
+		}
+		in += row * 2;
+	}
+}
+
+static void imageQuarter565ToGray(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 2;
+	for (size_t y = 0; y + 3 < h; y += 4) {
+		size_t x = 0;
+		for (; x + 63 < w; x += 64) {
+			__m256i v[4];
+			for (size_t i = 0; i < 4; ++i) {
+				const uint16_t* column = &in[x + i * 16];
+				__m256i sum0 = _mm256_add_epi16(_sum565(_loadu(&column[0])), _sum565(_loadu(&column[row])));
+				__m256i sum1 = _mm256_add_epi16(_sum565(_loadu(&column[row * 2])), _sum565(_loadu(&column[row * 3])));
+				v[i] = _mm256_add_epi16(sum0, sum1);
+			}
+			/* Low lanes take pixels 0-31, high lanes 32-63 */
+			__m256i pairs0 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[0], v[2], 0x20), _mm256_permute2x128_si256(v[0], v[2], 0x31));
+			__m256i pairs1 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[1], v[3], 0x20), _mm256_permute2x128_si256(v[1], v[3], 0x31));
+			_store16x16(_mm256_srli_epi16(_mm256_hadd_epi16(pairs0, pairs1), 6), out);
+			out += 16;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->imageQuarter565ToGray(&in[x], out, w - x, 4, stride);
+			out += (w - x) / 4;
+		}
+		in += row * 4;
+	}
+}
+
+static void imageQuarterX888ToGray(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 4;
+	for (size_t y = 0; y + 3 < h; y += 4) {
+		size_t x = 0;
+		for (; x + 31 < w; x += 32) {
+			__m256i v[4];
+			for (size_t i = 0; i < 4; ++i) {
+				const uint32_t* column = &in[x + i * 8];
+				__m256i sum0 = _mm256_add_epi16(_pairsX888(_loadu(&column[0])), _pairsX888(_loadu(&column[row])));
+				__m256i sum1 = _mm256_add_epi16(_pairsX888(_loadu(&column[row * 2])), _pairsX888(_loadu(&column[row * 3])));
+				v[i] = _mm256_add_epi16(sum0, sum1);
+			}
+			/* Low lanes take pixels 0-15, high lanes 16-31 */
+			__m256i sums0 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[0], v[2], 0x20), _mm256_permute2x128_si256(v[0], v[2], 0x31));
+			__m256i sums1 = _mm256_hadd_epi16(_mm256_permute2x128_si256(v[1], v[3], 0x20), _mm256_permute2x128_si256(v[1], v[3], 0x31));
+			__m256i pairs = _mm256_hadd_epi16(sums0, sums1);
+			_store8x16(_mm256_srli_epi16(_mm256_hadd_epi16(pairs, pairs), 6), out);
+			out += 8;
+		}
+		if (x < w) {
+			ImageOps::baseKernels()->imageQuarterX888ToGray(&in[x], out, w - x, 4, stride);
+			out += (w - x) / 4;
+		}
+		in += row * 4;
+	}
+}
+
+static const ImageOps::Kernels s_avx2Kernels{
+	"avx2",
+	image565To888,
+	imageX888To888,
+	imageHalve565ToGray,
+	imageHalveX888ToGray,
+	imageQuarter565ToGray,
+	imageQuarterX888ToGray,
+};
+
+const ImageOps::Kernels* ImageOps::avx2Kernels() {
+	return &s_avx2Kernels;
+}
+#else
+const ImageOps::Kernels* ImageOps::avx2Kernels() {
+	return nullptr;
+}
+#endif
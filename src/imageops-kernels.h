@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Retro {
+
+namespace ImageOps {
+
+// Pixel conversion kernels that have more than one implementation. The
+// fastest set the host supports is picked once, at load time. Every set
+// must match the base kernels exactly, since Image::scaleTo hands exact
+// gray halves and quarters to them.
+struct Kernels {
+	const char* name;
+	void (*image565To888)(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+	void (*imageX888To888)(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+	void (*imageHalve565ToGray)(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+	void (*imageHalveX888ToGray)(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+	void (*imageQuarter565ToGray)(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+	void (*imageQuarterX888ToGray)(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride);
+};
+
+// Compile-time selected SSSE3, NEON or scalar kernels
+const Kernels* baseKernels();
+
+// AVX2 kernels, or nullptr if they weren't built
+const Kernels* avx2Kernels();
+
+// The kernels Image dispatches to
+const Kernels* activeKernels();
+}
+}
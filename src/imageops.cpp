@@ -1,11 +1,16 @@
 #include "imageops.h"
+#include "imageops-kernels.h"
 
 #ifdef __SSSE3__
 #include <emmintrin.h>
 #include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
 #endif
+#include <algorithm>
 #include <stdexcept>
 #include <cstring>
+#include <vector>
 
 using namespace Retro;
 using namespace std;
@@ -43,8 +48,61 @@ static inline __m128i _convert565ToGray(__m128i pix) {
 	r = _mm_add_epi16(r, b);
 	return r;
 }
+
+static inline __m128i _loadu(const void* in) {
+	return _mm_loadu_si128(static_cast<const __m128i*>(in));
+}
+
+/* R + G + B of each pixel, scaled to 8 bits per channel */
+static inline __m128i _sum565(__m128i pix) {
+	__m128i sum = _mm_add_epi16(_mm_srli_epi16(_mm_and_si128(pix, maskR16), 8), _mm_srli_epi16(_mm_and_si128(pix, maskG16), 3));
+	return _mm_add_epi16(sum, _mm_slli_epi16(_mm_and_si128(pix, maskB16), 3));
+}
+
+/* B + G and R of each pixel as pairs of 16-bit values */
+static inline __m128i _pairsX888(__m128i pix) {
+	return _mm_maddubs_epi16(pix, _mm_set1_epi32(0x00010101));
+}
+
+/* Adds 8 16-bit values to 8 column sums */
+static inline void _accumulate16(__m128i values, uint32_t* columns) {
+	__m128i* out = reinterpret_cast<__m128i*>(columns);
+	_mm_storeu_si128(&out[0], _mm_add_epi32(_mm_loadu_si128(&out[0]), _mm_unpacklo_epi16(values, _mm_setzero_si128())));
+	_mm_storeu_si128(&out[1], _mm_add_epi32(_mm_loadu_si128(&out[1]), _mm_unpackhi_epi16(values, _mm_setzero_si128())));
+}
+#elif defined(__ARM_NEON)
+static inline uint16x8_t _sum565(uint16x8_t pix) {
+	uint16x8_t r = vshrq_n_u16(vandq_u16(pix, vdupq_n_u16(0xF800)), 8);
+	uint16x8_t g = vshrq_n_u16(vandq_u16(pix, vdupq_n_u16(0x07E0)), 3);
+	uint16x8_t b = vshlq_n_u16(vandq_u16(pix, vdupq_n_u16(0x001F)), 3);
+	return vaddq_u16(vaddq_u16(r, g), b);
+}
+
+/* R + G + B of 16 pixels, added in horizontal pairs */
+static inline uint16x8_t _pairSumsX888(const uint32_t* in) {
+	uint8x16x4_t bgrx = vld4q_u8(reinterpret_cast<const uint8_t*>(in));
+	uint16x8_t sum0 = vaddw_u8(vaddl_u8(vget_low_u8(bgrx.val[0]), vget_low_u8(bgrx.val[1])), vget_low_u8(bgrx.val[2]));
+	uint16x8_t sum1 = vaddw_u8(vaddl_u8(vget_high_u8(bgrx.val[0]), vget_high_u8(bgrx.val[1])), vget_high_u8(bgrx.val[2]));
+	uint16x8x2_t pairs = vuzpq_u16(sum0, sum1);
+	return vaddq_u16(pairs.val[0], pairs.val[1]);
+}
+
+/* Adds 8 values to 8 column sums */
+static inline void _accumulate16(uint16x8_t values, uint32_t* columns) {
+	vst1q_u32(&columns[0], vaddw_u16(vld1q_u32(&columns[0]), vget_low_u16(values)));
+	vst1q_u32(&columns[4], vaddw_u16(vld1q_u32(&columns[4]), vget_high_u16(values)));
+}
 #endif
 
+/* R + G + B of a pixel, scaled to 8 bits per channel */
+static inline unsigned _sum565(uint16_t rgb) {
+	return ((rgb & 0xF800) >> 8) + ((rgb & 0x07E0) >> 3) + ((rgb & 0x001F) << 3);
+}
+
+static inline unsigned _sumX888(uint32_t xrgb) {
+	return ((xrgb >> 16) & 0xFF) + ((xrgb >> 8) & 0xFF) + (xrgb & 0xFF);
+}
+
 static inline uint8_t _convert565ToGray(uint16_t a, uint16_t b) {
 	uint32_t ab = a | (b << 16);
 	uint32_t r0 = ab & 0xF800F800;
@@ -136,36 +194,34 @@ static inline __m128i _halveWNeighbor32(__m128i a, __m128i b) {
 }
 #endif
 
+// Gray halves and quarters average R + G + B over each 2x2 or 4x4 block,
+// rounding down like scaleTo does for every other size
 void imageHalve565ToGray(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 2;
 	for (size_t y = 0; y + 1 < h; y += 2) {
 		size_t x = 0;
 #ifdef __SSSE3__
 		for (; x + 15 < w; x += 16) {
-			__m128i gray0;
-			__m128i gray1;
-
-			gray0 = _convert565ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x])));
-			gray1 = _convert565ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8])));
-			__m128i out0 = _halveW16(gray0, gray1);
-
-			gray0 = _convert565ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride / 2])));
-			gray1 = _convert565ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8 + stride / 2])));
-			__m128i out1 = _halveW16(gray0, gray1);
-
-			// Halve height
-			out0 = _mm_avg_epu16(out0, out1);
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), out0);
+			__m128i sum0 = _mm_add_epi16(_sum565(_loadu(&in[x])), _sum565(_loadu(&in[x + row])));
+			__m128i sum1 = _mm_add_epi16(_sum565(_loadu(&in[x + 8])), _sum565(_loadu(&in[x + 8 + row])));
+			__m128i gray = _mm_srli_epi16(_mm_hadd_epi16(sum0, sum1), 4);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(gray, gray));
+			out += 8;
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 15 < w; x += 16) {
+			uint16x8x2_t pix0 = vld2q_u16(&in[x]);
+			uint16x8x2_t pix1 = vld2q_u16(&in[x + row]);
+			uint16x8_t sum = vaddq_u16(vaddq_u16(_sum565(pix0.val[0]), _sum565(pix0.val[1])), vaddq_u16(_sum565(pix1.val[0]), _sum565(pix1.val[1])));
+			vst1_u8(out, vmovn_u16(vshrq_n_u16(sum, 4)));
 			out += 8;
 		}
 #endif
-		for (; x < w; x += 2) {
-			unsigned gray0 = _convert565ToGray(in[x], in[x + 1]);
-			unsigned gray1 = _convert565ToGray(in[x + stride / 2], in[x + stride / 2 + 1]);
-			*out = (gray0 + gray1) / 2;
+		for (; x + 1 < w; x += 2) {
+			*out = (_sum565(in[x]) + _sum565(in[x + 1]) + _sum565(in[x + row]) + _sum565(in[x + row + 1])) / 16;
 			++out;
 		}
-		in += stride;
+		in += row * 2;
 	}
 }
 
@@ -211,39 +267,44 @@ void imageHalve565ToGrayInterlace(const uint16_t* in, const uint16_t* oldin, uin
 }
 
 void imageQuarter565ToGray(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 2;
 	for (size_t y = 0; y + 3 < h; y += 4) {
 		size_t x = 0;
 #ifdef __SSSE3__
 		for (; x + 31 < w; x += 32) {
-			__m128i gray0;
-			__m128i gray1;
-
-			gray0 = _halveWNeighbor16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8])));
-			gray1 = _halveWNeighbor16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 16])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 24])));
-			gray0 = _convert565ToGray(gray0);
-			gray1 = _convert565ToGray(gray1);
-			__m128i out0 = _halveW16(gray0, gray1);
-
-			gray0 = _halveWNeighbor16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8 + stride])));
-			gray1 = _halveWNeighbor16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 16 + stride])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 24 + stride])));
-			gray0 = _convert565ToGray(gray0);
-			gray1 = _convert565ToGray(gray1);
-			__m128i out1 = _halveW16(gray0, gray1);
-
-			// Halve height
-			out0 = _mm_avg_epu16(out0, out1);
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), out0);
+			__m128i sums[4];
+			for (size_t i = 0; i < 4; ++i) {
+				const uint16_t* column = &in[x + i * 8];
+				__m128i sum0 = _mm_add_epi16(_sum565(_loadu(&column[0])), _sum565(_loadu(&column[row])));
+				__m128i sum1 = _mm_add_epi16(_sum565(_loadu(&column[row * 2])), _sum565(_loadu(&column[row * 3])));
+				sums[i] = _mm_add_epi16(sum0, sum1);
+			}
+			__m128i gray = _mm_hadd_epi16(_mm_hadd_epi16(sums[0], sums[1]), _mm_hadd_epi16(sums[2], sums[3]));
+			gray = _mm_srli_epi16(gray, 6);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(gray, gray));
+			out += 8;
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 31 < w; x += 32) {
+			uint16x8_t sum = vdupq_n_u16(0);
+			for (size_t i = 0; i < 4; ++i) {
+				uint16x8x4_t pix = vld4q_u16(&in[x + i * row]);
+				sum = vaddq_u16(sum, vaddq_u16(vaddq_u16(_sum565(pix.val[0]), _sum565(pix.val[1])), vaddq_u16(_sum565(pix.val[2]), _sum565(pix.val[3]))));
+			}
+			vst1_u8(out, vmovn_u16(vshrq_n_u16(sum, 6)));
 			out += 8;
 		}
 #endif
 		for (; x + 3 < w; x += 4) {
-			unsigned gray0 = _convert565ToGray(in[x], in[x + 2]);
-			unsigned gray1 = _convert565ToGray(in[x + stride], in[x + stride + 2]);
-			*out = (gray0 + gray1) / 2;
+			unsigned sum = 0;
+			for (size_t i = 0; i < 4; ++i) {
+				const uint16_t* line = &in[x + i * row];
+				sum += _sum565(line[0]) + _sum565(line[1]) + _sum565(line[2]) + _sum565(line[3]);
+			}
+			*out = sum / 64;
 			++out;
 		}
-		in += stride * 2;
+		in += row * 4;
 	}
 }
 
@@ -330,8 +391,8 @@ static inline void _convert565To888(const __m128i* in, __m128i* out) {
 	/* 00 B8 00 B9 00 BA 00 BB 00 BC 00 BD 00 BE 00 BF -> BA 00 00 BB 00 00 BC 00 00 BD 00 00 BE 00 00 BF */
 	const static __m128i bblend21 = _mm_set_epi8(0x0E, 0x80, 0x80, 0x0C, 0x80, 0x80, 0x0A, 0x80, 0x80, 0x08, 0x80, 0x80, 0x06, 0x80, 0x80, 0x04);
 
-	__m128i pix0 = _mm_load_si128(&in[0]);
-	__m128i pix1 = _mm_load_si128(&in[1]);
+	__m128i pix0 = _mm_loadu_si128(&in[0]);
+	__m128i pix1 = _mm_loadu_si128(&in[1]);
 
 	// Mask out channels
 	__m128i r0 = _mm_and_si128(pix0, maskR16);
@@ -365,9 +426,9 @@ static inline void _convert565To888(const __m128i* in, __m128i* out) {
 	out2 = _mm_or_si128(out2, _mm_shuffle_epi8(g1, gblend21));
 	out2 = _mm_or_si128(out2, _mm_shuffle_epi8(b1, bblend21));
 
-	_mm_store_si128(&out[0], out0);
-	_mm_store_si128(&out[1], out1);
-	_mm_store_si128(&out[2], out2);
+	_mm_storeu_si128(&out[0], out0);
+	_mm_storeu_si128(&out[1], out1);
+	_mm_storeu_si128(&out[2], out2);
 }
 #endif
 
@@ -375,10 +436,20 @@ void image565To888(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t
 	for (size_t y = 0; y < h; ++y) {
 		size_t x = 0;
 #ifdef __SSSE3__
-		for (; x < w; x += 16) {
+		for (; x + 15 < w; x += 16) {
 			_convert565To888(reinterpret_cast<const __m128i*>(&in[x]), reinterpret_cast<__m128i*>(out));
 			out += 16 * 3;
 		}
+#elif defined(__ARM_NEON)
+		for (; x + 7 < w; x += 8) {
+			uint16x8_t pix = vld1q_u16(&in[x]);
+			uint8x8x3_t rgb;
+			rgb.val[0] = vshrn_n_u16(vandq_u16(pix, vdupq_n_u16(0xF800)), 8);
+			rgb.val[1] = vshrn_n_u16(vandq_u16(pix, vdupq_n_u16(0x07E0)), 3);
+			rgb.val[2] = vmovn_u16(vshlq_n_u16(vandq_u16(pix, vdupq_n_u16(0x001F)), 3));
+			vst3_u8(out, rgb);
+			out += 8 * 3;
+		}
 #endif
 		for (; x < w; ++x) {
 			uint16_t rgb = in[x];
@@ -392,35 +463,33 @@ void image565To888(const uint16_t* in, uint8_t* out, size_t w, size_t h, size_t
 }
 
 void imageHalveX888ToGray(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 4;
 	for (size_t y = 0; y + 1 < h; y += 2) {
 		size_t x = 0;
 #ifdef __SSSE3__
-		for (; x + 7 < w; x += 8) {
-			__m128i gray0;
-			__m128i gray1;
-
-			gray0 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x])));
-			gray1 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4])));
-			__m128i out0 = _halveW32(gray0, gray1);
-
-			gray0 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride / 2])));
-			gray1 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4 + stride / 2])));
-			__m128i out1 = _halveW32(gray0, gray1);
-
-			// Halve height
-			out0 = _mm_avg_epu16(out0, out1);
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			unsigned outx = _mm_cvtsi128_si32(out0);
-			*reinterpret_cast<uint32_t*>(out) = outx;
-			out += 4;
+		for (; x + 15 < w; x += 16) {
+			__m128i pairs[4];
+			for (size_t i = 0; i < 4; ++i) {
+				pairs[i] = _mm_add_epi16(_pairsX888(_loadu(&in[x + i * 4])), _pairsX888(_loadu(&in[x + i * 4 + row])));
+			}
+			/* Each column's R + G + B, then each block's */
+			__m128i gray = _mm_hadd_epi16(_mm_hadd_epi16(pairs[0], pairs[1]), _mm_hadd_epi16(pairs[2], pairs[3]));
+			gray = _mm_srli_epi16(gray, 4);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(gray, gray));
+			out += 8;
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 15 < w; x += 16) {
+			uint16x8_t sum = vaddq_u16(_pairSumsX888(&in[x]), _pairSumsX888(&in[x + row]));
+			vst1_u8(out, vmovn_u16(vshrq_n_u16(sum, 4)));
+			out += 8;
 		}
 #endif
 		for (; x + 1 < w; x += 2) {
-			*out = _convertX888ToGray(in[x], in[x + 1]);
+			*out = (_sumX888(in[x]) + _sumX888(in[x + 1]) + _sumX888(in[x + row]) + _sumX888(in[x + row + 1])) / 16;
 			++out;
 		}
-		in += stride / 2;
+		in += row * 2;
 	}
 }
 
@@ -436,8 +505,8 @@ void imageHalveX888ToGrayInterlace(const uint32_t* in, const uint16_t* oldin, ui
 			gray1 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4])));
 			__m128i out0 = _halveW32(gray0, gray1);
 
-			gray0 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride / 2])));
-			gray1 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4 + stride / 2])));
+			gray0 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride / 4])));
+			gray1 = _convertX888ToGray(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4 + stride / 4])));
 			__m128i out1 = _halveW32(gray0, gray1);
 
 			// Halve height
@@ -455,6 +524,8 @@ void imageHalveX888ToGrayInterlace(const uint32_t* in, const uint16_t* oldin, ui
 #endif
 		for (; x + 1 < w; x += 2) {
 			unsigned gray0 = _convertX888ToGray(in[x], in[x + 1]);
+			unsigned gray1 = _convertX888ToGray(in[x + stride / 4], in[x + stride / 4 + 1]);
+			gray0 = (gray0 + gray1) / 2;
 			gray0 |= *oldin << 8;
 			*out = gray0;
 			++oldin;
@@ -465,41 +536,47 @@ void imageHalveX888ToGrayInterlace(const uint32_t* in, const uint16_t* oldin, ui
 }
 
 void imageQuarterX888ToGray(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t stride) {
+	const size_t row = stride / 4;
 	for (size_t y = 0; y + 3 < h; y += 4) {
 		size_t x = 0;
 #ifdef __SSSE3__
 		for (; x + 15 < w; x += 16) {
-			__m128i gray0;
-			__m128i gray1;
-
-			gray0 = _halveWNeighbor32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4])));
-			gray1 = _halveWNeighbor32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 12])));
-			gray0 = _convertX888ToGray(gray0);
-			gray1 = _convertX888ToGray(gray1);
-			__m128i out0 = _halveW32(gray0, gray1);
-
-			gray0 = _halveWNeighbor32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + stride / 2])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4 + stride / 2])));
-			gray1 = _halveWNeighbor32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8 + stride / 2])), _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 12 + stride / 2])));
-			gray0 = _convertX888ToGray(gray0);
-			gray1 = _convertX888ToGray(gray1);
-			__m128i out1 = _halveW32(gray0, gray1);
-
-			// Halve height
-			out0 = _mm_avg_epu16(out0, out1);
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			out0 = _mm_packus_epi16(out0, _mm_undefined_si128());
-			unsigned outx = _mm_cvtsi128_si32(out0);
+			__m128i pairs[4];
+			for (size_t i = 0; i < 4; ++i) {
+				const uint32_t* column = &in[x + i * 4];
+				__m128i sum0 = _mm_add_epi16(_pairsX888(_loadu(&column[0])), _pairsX888(_loadu(&column[row])));
+				__m128i sum1 = _mm_add_epi16(_pairsX888(_loadu(&column[row * 2])), _pairsX888(_loadu(&column[row * 3])));
+				pairs[i] = _mm_add_epi16(sum0, sum1);
+			}
+			/* Each column's R + G + B, then pairs of columns, then blocks */
+			__m128i gray = _mm_hadd_epi16(_mm_hadd_epi16(pairs[0], pairs[1]), _mm_hadd_epi16(pairs[2], pairs[3]));
+			gray = _mm_srli_epi16(_mm_hadd_epi16(gray, gray), 6);
+			unsigned outx = _mm_cvtsi128_si32(_mm_packus_epi16(gray, gray));
 			*reinterpret_cast<uint32_t*>(out) = outx;
 			out += 4;
 		}
+#elif defined(__ARM_NEON)
+		for (; x + 15 < w; x += 16) {
+			uint16x8_t sum = vdupq_n_u16(0);
+			for (size_t i = 0; i < 4; ++i) {
+				sum = vaddq_u16(sum, _pairSumsX888(&in[x + i * row]));
+			}
+			uint16x4_t gray = vshr_n_u16(vpadd_u16(vget_low_u16(sum), vget_high_u16(sum)), 6);
+			uint8x8_t bytes = vmovn_u16(vcombine_u16(gray, gray));
+			vst1_lane_u32(reinterpret_cast<uint32_t*>(out), vreinterpret_u32_u8(bytes), 0);
+			out += 4;
+		}
 #endif
 		for (; x + 3 < w; x += 4) {
-			unsigned gray0 = _convertX888ToGray(in[x], in[x + 2]);
-			unsigned gray1 = _convertX888ToGray(in[x + stride / 2], in[x + stride / 2 + 2]);
-			*out = (gray0 + gray1) / 2;
+			unsigned sum = 0;
+			for (size_t i = 0; i < 4; ++i) {
+				const uint32_t* line = &in[x + i * row];
+				sum += _sumX888(line[0]) + _sumX888(line[1]) + _sumX888(line[2]) + _sumX888(line[3]);
+			}
+			*out = sum / 64;
 			++out;
 		}
-		in += stride;
+		in += row * 4;
 	}
 }
 
@@ -572,10 +649,10 @@ void imageX888To888(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t
 			/* BC GC RC XC BD GD RD XD BE GE RE XE BF GF RF XF -> 00 00 00 00 RC GC BC RD GD BD RE GE BE RF GF DF */
 			const static __m128i blend23 = _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x08, 0x09, 0x0A, 0x04, 0x05, 0x06, 0x00, 0x01, 0x02, 0x80, 0x80, 0x80, 0x80);
 
-			__m128i pix0 = _mm_load_si128(reinterpret_cast<const __m128i*>(&in[x]));
-			__m128i pix1 = _mm_load_si128(reinterpret_cast<const __m128i*>(&in[x + 4]));
-			__m128i pix2 = _mm_load_si128(reinterpret_cast<const __m128i*>(&in[x + 8]));
-			__m128i pix3 = _mm_load_si128(reinterpret_cast<const __m128i*>(&in[x + 12]));
+			__m128i pix0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x]));
+			__m128i pix1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 4]));
+			__m128i pix2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 8]));
+			__m128i pix3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[x + 12]));
 
 			__m128i out0 = _mm_shuffle_epi8(pix0, blend00);
 			out0 = _mm_or_si128(out0, _mm_shuffle_epi8(pix1, blend01));
@@ -591,18 +668,63 @@ void imageX888To888(const uint32_t* in, uint8_t* out, size_t w, size_t h, size_t
 			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[32]), out2);
 			out += 48;
 		}
+#elif defined(__ARM_NEON)
+		for (; x + 15 < w; x += 16) {
+			uint8x16x4_t bgrx = vld4q_u8(reinterpret_cast<const uint8_t*>(&in[x]));
+			uint8x16x3_t rgb;
+			rgb.val[0] = bgrx.val[2];
+			rgb.val[1] = bgrx.val[1];
+			rgb.val[2] = bgrx.val[0];
+			vst3q_u8(out, rgb);
+			out += 48;
+		}
 #endif
 		for (; x < w; ++x) {
 			uint32_t xrgb = in[x];
-			out[0] = xrgb;
+			out[0] = xrgb >> 16;
 			out[1] = xrgb >> 8;
-			out[2] = xrgb >> 16;
+			out[2] = xrgb;
 			out += 3;
 		}
 		in += stride / 4;
 	}
 }
 
+static const ImageOps::Kernels s_baseKernels{
+#ifdef __SSSE3__
+	"ssse3",
+#elif defined(__ARM_NEON)
+	"neon",
+#else
+	"scalar",
+#endif
+	image565To888,
+	imageX888To888,
+	imageHalve565ToGray,
+	imageHalveX888ToGray,
+	imageQuarter565ToGray,
+	imageQuarterX888ToGray,
+};
+
+static const ImageOps::Kernels* selectKernels() {
+#if defined(__SSSE3__) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (ImageOps::avx2Kernels() && __builtin_cpu_supports("avx2")) {
+		return ImageOps::avx2Kernels();
+	}
+#endif
+	return &s_baseKernels;
+}
+
+const ImageOps::Kernels* ImageOps::baseKernels() {
+	return &s_baseKernels;
+}
+
+const ImageOps::Kernels* ImageOps::activeKernels() {
+	static const ImageOps::Kernels* s_kernels = selectKernels();
+	return s_kernels;
+}
+
 Image::Image(Format format, const void* in, size_t w, size_t h, size_t stride)
 	: m_constBuffer(in)
 	, m_w(w)
@@ -631,7 +753,7 @@ void Image::copyTo(Image* other) {
 			copyDirectlyTo(other);
 			break;
 		case Image::Format::RGB888:
-			image565To888(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->image565To888(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -641,6 +763,7 @@ void Image::copyTo(Image* other) {
 		switch (other->m_format) {
 		case Image::Format::RGB888:
 			copyDirectlyTo(other);
+			break;
 		default:
 			throw logic_error("unimplemented conversion");
 		}
@@ -651,7 +774,7 @@ void Image::copyTo(Image* other) {
 			copyDirectlyTo(other);
 			break;
 		case Image::Format::RGB888:
-			imageX888To888(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->imageX888To888(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -661,6 +784,7 @@ void Image::copyTo(Image* other) {
 		switch (other->m_format) {
 		case Image::Format::G8:
 			copyDirectlyTo(other);
+			break;
 		default:
 			throw logic_error("unimplemented conversion");
 		}
@@ -676,7 +800,7 @@ void Image::halveTo(Image* other) {
 	case Image::Format::RGB565:
 		switch (other->m_format) {
 		case Image::Format::G8:
-			imageHalve565ToGray(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->imageHalve565ToGray(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -687,7 +811,7 @@ void Image::halveTo(Image* other) {
 	case Image::Format::RGBX888:
 		switch (other->m_format) {
 		case Image::Format::G8:
-			imageHalveX888ToGray(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->imageHalveX888ToGray(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -739,7 +863,7 @@ void Image::quarterTo(Image* other) {
 	case Image::Format::RGB565:
 		switch (other->m_format) {
 		case Image::Format::G8:
-			imageQuarter565ToGray(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->imageQuarter565ToGray(static_cast<const uint16_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -750,7 +874,7 @@ void Image::quarterTo(Image* other) {
 	case Image::Format::RGBX888:
 		switch (other->m_format) {
 		case Image::Format::G8:
-			imageQuarterX888ToGray(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
+			ImageOps::activeKernels()->imageQuarterX888ToGray(static_cast<const uint32_t*>(m_constBuffer), static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride);
 			break;
 		default:
 			throw logic_error("unimplemented conversion");
@@ -834,28 +958,316 @@ void Image::divideToInterlace(int divisor, Image* other, const Image* old) {
 	}
 }
 
-void Image::copyDirectlyTo(Image* other) {
-	size_t depth = 1;
+// Adds each source pixel's R + G + B (gray) or its three channels (RGB) to
+// per-column sums, scaled to 8 bits per channel. RGB sums are kept as three
+// planes of w columns each.
+static void accumulate565(const uint16_t* in, uint32_t* columns, size_t w, bool gray) {
+	size_t x = 0;
+#ifdef __SSSE3__
+	for (; x + 7 < w; x += 8) {
+		__m128i pix = _loadu(&in[x]);
+		if (gray) {
+			_accumulate16(_sum565(pix), &columns[x]);
+		} else {
+			_accumulate16(_mm_srli_epi16(_mm_and_si128(pix, maskR16), 8), &columns[x]);
+			_accumulate16(_mm_srli_epi16(_mm_and_si128(pix, maskG16), 3), &columns[w + x]);
+			_accumulate16(_mm_slli_epi16(_mm_and_si128(pix, maskB16), 3), &columns[w * 2 + x]);
+		}
+	}
+#elif defined(__ARM_NEON)
+	for (; x + 7 < w; x += 8) {
+		uint16x8_t pix = vld1q_u16(&in[x]);
+		if (gray) {
+			_accumulate16(_sum565(pix), &columns[x]);
+		} else {
+			_accumulate16(vshrq_n_u16(vandq_u16(pix, vdupq_n_u16(0xF800)), 8), &columns[x]);
+			_accumulate16(vshrq_n_u16(vandq_u16(pix, vdupq_n_u16(0x07E0)), 3), &columns[w + x]);
+			_accumulate16(vshlq_n_u16(vandq_u16(pix, vdupq_n_u16(0x001F)), 3), &columns[w * 2 + x]);
+		}
+	}
+#endif
+	for (; x < w; ++x) {
+		uint16_t rgb = in[x];
+		if (gray) {
+			columns[x] += _sum565(rgb);
+		} else {
+			columns[x] += (rgb & 0xF800) >> 8;
+			columns[w + x] += (rgb & 0x07E0) >> 3;
+			columns[w * 2 + x] += (rgb & 0x001F) << 3;
+		}
+	}
+}
+
+static void accumulateX888(const uint32_t* in, uint32_t* columns, size_t w, bool gray) {
+	size_t x = 0;
+#ifdef __SSSE3__
+	for (; x + 7 < w; x += 8) {
+		__m128i pix0 = _loadu(&in[x]);
+		__m128i pix1 = _loadu(&in[x + 4]);
+		if (gray) {
+			_accumulate16(_mm_hadd_epi16(_pairsX888(pix0), _pairsX888(pix1)), &columns[x]);
+		} else {
+			const __m128i* masks[3]{ &maskR32, &maskG32, &maskB32 };
+			for (size_t c = 0; c < 3; ++c) {
+				/* Each channel fits in the low half of its 32-bit lane */
+				__m128i channel = _mm_packs_epi32(_mm_shuffle_epi8(pix0, *masks[c]), _mm_shuffle_epi8(pix1, *masks[c]));
+				_accumulate16(channel, &columns[w * c + x]);
+			}
+		}
+	}
+#elif defined(__ARM_NEON)
+	for (; x + 7 < w; x += 8) {
+		uint8x8x4_t bgrx = vld4_u8(reinterpret_cast<const uint8_t*>(&in[x]));
+		if (gray) {
+			_accumulate16(vaddw_u8(vaddl_u8(bgrx.val[0], bgrx.val[1]), bgrx.val[2]), &columns[x]);
+		} else {
+			_accumulate16(vmovl_u8(bgrx.val[2]), &columns[x]);
+			_accumulate16(vmovl_u8(bgrx.val[1]), &columns[w + x]);
+			_accumulate16(vmovl_u8(bgrx.val[0]), &columns[w * 2 + x]);
+		}
+	}
+#endif
+	for (; x < w; ++x) {
+		uint32_t xrgb = in[x];
+		if (gray) {
+			columns[x] += _sumX888(xrgb);
+		} else {
+			columns[x] += (xrgb >> 16) & 0xFF;
+			columns[w + x] += (xrgb >> 8) & 0xFF;
+			columns[w * 2 + x] += xrgb & 0xFF;
+		}
+	}
+}
+
+// Scratch space kept between frames, so scaling a stream of same-sized
+// frames doesn't allocate
+struct ScaleScratch {
+	size_t w = 0;
+	size_t ow = 0;
+	vector<size_t> spans;
+	vector<uint32_t> columns;
+};
+
+static thread_local ScaleScratch s_scaleScratch;
+
+// Division by a divisor fixed for a whole output row. Averaged sums are at
+// most 255 * d, so for d below 4096 multiplying by the rounded-up reciprocal
+// is exact and saves a divide per output pixel.
+struct Divisor {
+	Divisor(uint32_t d)
+		: d(d)
+		, m(d < 4096 ? ((uint64_t(1) << 32) + d - 1) / d : 0) {
+	}
+
+	uint32_t divide(uint32_t n) const {
+		return m ? (n * m) >> 32 : n / d;
+	}
+
+	uint32_t d;
+	uint64_t m;
+};
+
+// Averages the columns each output pixel covers, for each plane
+template<size_t channels>
+static void reduceColumns(const uint32_t* columns, uint8_t* out, size_t w, size_t ow, const size_t* spans, size_t spanWidth, const Divisor* divisors) {
+	for (size_t x = 0; x < ow; ++x) {
+		size_t start = spans[x];
+		size_t end = spans[x + 1];
+		const Divisor& count = divisors[end - start - spanWidth];
+		for (size_t c = 0; c < channels; ++c) {
+			const uint32_t* plane = &columns[w * c];
+			uint32_t sum = 0;
+			for (size_t sx = start; sx < end; ++sx) {
+				sum += plane[sx];
+			}
+			out[x * channels + c] = count.divide(sum);
+		}
+	}
+}
+
+// Area-averages in down to ow x oh: source rows are summed per column, then
+// each output pixel adds up the columns it covers
+template<typename Pixel>
+static void imageScale(const void* in, uint8_t* out, size_t w, size_t h, size_t stride, size_t ow, size_t oh, bool gray, void (*accumulate)(const Pixel*, uint32_t*, size_t, bool)) {
+	ScaleScratch& scratch = s_scaleScratch;
+	if (scratch.w != w || scratch.ow != ow) {
+		scratch.spans.resize(ow + 1);
+		for (size_t x = 0; x <= ow; ++x) {
+			scratch.spans[x] = x * w / ow;
+		}
+		scratch.w = w;
+		scratch.ow = ow;
+	}
+	const size_t* spans = scratch.spans.data();
+	size_t channels = gray ? 1 : 3;
+	scratch.columns.resize(w * 3);
+	uint32_t* columns = scratch.columns.data();
+	// Columns are split into spans of one of two widths
+	size_t spanWidth = w / ow;
+
+	for (size_t y = 0; y < oh; ++y) {
+		size_t y0 = y * h / oh;
+		size_t y1 = max((y + 1) * h / oh, y0 + 1);
+		size_t scale = (y1 - y0) * (gray ? 4 : 1);
+		const Divisor divisors[2]{ Divisor(scale * spanWidth), Divisor(scale * (spanWidth + 1)) };
+		memset(columns, 0, w * channels * sizeof(*columns));
+		for (size_t sy = y0; sy < y1; ++sy) {
+			accumulate(reinterpret_cast<const Pixel*>(&static_cast<const uint8_t*>(in)[sy * stride]), columns, w, gray);
+		}
+		if (gray) {
+			reduceColumns<1>(columns, out, w, ow, spans, spanWidth, divisors);
+		} else {
+			reduceColumns<3>(columns, out, w, ow, spans, spanWidth, divisors);
+		}
+		out += ow * channels;
+	}
+}
+
+void Image::scaleTo(Image* other) {
+	if (!other->m_w || !other->m_h || other->m_w > m_w || other->m_h > m_h) {
+		throw invalid_argument("Image dimensions don't match");
+	}
+	if (other->m_format != Image::Format::G8 && other->m_format != Image::Format::RGB888) {
+		throw logic_error("unimplemented conversion");
+	}
+	bool gray = other->m_format == Image::Format::G8;
+	if (!gray && m_w == other->m_w && m_h == other->m_h) {
+		copyTo(other);
+		return;
+	}
+	// Exact gray halves and quarters have their own kernels, which average
+	// the same way as every other size
+	if (gray && m_w == other->m_w * 2 && m_h == other->m_h * 2) {
+		halveTo(other);
+		return;
+	}
+	if (gray && m_w == other->m_w * 4 && m_h == other->m_h * 4) {
+		quarterTo(other);
+		return;
+	}
 	switch (m_format) {
 	case Image::Format::RGB565:
-		depth = 2;
-		break;
-	case Image::Format::RGB888:
-		depth = 3;
+		imageScale<uint16_t>(m_constBuffer, static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride, other->m_w, other->m_h, gray, accumulate565);
 		break;
 	case Image::Format::RGBX888:
-		depth = 4;
+		imageScale<uint32_t>(m_constBuffer, static_cast<uint8_t*>(other->m_buffer), m_w, m_h, m_stride, other->m_w, other->m_h, gray, accumulateX888);
 		break;
+	default:
+		throw logic_error("unimplemented conversion");
+	}
+}
+
+static void imageMax565(const uint16_t* a, const uint16_t* b, uint16_t* out, size_t w, size_t h, size_t strideA, size_t strideB, size_t strideOut) {
+	for (size_t y = 0; y < h; ++y) {
+		size_t x = 0;
+#ifdef __SSSE3__
+		for (; x + 7 < w; x += 8) {
+			__m128i pixA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[x]));
+			__m128i pixB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[x]));
+			/* Only signed 16-bit compares are available, so keep red clear of the sign bit */
+			__m128i r = _mm_max_epi16(_mm_srli_epi16(pixA, 1), _mm_srli_epi16(pixB, 1));
+			r = _mm_and_si128(_mm_slli_epi16(r, 1), maskR16);
+			__m128i g = _mm_max_epi16(_mm_and_si128(pixA, maskG16), _mm_and_si128(pixB, maskG16));
+			__m128i b = _mm_max_epi16(_mm_and_si128(pixA, maskB16), _mm_and_si128(pixB, maskB16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[x]), _mm_or_si128(_mm_or_si128(r, g), b));
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 7 < w; x += 8) {
+			uint16x8_t pixA = vld1q_u16(&a[x]);
+			uint16x8_t pixB = vld1q_u16(&b[x]);
+			uint16x8_t r = vmaxq_u16(vandq_u16(pixA, vdupq_n_u16(0xF800)), vandq_u16(pixB, vdupq_n_u16(0xF800)));
+			uint16x8_t g = vmaxq_u16(vandq_u16(pixA, vdupq_n_u16(0x07E0)), vandq_u16(pixB, vdupq_n_u16(0x07E0)));
+			uint16x8_t b = vmaxq_u16(vandq_u16(pixA, vdupq_n_u16(0x001F)), vandq_u16(pixB, vdupq_n_u16(0x001F)));
+			vst1q_u16(&out[x], vorrq_u16(vorrq_u16(r, g), b));
+		}
+#endif
+		for (; x < w; ++x) {
+			uint16_t pixA = a[x];
+			uint16_t pixB = b[x];
+			out[x] = max(pixA & 0xF800, pixB & 0xF800) | max(pixA & 0x07E0, pixB & 0x07E0) | max(pixA & 0x001F, pixB & 0x001F);
+		}
+		a += strideA / 2;
+		b += strideB / 2;
+		out += strideOut / 2;
+	}
+}
+
+static void imageMax8(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t w, size_t h, size_t strideA, size_t strideB, size_t strideOut) {
+	for (size_t y = 0; y < h; ++y) {
+		size_t x = 0;
+#ifdef __SSSE3__
+		for (; x + 15 < w; x += 16) {
+			__m128i pixA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[x]));
+			__m128i pixB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[x]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&out[x]), _mm_max_epu8(pixA, pixB));
+		}
+#elif defined(__ARM_NEON)
+		for (; x + 15 < w; x += 16) {
+			vst1q_u8(&out[x], vmaxq_u8(vld1q_u8(&a[x]), vld1q_u8(&b[x])));
+		}
+#endif
+		for (; x < w; ++x) {
+			out[x] = max(a[x], b[x]);
+		}
+		a += strideA;
+		b += strideB;
+		out += strideOut;
+	}
+}
+
+void Image::maxTo(const Image& other, Image* out) const {
+	if (m_w != other.m_w || m_h != other.m_h || m_w != out->m_w || m_h != out->m_h) {
+		throw invalid_argument("Image dimensions don't match");
+	}
+	if (m_format != other.m_format || m_format != out->m_format) {
+		throw invalid_argument("Image formats don't match");
+	}
+	if (m_format == Image::Format::RGB565) {
+		imageMax565(static_cast<const uint16_t*>(m_constBuffer), static_cast<const uint16_t*>(other.m_constBuffer), static_cast<uint16_t*>(out->m_buffer), m_w, m_h, m_stride, other.m_stride, out->m_stride);
+	} else {
+		imageMax8(static_cast<const uint8_t*>(m_constBuffer), static_cast<const uint8_t*>(other.m_constBuffer), static_cast<uint8_t*>(out->m_buffer), m_w * depth(), m_h, m_stride, other.m_stride, out->m_stride);
+	}
+}
+
+Image Image::crop(size_t x, size_t y, size_t w, size_t h) const {
+	if (x + w > m_w || y + h > m_h) {
+		throw invalid_argument("Crop exceeds image dimensions");
+	}
+	Image cropped(*this);
+	size_t offset = y * m_stride + x * depth();
+	if (m_constBuffer) {
+		cropped.m_constBuffer = &static_cast<const uint8_t*>(m_constBuffer)[offset];
+	}
+	if (m_buffer) {
+		cropped.m_buffer = &static_cast<uint8_t*>(m_buffer)[offset];
+	}
+	cropped.m_w = w;
+	cropped.m_h = h;
+	return cropped;
+}
+
+size_t Image::depth() const {
+	switch (m_format) {
+	case Image::Format::RGB565:
+		return 2;
+	case Image::Format::RGB888:
+		return 3;
+	case Image::Format::RGBX888:
+		return 4;
 	case Image::Format::G8:
 		break;
 	}
-	if (m_stride == other->m_stride) {
+	return 1;
+}
+
+void Image::copyDirectlyTo(Image* other) {
+	if (m_stride == other->m_stride && m_stride == depth() * m_w) {
 		memcpy(other->m_buffer, m_constBuffer, m_stride * m_h);
 	} else {
 		const uint8_t* in = static_cast<const uint8_t*>(m_constBuffer);
 		uint8_t* out = static_cast<uint8_t*>(other->m_buffer);
 		for (size_t y = 0; y < m_h; ++y) {
-			memcpy(&out[other->m_stride * y], &in[m_stride * y], depth * y * m_w);
+			memcpy(&out[other->m_stride * y], &in[m_stride * y], depth() * m_w);
 		}
 	}
 }
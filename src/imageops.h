@@ -19,6 +19,12 @@ public:
 	Image(Format, void* in, size_t w, size_t h, size_t stride);
 	Image(const Image&) = default;
 
+	size_t width() const { return m_w; }
+	size_t height() const { return m_h; }
+
+	// Returns a view of a sub-rectangle sharing this image's buffer
+	Image crop(size_t x, size_t y, size_t w, size_t h) const;
+
 	void copyTo(Image* other);
 	void halveTo(Image* other);
 	void halveToInterlace(Image* other, const Image* old);
@@ -27,14 +33,23 @@ public:
 	void divideTo(int divisor, Image* other);
 	void divideToInterlace(int divisor, Image* other, const Image* old);
 
+	// Area-averages this image down to the size of other, converting to its
+	// format (RGB888 or G8) in the same pass. Exact gray halves and quarters
+	// go through halveTo and quarterTo, which average the same way
+	void scaleTo(Image* other);
+
+	// Writes the per-channel maximum of this image and other to out
+	void maxTo(const Image& other, Image* out) const;
+
 private:
+	size_t depth() const;
 	void copyDirectlyTo(Image* other);
 
 	const void* m_constBuffer = nullptr;
 	void* m_buffer = nullptr;
-	size_t m_w;
-	size_t m_h;
-	size_t m_stride;
+	size_t m_w = 0;
+	size_t m_h = 0;
+	size_t m_stride = 0;
 	Format m_format;
 };
 }
@@ -1,6 +1,8 @@
 #include "memory.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <unordered_map>
 
 using namespace Retro;
@@ -182,6 +184,19 @@ void MemoryOverlay::unparse(void* out, size_t offset, const void* in, size_t siz
 	}
 }
 
+size_t MemoryOverlay::swizzle() const {
+	Endian backing = reduce(m_backing.endian);
+	Endian real = reduce(m_real.endian);
+	if (width <= 1 || backing == real) {
+		return 0;
+	}
+	bool plain = (backing == Endian::LITTLE || backing == Endian::BIG) && (real == Endian::LITTLE || real == Endian::BIG);
+	if (!plain || (width & (width - 1))) {
+		return SIZE_MAX;
+	}
+	return width - 1;
+}
+
 Variant::Variant(int64_t i)
 	: m_type(Type::INT)
 	, m_vi(i) {
@@ -329,6 +344,7 @@ void AddressSpace::addBlock(size_t offset, size_t size, void* data) {
 	} else {
 		m_blocks[offset].open(size);
 	}
+	reindex();
 }
 
 void AddressSpace::addBlock(size_t offset, size_t size, const void* data) {
@@ -337,58 +353,208 @@ void AddressSpace::addBlock(size_t offset, size_t size, const void* data) {
 	} else {
 		m_blocks[offset].open(size);
 	}
+	reindex();
 }
 
 void AddressSpace::addBlock(size_t offset, const MemoryView<>& base) {
 	m_blocks[offset].clone(base);
+	reindex();
 }
 
 void AddressSpace::updateBlock(size_t offset, void* data) {
 	m_blocks[offset].open(data, m_blocks[offset].size());
+	reindex();
 }
 
 void AddressSpace::updateBlock(size_t offset, const void* data) {
 	m_blocks[offset].clone(data, m_blocks[offset].size());
+	reindex();
 }
 
 void AddressSpace::updateBlock(size_t offset, const MemoryView<>& base) {
 	m_blocks[offset].clone(base);
+	reindex();
 }
 
-bool AddressSpace::hasBlock(size_t offset) const {
-	for (const auto& block : m_blocks) {
-		if (offset < block.first) {
+void AddressSpace::reindex() {
+	static atomic<uint64_t> s_layouts{ 0 };
+	m_layout = ++s_layouts;
+	m_spans.clear();
+	size_t covered = 0;
+	for (auto& kv : m_blocks) {
+		size_t start = max(kv.first, covered);
+		size_t end = kv.first + kv.second.size();
+		if (end <= start) {
 			continue;
 		}
-		if (offset < block.first + block.second.size()) {
-			return true;
+		m_spans.push_back(Span{ start, end, kv.first, &kv.second });
+		covered = end;
+	}
+	m_lastSpan.store(0, memory_order_relaxed);
+}
+
+const AddressSpace::Span* AddressSpace::find(size_t offset) const {
+	// Consecutive lookups usually land in the same block
+	size_t last = m_lastSpan.load(memory_order_relaxed);
+	if (last < m_spans.size() && offset - m_spans[last].start < m_spans[last].end - m_spans[last].start) {
+		return &m_spans[last];
+	}
+	auto span = upper_bound(m_spans.begin(), m_spans.end(), offset, [](size_t offset, const Span& span) {
+		return offset < span.start;
+	});
+	if (span == m_spans.begin()) {
+		return nullptr;
+	}
+	--span;
+	if (offset >= span->end) {
+		return nullptr;
+	}
+	m_lastSpan.store(span - m_spans.begin(), memory_order_relaxed);
+	return &*span;
+}
+
+// Matches DataType::decode for plain little or big endian types, with the
+// byte order and representation fixed at compile time
+template<size_t W, bool BIG, Repr R>
+static int64_t decodeFixed(const uint8_t* in) {
+	uint64_t datum = 0;
+	for (size_t i = 0; i < W; ++i) {
+		uint8_t b = in[BIG ? i : W - 1 - i];
+		switch (R) {
+		case Repr::SIGNED:
+		case Repr::UNSIGNED:
+			datum = datum << 8 | b;
+			break;
+		case Repr::BCD:
+			datum = datum * 100 + (b & 0xF) % 10 + (b >> 4) % 10 * 10;
+			break;
+		case Repr::LN_BCD:
+			datum = datum * 10 + (b & 0xF) % 10;
+			break;
 		}
 	}
-	return false;
+	if (R == Repr::SIGNED && W < 8) {
+		return static_cast<int64_t>(datum << (64 - 8 * W)) >> (64 - 8 * W);
+	}
+	return datum;
 }
 
-const MemoryView<>& AddressSpace::block(size_t offset) const {
+template<size_t W, bool BIG>
+static int64_t (*pickDecoder(Repr repr))(const uint8_t*) {
+	switch (repr) {
+	case Repr::SIGNED:
+		return decodeFixed<W, BIG, Repr::SIGNED>;
+	case Repr::UNSIGNED:
+		return decodeFixed<W, BIG, Repr::UNSIGNED>;
+	case Repr::BCD:
+		return decodeFixed<W, BIG, Repr::BCD>;
+	case Repr::LN_BCD:
+		return decodeFixed<W, BIG, Repr::LN_BCD>;
+	}
+	return nullptr;
+}
+
+template<size_t W>
+static int64_t (*pickDecoder(Endian endian, Repr repr))(const uint8_t*) {
+	switch (reduce(endian)) {
+	case Endian::BIG:
+		return pickDecoder<W, true>(repr);
+	case Endian::LITTLE:
+	case Endian::UNDEF:
+		return pickDecoder<W, false>(repr);
+	default:
+		return nullptr;
+	}
+}
+
+static int64_t (*pickDecoder(const DataType& type))(const uint8_t*) {
+	switch (type.width) {
+	case 1:
+		return pickDecoder<1>(type.endian, type.repr);
+	case 2:
+		return pickDecoder<2>(type.endian, type.repr);
+	case 3:
+		return pickDecoder<3>(type.endian, type.repr);
+	case 4:
+		return pickDecoder<4>(type.endian, type.repr);
+	case 5:
+		return pickDecoder<5>(type.endian, type.repr);
+	case 6:
+		return pickDecoder<6>(type.endian, type.repr);
+	case 7:
+		return pickDecoder<7>(type.endian, type.repr);
+	case 8:
+		return pickDecoder<8>(type.endian, type.repr);
+	default:
+		return nullptr;
+	}
+}
+
+CompiledVariable AddressSpace::compile(const Variable& var) const {
+	CompiledVariable compiled(var);
+	const Span* span = find(var.address);
+	size_t swizzle = m_overlay->swizzle();
+	if (!span || swizzle == SIZE_MAX) {
+		return compiled;
+	}
+	compiled.offset = var.address - span->base;
+	compiled.end = ((compiled.offset + var.type.width - 1) | swizzle) + 1;
+	if (compiled.end > span->block->size()) {
+		return compiled;
+	}
+	compiled.decode = pickDecoder(var.type);
+	compiled.span = span - m_spans.data();
+	compiled.base = span->base;
+	compiled.swizzle = swizzle;
+	return compiled;
+}
+
+size_t AddressSpace::totalSize() const {
+	size_t size = 0;
 	for (const auto& block : m_blocks) {
-		if (offset < block.first) {
-			continue;
-		}
-		if (offset < block.first + block.second.size()) {
-			return block.second;
+		size += block.second.size();
+	}
+	return size;
+}
+
+void AddressSpace::gather(void* out) const {
+	uint8_t* bytes = static_cast<uint8_t*>(out);
+	for (const auto& block : m_blocks) {
+		memcpy(bytes, block.second.offset(0), block.second.size());
+		bytes += block.second.size();
+	}
+}
+
+bool AddressSpace::gather(const size_t* addresses, size_t count, void* out) const {
+	uint8_t* bytes = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; ++i) {
+		const Span* span = find(addresses[i]);
+		if (!span) {
+			return false;
 		}
+		bytes[i] = static_cast<const uint8_t*>(span->block->offset(0))[addresses[i] - span->base];
+	}
+	return true;
+}
+
+bool AddressSpace::hasBlock(size_t offset) const {
+	return find(offset);
+}
+
+const MemoryView<>& AddressSpace::block(size_t offset) const {
+	const Span* span = find(offset);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
 	}
-	throw std::out_of_range("No known mapping");
+	return *span->block;
 }
 
 MemoryView<>& AddressSpace::block(size_t offset) {
-	for (auto& block : m_blocks) {
-		if (offset < block.first) {
-			continue;
-		}
-		if (offset < block.first + block.second.size()) {
-			return block.second;
-		}
+	const Span* span = find(offset);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
 	}
-	throw std::out_of_range("No known mapping");
+	return *span->block;
 }
 
 bool AddressSpace::ok() const {
@@ -397,6 +563,7 @@ bool AddressSpace::ok() const {
 
 void AddressSpace::reset() {
 	m_blocks.clear();
+	reindex();
 }
 
 void AddressSpace::clone(const AddressSpace& as) {
@@ -405,6 +572,7 @@ void AddressSpace::clone(const AddressSpace& as) {
 	for (auto& kv : as.m_blocks) {
 		m_blocks[kv.first].clone(kv.second);
 	}
+	reindex();
 }
 
 void AddressSpace::clone() {
@@ -417,65 +585,61 @@ void AddressSpace::setOverlay(const MemoryOverlay& overlay) {
 	m_overlay = make_unique<MemoryOverlay>(overlay);
 }
 
+bool AddressSpace::peek(size_t offset, uint8_t* value) const {
+	const Span* span = find(offset);
+	if (!span) {
+		return false;
+	}
+	size_t swizzle = m_overlay->swizzle();
+	size_t index = (offset - span->base) ^ swizzle;
+	if (swizzle == SIZE_MAX || index >= span->block->size()) {
+		*value = (*this)[offset];
+		return true;
+	}
+	*value = static_cast<const uint8_t*>(span->block->offset(0))[index];
+	return true;
+}
+
 Datum AddressSpace::operator[](size_t offset) {
-	for (auto& kv : m_blocks) {
-		if (offset < kv.first) {
-			throw std::out_of_range("No known mapping");
-		}
-		if (offset - kv.first >= kv.second.size()) {
-			continue;
-		}
-		return Datum(kv.second.offset(0), offset - kv.first, s_type, *m_overlay);
+	const Span* span = find(offset);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
 	}
-	throw std::out_of_range("No known mapping");
+	return Datum(span->block->offset(0), offset - span->base, s_type, *m_overlay);
 }
 
 Datum AddressSpace::operator[](const Variable& var) {
-	for (auto& kv : m_blocks) {
-		if (var.address < kv.first) {
-			throw std::out_of_range("No known mapping");
-		}
-		if (var.address - kv.first >= kv.second.size()) {
-			continue;
-		}
-		return Datum(kv.second.offset(0), Variable{ var.type, var.address - kv.first, var.mask }, *m_overlay);
+	const Span* span = find(var.address);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
 	}
-	throw std::out_of_range("No known mapping");
+	return Datum(span->block->offset(0), Variable{ var.type, var.address - span->base, var.mask }, *m_overlay);
 }
 
 uint8_t AddressSpace::operator[](size_t offset) const {
-	for (const auto& kv : m_blocks) {
-		if (offset < kv.first) {
-			throw std::out_of_range("No known mapping");
-		}
-		if (offset - kv.first >= kv.second.size()) {
-			continue;
-		}
-		uint8_t fakeBase[16]{};
-		return s_type.decode(m_overlay->parse(kv.second.offset(0), offset - kv.first, reinterpret_cast<void*>(fakeBase), s_type.width));
+	const Span* span = find(offset);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
 	}
-	throw std::out_of_range("No known mapping");
+	uint8_t fakeBase[16]{};
+	return s_type.decode(m_overlay->parse(span->block->offset(0), offset - span->base, reinterpret_cast<void*>(fakeBase), s_type.width));
 }
 
 int64_t AddressSpace::operator[](const Variable& var) const {
-	for (const auto& kv : m_blocks) {
-		if (var.address < kv.first) {
-			throw std::out_of_range("No known mapping");
-		}
-		if (var.address - kv.first >= kv.second.size()) {
-			continue;
-		}
-		int64_t value;
-		if (m_overlay->width > 1) {
-			uint8_t fakeBase[16];
-			value = var.type.decode(m_overlay->parse(kv.second.offset(0), var.address - kv.first, reinterpret_cast<void*>(fakeBase), var.type.width));
-		} else {
-			value = var.type.decode(kv.second.offset(var.address - kv.first));
-		}
-		value &= var.mask;
-		return value;
+	const Span* span = find(var.address);
+	if (!span) {
+		throw std::out_of_range("No known mapping");
+	}
+	int64_t value;
+	const MemoryView<>& block = *span->block;
+	if (m_overlay->width > 1) {
+		uint8_t fakeBase[16];
+		value = var.type.decode(m_overlay->parse(block.offset(0), var.address - span->base, reinterpret_cast<void*>(fakeBase), var.type.width));
+	} else {
+		value = var.type.decode(block.offset(var.address - span->base));
 	}
-	throw std::out_of_range("No known mapping");
+	value &= var.mask;
+	return value;
 }
 
 AddressSpace& AddressSpace::operator=(AddressSpace&& as) {
@@ -485,6 +649,8 @@ AddressSpace& AddressSpace::operator=(AddressSpace&& as) {
 		m_blocks[kv.first] = move(as.m_blocks[kv.first]);
 	}
 	as.m_blocks.clear();
+	as.reindex();
+	reindex();
 	return *this;
 }
 
@@ -2,10 +2,12 @@
 
 #include "gtest/gtest.h"
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <fcntl.h>
 #ifndef _WIN32
@@ -320,6 +322,10 @@ public:
 	void* parse(const void* in, size_t offset, void* out, size_t size) const;
 	void unparse(void* out, size_t offset, const void* in, size_t size) const;
 
+	// The XOR that maps an offset to where parse reads it from, or SIZE_MAX
+	// if the overlay is more than a byte swap
+	size_t swizzle() const;
+
 	const size_t width;
 
 private:
@@ -327,6 +333,39 @@ private:
 	DataType m_real;
 };
 
+// A Variable resolved against an AddressSpace's block layout. Reading one
+// skips the block search and decodes with a function specialized for its
+// type; it falls back to a normal lookup if the layout no longer matches.
+struct CompiledVariable {
+	CompiledVariable(const Variable& var)
+		: var(var) {}
+
+	Variable var;
+	size_t span = SIZE_MAX;
+	size_t base = 0;
+	size_t offset = 0;
+	size_t end = 0;
+	size_t swizzle = 0;
+	int64_t (*decode)(const uint8_t*) = nullptr;
+
+	// Decodes at an offset into block data; requires decode to be set
+	int64_t decodeAt(const uint8_t* data, size_t offset) const;
+};
+
+inline int64_t CompiledVariable::decodeAt(const uint8_t* data, size_t offset) const {
+	int64_t value;
+	if (!swizzle) {
+		value = decode(&data[offset]);
+	} else {
+		uint8_t swizzled[8];
+		for (size_t i = 0; i < var.type.width; ++i) {
+			swizzled[i] = data[(offset + i) ^ swizzle];
+		}
+		value = decode(swizzled);
+	}
+	return value & var.mask;
+}
+
 class Variant {
 public:
 	enum class Type {
@@ -428,7 +467,12 @@ public:
 	MemoryView<>& block(size_t offset);
 
 	const std::map<size_t, MemoryView<>>& blocks() const { return m_blocks; }
-	std::map<size_t, MemoryView<>>& blocks() { return m_blocks; }
+
+	// Raw block bytes, either all blocks concatenated in address order or
+	// one byte per requested address. Overlays are not applied.
+	size_t totalSize() const;
+	void gather(void* out) const;
+	bool gather(const size_t* addresses, size_t count, void* out) const;
 
 	bool ok() const;
 	void reset();
@@ -443,15 +487,49 @@ public:
 	uint8_t operator[](size_t) const;
 	int64_t operator[](const Variable&) const;
 
+	// Same as the const byte operator[], but false instead of throwing
+	bool peek(size_t offset, uint8_t* value) const;
+
+	CompiledVariable compile(const Variable&) const;
+	int64_t read(const CompiledVariable&) const;
+
+	// Changes whenever blocks are added or removed
+	uint64_t layout() const { return m_layout; }
+
 	AddressSpace& operator=(AddressSpace&&);
 
 private:
+	// A span of addresses served by one block. Where blocks overlap, the one
+	// that starts lowest wins, so spans never overlap.
+	struct Span {
+		size_t start;
+		size_t end;
+		size_t base;
+		MemoryView<>* block;
+	};
+
+	const Span* find(size_t offset) const;
+	void reindex();
+
 	static const DataType s_type;
 	;
 	std::map<size_t, MemoryView<>> m_blocks;
+	std::vector<Span> m_spans;
+	uint64_t m_layout = 0;
+	mutable std::atomic<size_t> m_lastSpan{ 0 };
 	std::unique_ptr<MemoryOverlay> m_overlay = std::make_unique<MemoryOverlay>();
 };
 
+inline int64_t AddressSpace::read(const CompiledVariable& var) const {
+	if (var.span < m_spans.size() && var.decode) {
+		const Span& span = m_spans[var.span];
+		if (span.base == var.base && var.end <= span.block->size()) {
+			return var.decodeAt(static_cast<const uint8_t*>(span.block->offset(0)), var.offset);
+		}
+	}
+	return (*this)[var.var];
+}
+
 int64_t toBcd(int64_t);
 int64_t toLNBcd(int64_t);
 bool isBcd(uint64_t);
@@ -71,6 +71,7 @@ unique_ptr<Movie> MovieBK2::load(const string& path) {
 MovieBK2::MovieBK2(unique_ptr<Zip> zip)
 	: m_zip(move(zip))
 	, m_log(m_zip->openFile("Input Log.txt")) {
+	memset(m_keymap, -1, sizeof(m_keymap));
 	string platform;
 
 	Zip::File* header = m_zip->openFile("Header.txt");
@@ -117,13 +118,13 @@ MovieBK2::MovieBK2(unique_ptr<Zip> zip)
 MovieBK2::MovieBK2(const std::string& path, bool write, unsigned players)
 	: m_zip(make_unique<Zip>(path))
 	, m_write(write) {
+	memset(m_keymap, -1, sizeof(m_keymap));
 	m_players = players;
 	m_zip->open(write);
 	m_log = m_zip->openFile("Input Log.txt", write);
 	if (write) {
-		stringstream headerText;
-		headerText << "[Input]" << endl;
-		m_log->write(static_cast<const void*>(headerText.str().c_str()), headerText.str().size());
+		const char* inputText = "[Input]\n";
+		m_log->write(static_cast<const void*>(inputText), strlen(inputText));
 	} else {
 		loadState();
 	}
@@ -137,15 +138,22 @@ string MovieBK2::getGameName() const {
 	return m_gameName;
 }
 
+string MovieBK2::getPlatform() const {
+	return m_coreName;
+}
+
 void MovieBK2::loadKeymap(const string& platform) {
 	vector<string> buttons = Retro::buttons(platform);
 	for (int i = 0; i < buttons.size(); ++i) {
 		const auto& button = s_keyNames.find(buttons[i]);
 		if (button != s_keyNames.end()) {
-			m_keymap[button->second] = i;
+			m_keymap[static_cast<uint8_t>(button->second)] = i;
 			m_buttonmap[i] = button->second;
 		}
 	}
+	// Log columns keep the order the header lists them in
+	m_buttons.assign(m_buttonmap.begin(), m_buttonmap.end());
+	m_coreName = platform;
 	if (m_write) {
 		string realPlatform = platform;
 		if (platform == "Genesis") {
@@ -157,7 +165,6 @@ void MovieBK2::loadKeymap(const string& platform) {
 		} else if (platform == "Atari2600") {
 			realPlatform = "A26";
 		}
-		m_coreName = platform;
 		m_platform = realPlatform;
 	}
 }
@@ -184,7 +191,7 @@ void MovieBK2::writeHeader() {
 
 	headerText.str("LogKey:#Reset|Power|#");
 	for (unsigned p = 1; p < m_players + 1; ++p) {
-		for (const auto& key : m_buttonmap) {
+		for (const auto& key : m_buttons) {
 			if (s_platformButtonNames.find(m_coreName) != s_platformButtonNames.end()) {
 				const auto& platformButtons = s_platformButtonNames.at(m_coreName);
 				if (platformButtons.find(key.second) != platformButtons.end()) {
@@ -208,59 +215,76 @@ bool MovieBK2::step() {
 		if (!m_headerWritten) {
 			writeHeader();
 		}
-		stringstream line;
-		line << "|..|";
+		m_line.assign("|..|");
 		for (unsigned i = 0; i < m_players; ++i) {
-			for (const auto& key : m_buttonmap) {
-				if (m_keys[i] & (1 << key.first)) {
-					line << key.second;
-				} else {
-					line << '.';
-				}
+			for (const auto& key : m_buttons) {
+				m_line.push_back(m_keys[i] & (1 << key.first) ? key.second : '.');
 			}
 			m_keys[i] = 0;
-			line << '|';
+			m_line.push_back('|');
 		}
-		line << endl;
-		m_log->write(static_cast<const void*>(line.str().c_str()), line.str().size());
+		m_line.push_back('\n');
+		m_log->write(static_cast<const void*>(m_line.data()), m_line.size());
+		++m_frame;
 		return true;
-	} else {
-		string tmp = m_log->readline();
-		while (tmp.size() && tmp[0] != '|') {
-			tmp = m_log->readline();
-		}
-		if (!tmp.size()) {
-			return false;
-		}
-		auto iter = tmp.begin();
-		if (*iter == '|') {
+	}
+
+	if ((m_frame + 1) * m_players > m_inputs.size() && !readFrame()) {
+		return false;
+	}
+	for (unsigned i = 0; i < m_players; ++i) {
+		m_keys[i] = m_inputs[m_frame * m_players + i];
+	}
+	++m_frame;
+	return true;
+}
+
+bool MovieBK2::readFrame() const {
+	if (m_logDone || !m_log) {
+		return false;
+	}
+	do {
+		m_log->readline(&m_line);
+	} while (m_line.size() && m_line[0] != '|');
+	const char* iter = m_line.data();
+	const char* end = iter + m_line.size();
+	// Ignore commands
+	iter = m_line.empty() ? nullptr : static_cast<const char*>(memchr(iter + 1, '|', end - iter - 1));
+	if (!iter) {
+		m_logDone = true;
+		return false;
+	}
+	for (unsigned i = 0; i < m_players; ++i) {
+		uint16_t keys = 0;
+		if (iter < end) {
 			++iter;
-			while (iter != tmp.end() && *iter != '|') {
-				// Ignore commands
-				++iter;
-			}
-			if (iter == tmp.end()) {
-				return false;
-			}
-			for (unsigned i = 0; i < m_players; ++i) {
-				m_keys[i] = 0;
-				++iter;
-				while (iter != tmp.end() && *iter != '|') {
-					if (*iter == '.') {
-						++iter;
-						continue;
-					}
-					auto found = m_keymap.find(*iter);
-					if (found != m_keymap.end()) {
-						m_keys[i] |= 1 << found->second;
-					}
-					++iter;
-				}
+		}
+		for (; iter < end && *iter != '|'; ++iter) {
+			int key = m_keymap[static_cast<uint8_t>(*iter)];
+			if (key >= 0) {
+				keys |= 1 << key;
 			}
-			return true;
 		}
+		m_inputs.push_back(keys);
 	}
-	return false;
+	return true;
+}
+
+size_t MovieBK2::frames() const {
+	if (m_write) {
+		return m_frame;
+	}
+	while (readFrame()) {
+	}
+	return m_inputs.size() / m_players;
+}
+
+bool MovieBK2::seek(size_t frame) {
+	if (m_write || frame > frames()) {
+		return false;
+	}
+	m_frame = frame;
+	return true;
 }
 
 void MovieBK2::close() {
@@ -295,15 +319,7 @@ void MovieBK2::setState(const uint8_t* state, size_t size) {
 
 void MovieBK2::loadState() {
 	Zip::File* state = m_zip->openFile("Core.bin");
-	if (!state) {
+	if (!state || !state->readAll(&m_state)) {
 		m_state.clear();
-		return;
-	}
-	m_state.clear();
-	m_state.resize(2048);
-	ssize_t read;
-	while ((read = state->read(&*(m_state.end() - 2048), 2048)) == 2048) {
-		m_state.resize(m_state.size() + 2048);
 	}
-	m_state.resize(m_state.size() - 2048 + read);
 }
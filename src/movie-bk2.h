@@ -15,6 +15,7 @@ public:
 	~MovieBK2();
 
 	virtual std::string getGameName() const override;
+	virtual std::string getPlatform() const override;
 
 	void loadKeymap(const std::string& platform);
 	void setGameName(const std::string& name);
@@ -24,6 +25,11 @@ public:
 
 	virtual bool step() override;
 
+	// The compressed log can't be seeked, so reading keeps every frame read
+	// so far; asking for the length or seeking reads the rest of the log
+	virtual size_t frames() const override;
+	virtual bool seek(size_t frame) override;
+
 	virtual void close() override;
 
 	virtual bool getState(std::vector<uint8_t>*) const override;
@@ -31,13 +37,20 @@ public:
 
 private:
 	void loadState();
+	bool readFrame() const;
 
 	std::unique_ptr<Zip> m_zip;
 	Zip::File* m_log;
 	std::vector<uint8_t> m_state;
 
-	std::unordered_map<char, int> m_keymap;
+	// Input log characters to button indices, or -1
+	int8_t m_keymap[256];
 	std::unordered_map<int, char> m_buttonmap;
+	std::vector<std::pair<int, char>> m_buttons;
+	mutable std::string m_line;
+	mutable std::vector<uint16_t> m_inputs;
+	mutable bool m_logDone = false;
+	size_t m_frame = 0;
 	bool m_write = false;
 
 	bool m_headerWritten = false;
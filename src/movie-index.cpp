@@ -0,0 +1,223 @@
+#include "movie-index.h"
+
+#include "emulator.h"
+#include "statedelta.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+using namespace Retro;
+
+constexpr unsigned MovieIndex::DEFAULT_INTERVAL;
+
+static const char INDEX_MAGIC[4] = { 'R', 'M', 'I', '1' };
+static const size_t HEADER_SIZE = 32;
+static const size_t ENTRY_SIZE = 20;
+
+uint64_t MovieIndex::hashFile(const string& path) {
+	// FNV-1a; this only needs to notice edits, not resist them
+	ifstream in(path, ios::binary);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	char buffer[65536];
+	while (in) {
+		in.read(buffer, sizeof(buffer));
+		for (streamsize i = 0; i < in.gcount(); ++i) {
+			hash = (hash ^ static_cast<uint8_t>(buffer[i])) * 0x100000001B3ULL;
+		}
+	}
+	return hash;
+}
+
+string MovieIndex::sidecarPath(const string& moviePath, const string& cacheDir) {
+	return sidecarPath(moviePath, cacheDir, cacheDir.empty() ? 0 : hashFile(moviePath));
+}
+
+string MovieIndex::sidecarPath(const string& moviePath, const string& cacheDir, uint64_t movieHash) {
+	if (cacheDir.empty()) {
+		return moviePath + ".idx";
+	}
+	char name[24];
+	snprintf(name, sizeof(name), "%016llx.idx", static_cast<unsigned long long>(movieHash));
+	return cacheDir + "/" + name;
+}
+
+bool MovieIndex::load(const string& path, uint64_t movieHash) {
+	ifstream in(path, ios::binary | ios::ate);
+	if (!in) {
+		return false;
+	}
+	uint64_t remaining = in.tellg();
+	in.seekg(0);
+	uint8_t header[HEADER_SIZE];
+	if (remaining < HEADER_SIZE || !in.read(reinterpret_cast<char*>(header), HEADER_SIZE)) {
+		return false;
+	}
+	remaining -= HEADER_SIZE;
+	if (memcmp(header, INDEX_MAGIC, sizeof(INDEX_MAGIC)) || getLE(&header[8], 8) != movieHash) {
+		return false;
+	}
+	unsigned interval = getLE(&header[4], 4);
+	uint64_t frames = getLE(&header[16], 8);
+	uint64_t count = getLE(&header[24], 4);
+	if (!interval || count > remaining / ENTRY_SIZE) {
+		return false;
+	}
+
+	vector<Keyframe> keyframes(count);
+	for (auto& keyframe : keyframes) {
+		uint8_t entry[ENTRY_SIZE];
+		if (remaining < ENTRY_SIZE || !in.read(reinterpret_cast<char*>(entry), ENTRY_SIZE)) {
+			return false;
+		}
+		remaining -= ENTRY_SIZE;
+		keyframe.frame = getLE(&entry[0], 8);
+		keyframe.encoding = getLE(&entry[8], 4);
+		uint64_t size = getLE(&entry[12], 8);
+		if (size > remaining || keyframe.frame > frames || keyframe.encoding > KEYFRAME_DELTA) {
+			return false;
+		}
+		if (&keyframe == &keyframes.front() ? keyframe.encoding != KEYFRAME_RAW : keyframe.frame <= (&keyframe - 1)->frame) {
+			return false;
+		}
+		keyframe.data.resize(size);
+		if (!in.read(reinterpret_cast<char*>(keyframe.data.data()), size)) {
+			return false;
+		}
+		remaining -= size;
+	}
+
+	m_hash = movieHash;
+	m_interval = interval;
+	m_frames = frames;
+	m_keyframes = move(keyframes);
+	return true;
+}
+
+bool MovieIndex::save(const string& path) const {
+	ofstream out(path, ios::binary | ios::trunc);
+	uint8_t header[HEADER_SIZE]{};
+	memcpy(header, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	putLE(&header[4], m_interval, 4);
+	putLE(&header[8], m_hash, 8);
+	putLE(&header[16], m_frames, 8);
+	putLE(&header[24], m_keyframes.size(), 4);
+	out.write(reinterpret_cast<const char*>(header), HEADER_SIZE);
+	for (const auto& keyframe : m_keyframes) {
+		uint8_t entry[ENTRY_SIZE];
+		putLE(&entry[0], keyframe.frame, 8);
+		putLE(&entry[8], keyframe.encoding, 4);
+		putLE(&entry[12], keyframe.data.size(), 8);
+		out.write(reinterpret_cast<const char*>(entry), ENTRY_SIZE);
+		out.write(reinterpret_cast<const char*>(keyframe.data.data()), keyframe.data.size());
+	}
+	if (!out) {
+		// Don't leave a truncated sidecar behind to be rejected every time
+		out.close();
+		remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+void MovieIndex::addKeyframe(size_t frame, const vector<uint8_t>& state) {
+	Keyframe keyframe{ frame, KEYFRAME_RAW };
+	if (m_keyframes.size()) {
+		const auto& base = m_keyframes.front().data;
+		encodeStateDelta(base.data(), base.size(), state.data(), state.size(), &keyframe.data);
+		if (keyframe.data.size() < state.size()) {
+			keyframe.encoding = KEYFRAME_DELTA;
+		}
+	}
+	if (keyframe.encoding == KEYFRAME_RAW) {
+		keyframe.data = state;
+	}
+	m_keyframes.emplace_back(move(keyframe));
+}
+
+bool MovieIndex::build(Movie* movie, Emulator* emulator, uint64_t movieHash, unsigned interval) {
+	vector<uint8_t> state;
+	if (!interval || !movie->seek(0) || !movie->getState(&state) || !emulator->unserialize(state.data(), state.size())) {
+		return false;
+	}
+	m_hash = movieHash;
+	m_interval = interval;
+	m_keyframes.clear();
+	size_t frame = 0;
+	while (true) {
+		if (frame % interval == 0) {
+			state.resize(emulator->serializeSize());
+			if (!emulator->serialize(state.data(), state.size())) {
+				return false;
+			}
+			addKeyframe(frame, state);
+		}
+		if (!movie->step()) {
+			break;
+		}
+		movie->applyKeys(emulator);
+		// Nothing looks at the screen or audio, so let the core skip them
+		emulator->run(OUTPUT_RAM);
+		++frame;
+	}
+	m_frames = frame;
+	return movie->seek(0);
+}
+
+bool MovieIndex::open(const string& moviePath, Movie* movie, Emulator* emulator, const string& cacheDir, unsigned interval) {
+	uint64_t hash = hashFile(moviePath);
+	string path = sidecarPath(moviePath, cacheDir, hash);
+	if (load(path, hash)) {
+		return true;
+	}
+	if (!build(movie, emulator, hash, interval)) {
+		return false;
+	}
+	// A sidecar that can't be written only costs a rebuild next time
+	save(path);
+	return true;
+}
+
+bool MovieIndex::getKeyframe(size_t frame, size_t* keyframe, vector<uint8_t>* state) const {
+	auto next = upper_bound(m_keyframes.begin(), m_keyframes.end(), frame, [](size_t f, const Keyframe& k) {
+		return f < k.frame;
+	});
+	if (next == m_keyframes.begin()) {
+		return false;
+	}
+	const Keyframe& found = *(next - 1);
+	*keyframe = found.frame;
+	if (found.encoding == KEYFRAME_DELTA) {
+		const auto& base = m_keyframes.front().data;
+		return applyStateDelta(base.data(), base.size(), found.data.data(), found.data.size(), state);
+	}
+	*state = found.data;
+	return true;
+}
+
+bool MovieIndex::seek(Movie* movie, Emulator* emulator, size_t frame, const MovieIndex* index) {
+	size_t keyframe = 0;
+	vector<uint8_t> state;
+	bool found = index ? index->getKeyframe(frame, &keyframe, &state) : movie->getKeyframe(frame, &keyframe, &state);
+	if (!found) {
+		keyframe = 0;
+		if (!movie->getState(&state)) {
+			return false;
+		}
+	}
+	if (!emulator->unserialize(state.data(), state.size()) || !movie->seek(keyframe)) {
+		return false;
+	}
+	for (size_t f = keyframe; f < frame; ++f) {
+		if (!movie->step()) {
+			return false;
+		}
+		movie->applyKeys(emulator);
+		// Only the last frame's screen is left for the caller to see
+		emulator->run(f + 1 == frame ? OUTPUT_ALL : OUTPUT_RAM);
+	}
+	return true;
+}
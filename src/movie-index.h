@@ -0,0 +1,67 @@
+#pragma once
+
+#include "movie.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Retro {
+
+class Emulator;
+
+// Savestates taken every interval frames while replaying a movie, kept in a
+// sidecar file tagged with a hash of the movie so edits invalidate it.
+// Reaching any frame then takes restoring the nearest keyframe and running
+// fewer than interval frames instead of replaying from the start.
+class MovieIndex {
+public:
+	static constexpr unsigned DEFAULT_INTERVAL = 600;
+
+	static uint64_t hashFile(const std::string& path);
+
+	// The sidecar next to the movie, or named by its hash inside cacheDir.
+	// Pass the hash if it's already known to save reading the movie again.
+	static std::string sidecarPath(const std::string& moviePath, const std::string& cacheDir = {});
+	static std::string sidecarPath(const std::string& moviePath, const std::string& cacheDir, uint64_t movieHash);
+
+	// Fails if the sidecar is malformed or was built for another movie
+	bool load(const std::string& path, uint64_t movieHash);
+	bool save(const std::string& path) const;
+
+	// Replays movie from its initial state on emulator, which must have the
+	// movie's game loaded. The movie is rewound afterwards and the emulator
+	// is left at the end of the movie.
+	bool build(Movie*, Emulator*, uint64_t movieHash, unsigned interval = DEFAULT_INTERVAL);
+
+	// Loads the movie's sidecar if it is current, otherwise builds and saves
+	// a new one
+	bool open(const std::string& moviePath, Movie*, Emulator*, const std::string& cacheDir = {}, unsigned interval = DEFAULT_INTERVAL);
+
+	uint64_t movieHash() const { return m_hash; }
+	unsigned interval() const { return m_interval; }
+	size_t frames() const { return m_frames; }
+	size_t keyframes() const { return m_keyframes.size(); }
+
+	bool getKeyframe(size_t frame, size_t* keyframe, std::vector<uint8_t>*) const;
+
+	// Puts the emulator in the state it had just before frame ran and the
+	// movie at frame, using the index if given and otherwise any keyframes
+	// the movie has itself
+	static bool seek(Movie*, Emulator*, size_t frame, const MovieIndex* = nullptr);
+
+private:
+	struct Keyframe {
+		uint64_t frame;
+		uint32_t encoding;
+		std::vector<uint8_t> data;
+	};
+
+	void addKeyframe(size_t frame, const std::vector<uint8_t>& state);
+
+	uint64_t m_hash = 0;
+	unsigned m_interval = 0;
+	size_t m_frames = 0;
+	std::vector<Keyframe> m_keyframes;
+};
+}
@@ -0,0 +1,352 @@
+#include "movie-rmv.h"
+
+#include "movie-bk2.h"
+#include "statedelta.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace Retro;
+
+constexpr unsigned MovieRMV::DEFAULT_KEYFRAME_INTERVAL;
+
+static const char RMV_MAGIC[4] = { 'R', 'M', 'V', '1' };
+static const size_t HEADER_SIZE = 72;
+static const size_t INDEX_ENTRY_SIZE = 32;
+
+unique_ptr<Movie> MovieRMV::load(const string& path) {
+	unique_ptr<MovieRMV> movie = make_unique<MovieRMV>(path);
+	if (!movie->ok()) {
+		return nullptr;
+	}
+	return movie;
+}
+
+MovieRMV::MovieRMV(const string& path, bool write, unsigned players, unsigned keyframeInterval)
+	: m_write(write) {
+	m_players = players;
+	if (!write) {
+		if (map(path) && !parse()) {
+			unmap();
+		}
+		return;
+	}
+	m_keyframeInterval = keyframeInterval;
+	m_out.open(path, ios::binary | ios::trunc);
+	uint8_t header[HEADER_SIZE]{};
+	m_out.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+MovieRMV::~MovieRMV() {
+	close();
+}
+
+bool MovieRMV::ok() const {
+	return m_write ? m_out.good() : m_data != nullptr;
+}
+
+bool MovieRMV::step() {
+	if (m_write) {
+		if (!m_out.is_open()) {
+			return false;
+		}
+		for (unsigned p = 0; p < m_players; ++p) {
+			m_inputs.push_back(m_keys[p]);
+			m_keys[p] = 0;
+		}
+		++m_frame;
+		m_frames = m_frame;
+		return true;
+	}
+	if (!m_data || m_frame >= m_frames) {
+		return false;
+	}
+	const uint8_t* frame = &m_inputData[m_frame * m_players * sizeof(uint16_t)];
+	for (unsigned p = 0; p < m_players; ++p) {
+		m_keys[p] = getLE(&frame[p * sizeof(uint16_t)], sizeof(uint16_t));
+	}
+	++m_frame;
+	return true;
+}
+
+bool MovieRMV::seek(size_t frame) {
+	if (m_write || !m_data || frame > m_frames) {
+		return false;
+	}
+	m_frame = frame;
+	return true;
+}
+
+bool MovieRMV::getKeyframe(size_t frame, size_t* keyframe, vector<uint8_t>* state) const {
+	auto next = upper_bound(m_keyframes.begin(), m_keyframes.end(), frame, [](size_t f, const Keyframe& k) {
+		return f < k.frame;
+	});
+	if (next == m_keyframes.begin() || m_write) {
+		// The initial state stands in for a keyframe at the start
+		if (m_state.empty()) {
+			return false;
+		}
+		*keyframe = 0;
+		*state = m_state;
+		return true;
+	}
+	const Keyframe& found = *(next - 1);
+	const uint8_t* data = &m_data[found.offset];
+	*keyframe = found.frame;
+	if (found.encoding == KEYFRAME_DELTA) {
+		const Keyframe& base = m_keyframes.front();
+		return applyStateDelta(&m_data[base.offset], base.size, data, found.size, state);
+	}
+	state->assign(data, data + found.size);
+	return true;
+}
+
+bool MovieRMV::wantsKeyframe() const {
+	if (!m_write || !m_keyframeInterval || m_frame % m_keyframeInterval) {
+		return false;
+	}
+	return m_keyframes.empty() || m_keyframes.back().frame != m_frame;
+}
+
+void MovieRMV::addKeyframe(const uint8_t* state, size_t size) {
+	if (!m_write || !m_out.is_open() || (m_keyframes.size() && m_keyframes.back().frame >= m_frame)) {
+		return;
+	}
+	Keyframe keyframe{ m_frame, static_cast<uint64_t>(m_out.tellp()), size, KEYFRAME_RAW };
+	if (m_keyframes.empty()) {
+		m_firstKeyframe.assign(state, state + size);
+	} else {
+		// Savestates mostly differ in RAM, so deltas against the first one
+		// are far smaller than the states themselves
+		encodeStateDelta(m_firstKeyframe.data(), m_firstKeyframe.size(), state, size, &m_delta);
+		if (m_delta.size() < size) {
+			keyframe.size = m_delta.size();
+			keyframe.encoding = KEYFRAME_DELTA;
+			state = m_delta.data();
+		}
+	}
+	m_out.write(reinterpret_cast<const char*>(state), keyframe.size);
+	m_keyframes.push_back(keyframe);
+}
+
+void MovieRMV::close() {
+	if (m_write && m_out.is_open()) {
+		uint8_t header[HEADER_SIZE]{};
+		memcpy(header, RMV_MAGIC, sizeof(RMV_MAGIC));
+		putLE(&header[4], m_players, 4);
+		putLE(&header[8], m_frames, 8);
+		putLE(&header[16], m_keyframeInterval, 4);
+		putLE(&header[20], m_keyframes.size(), 4);
+
+		putLE(&header[24], m_out.tellp(), 8);
+		putLE(&header[32], m_state.size(), 8);
+		m_out.write(reinterpret_cast<const char*>(m_state.data()), m_state.size());
+
+		vector<uint8_t> buffer(m_inputs.size() * sizeof(uint16_t));
+		for (size_t i = 0; i < m_inputs.size(); ++i) {
+			putLE(&buffer[i * sizeof(uint16_t)], m_inputs[i], sizeof(uint16_t));
+		}
+		putLE(&header[40], m_out.tellp(), 8);
+		m_out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+		buffer.assign(m_keyframes.size() * INDEX_ENTRY_SIZE, 0);
+		for (size_t i = 0; i < m_keyframes.size(); ++i) {
+			uint8_t* entry = &buffer[i * INDEX_ENTRY_SIZE];
+			putLE(&entry[0], m_keyframes[i].frame, 8);
+			putLE(&entry[8], m_keyframes[i].offset, 8);
+			putLE(&entry[16], m_keyframes[i].size, 8);
+			putLE(&entry[24], m_keyframes[i].encoding, 4);
+		}
+		putLE(&header[48], m_out.tellp(), 8);
+		m_out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+
+		string metadata = "GameName " + m_gameName + "\nPlatform " + m_platform + "\n";
+		putLE(&header[56], m_out.tellp(), 8);
+		putLE(&header[64], metadata.size(), 8);
+		m_out.write(metadata.data(), metadata.size());
+
+		m_out.seekp(0);
+		m_out.write(reinterpret_cast<const char*>(header), sizeof(header));
+		m_out.close();
+		m_inputs.clear();
+		m_firstKeyframe.clear();
+	}
+	unmap();
+}
+
+bool MovieRMV::getState(vector<uint8_t>* state) const {
+	if (m_state.empty()) {
+		return false;
+	}
+	*state = m_state;
+	return true;
+}
+
+void MovieRMV::setState(const uint8_t* state, size_t size) {
+	m_state.assign(state, state + size);
+}
+
+bool MovieRMV::map(const string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat statbuf;
+	if (fstat(fd, &statbuf) < 0 || !statbuf.st_size) {
+		::close(fd);
+		return false;
+	}
+	m_size = statbuf.st_size;
+#ifdef _WIN32
+	HANDLE mapping = CreateFileMapping(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), 0, PAGE_READONLY, 0, 0, 0);
+	void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, m_size) : nullptr;
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+#else
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		data = nullptr;
+	}
+#endif
+	::close(fd);
+	m_data = static_cast<const uint8_t*>(data);
+	return m_data;
+}
+
+void MovieRMV::unmap() {
+	if (!m_data) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+#else
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_inputData = nullptr;
+	m_size = 0;
+	m_keyframes.clear();
+	m_frames = 0;
+}
+
+bool MovieRMV::parse() {
+	// Every offset and size comes from the file, so each one is checked
+	// against the mapping before use
+	auto fits = [this](uint64_t offset, uint64_t size) {
+		return offset <= m_size && size <= m_size - offset;
+	};
+	if (m_size < HEADER_SIZE || memcmp(m_data, RMV_MAGIC, sizeof(RMV_MAGIC))) {
+		return false;
+	}
+	m_players = getLE(&m_data[4], 4);
+	m_frames = getLE(&m_data[8], 8);
+	m_keyframeInterval = getLE(&m_data[16], 4);
+	uint64_t keyframes = getLE(&m_data[20], 4);
+	uint64_t stateOffset = getLE(&m_data[24], 8);
+	uint64_t stateSize = getLE(&m_data[32], 8);
+	uint64_t inputOffset = getLE(&m_data[40], 8);
+	uint64_t indexOffset = getLE(&m_data[48], 8);
+	uint64_t metaOffset = getLE(&m_data[56], 8);
+	uint64_t metaSize = getLE(&m_data[64], 8);
+	if (!m_players || m_players > MAX_PLAYERS || m_frames > m_size) {
+		return false;
+	}
+	if (!fits(stateOffset, stateSize) || !fits(inputOffset, m_frames * m_players * sizeof(uint16_t)) || !fits(indexOffset, keyframes * INDEX_ENTRY_SIZE) || !fits(metaOffset, metaSize)) {
+		return false;
+	}
+	m_state.assign(&m_data[stateOffset], &m_data[stateOffset + stateSize]);
+	m_inputData = &m_data[inputOffset];
+
+	m_keyframes.clear();
+	for (uint64_t i = 0; i < keyframes; ++i) {
+		const uint8_t* entry = &m_data[indexOffset + i * INDEX_ENTRY_SIZE];
+		Keyframe keyframe{ getLE(&entry[0], 8), getLE(&entry[8], 8), getLE(&entry[16], 8), static_cast<uint32_t>(getLE(&entry[24], 4)) };
+		if (!fits(keyframe.offset, keyframe.size) || keyframe.encoding > KEYFRAME_DELTA || keyframe.frame > m_frames) {
+			return false;
+		}
+		if (m_keyframes.size() ? keyframe.frame <= m_keyframes.back().frame : keyframe.encoding != KEYFRAME_RAW) {
+			return false;
+		}
+		m_keyframes.push_back(keyframe);
+	}
+
+	istringstream metadata(string(reinterpret_cast<const char*>(&m_data[metaOffset]), metaSize));
+	string line;
+	while (getline(metadata, line)) {
+		if (line.compare(0, 9, "GameName ") == 0) {
+			m_gameName = line.substr(9);
+		} else if (line.compare(0, 9, "Platform ") == 0) {
+			m_platform = line.substr(9);
+		}
+	}
+	m_frame = 0;
+	return true;
+}
+
+bool MovieRMV::convert(const string& from, const string& to) {
+	unique_ptr<Movie> in = Movie::load(from);
+	if (!in) {
+		return false;
+	}
+	size_t dot = to.find_last_of('.');
+	string extName = dot == string::npos ? string() : to.substr(dot + 1);
+	unique_ptr<Movie> out;
+	MovieRMV* rmvIn = dynamic_cast<MovieRMV*>(in.get());
+	MovieRMV* rmvOut = nullptr;
+	if (extName == "bk2") {
+		unique_ptr<MovieBK2> bk2 = make_unique<MovieBK2>(to, true, in->players());
+		bk2->loadKeymap(in->getPlatform());
+		bk2->setGameName(in->getGameName());
+		out = move(bk2);
+	} else if (extName == "rmv") {
+		unique_ptr<MovieRMV> rmv = make_unique<MovieRMV>(to, true, in->players(), rmvIn ? rmvIn->m_keyframeInterval : 0);
+		if (!rmv->ok()) {
+			return false;
+		}
+		rmv->setGameName(in->getGameName());
+		rmv->setPlatform(in->getPlatform());
+		rmvOut = rmv.get();
+		out = move(rmv);
+	} else {
+		return false;
+	}
+
+	vector<uint8_t> state;
+	if (in->getState(&state)) {
+		out->setState(state.data(), state.size());
+	}
+	size_t frame = 0;
+	size_t keyframe = 0;
+	while (in->step()) {
+		if (rmvIn && rmvOut && keyframe < rmvIn->m_keyframes.size() && rmvIn->m_keyframes[keyframe].frame == frame) {
+			size_t found;
+			if (rmvIn->getKeyframe(frame, &found, &state)) {
+				rmvOut->addKeyframe(state.data(), state.size());
+			}
+			++keyframe;
+		}
+		for (unsigned p = 0; p < in->players(); ++p) {
+			for (int key = 0; key < N_BUTTONS; ++key) {
+				out->setKey(key, in->getKey(key, p), p);
+			}
+		}
+		out->step();
+		++frame;
+	}
+	out->close();
+	return true;
+}
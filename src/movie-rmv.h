@@ -0,0 +1,81 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "movie.h"
+
+namespace Retro {
+
+// A binary movie: a header, then keyframe states, the initial state, one
+// little-endian uint16_t button mask per player per frame, a frame-sorted
+// keyframe index and a short text block of metadata. Keyframes are stored
+// as deltas against the initial state. Reading maps the file and decodes
+// frames in place, so any frame can be reached without parsing the rest.
+class MovieRMV final : public Movie {
+public:
+	static constexpr unsigned DEFAULT_KEYFRAME_INTERVAL = 1800;
+
+	MovieRMV(const std::string& path, bool write = false, unsigned players = 1, unsigned keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+	~MovieRMV();
+
+	static std::unique_ptr<Movie> load(const std::string& path);
+
+	// Converts between any loadable movie and a BK2 or RMV file, chosen by
+	// the extension of to. Inputs, players, the initial state, game name and
+	// platform carry over; keyframes only carry over between RMV files.
+	static bool convert(const std::string& from, const std::string& to);
+
+	bool ok() const;
+
+	virtual std::string getGameName() const override { return m_gameName; }
+	virtual std::string getPlatform() const override { return m_platform; }
+	void setGameName(const std::string& name) { m_gameName = name; }
+	void setPlatform(const std::string& platform) { m_platform = platform; }
+
+	virtual bool step() override;
+
+	virtual size_t frames() const override { return m_frames; }
+	virtual bool seek(size_t frame) override;
+	virtual bool getKeyframe(size_t frame, size_t* keyframe, std::vector<uint8_t>*) const override;
+
+	virtual bool wantsKeyframe() const override;
+	virtual void addKeyframe(const uint8_t*, size_t) override;
+
+	virtual void close() override;
+
+	virtual bool getState(std::vector<uint8_t>*) const override;
+	virtual void setState(const uint8_t*, size_t) override;
+
+private:
+	struct Keyframe {
+		uint64_t frame;
+		uint64_t offset;
+		uint64_t size;
+		uint32_t encoding;
+	};
+
+	bool map(const std::string& path);
+	void unmap();
+	bool parse();
+
+	bool m_write = false;
+	std::ofstream m_out;
+	unsigned m_keyframeInterval = 0;
+	std::vector<uint16_t> m_inputs;
+	std::vector<uint8_t> m_firstKeyframe;
+	std::vector<uint8_t> m_delta;
+
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	const uint8_t* m_inputData = nullptr;
+
+	size_t m_frames = 0;
+	size_t m_frame = 0;
+	std::vector<Keyframe> m_keyframes;
+	std::vector<uint8_t> m_state;
+	std::string m_gameName;
+	std::string m_platform;
+};
+}
@@ -2,6 +2,7 @@
 
 #include "movie-bk2.h"
 #include "movie-fm2.h"
+#include "movie-rmv.h"
 
 #include <functional>
 #include <unordered_map>
@@ -12,6 +13,7 @@ using namespace Retro;
 static unordered_map<string, function<unique_ptr<Movie>(const string&)>> s_movieTypes{
 	make_pair("bk2", MovieBK2::load),
 	make_pair("fm2", MovieFM2::load),
+	make_pair("rmv", MovieRMV::load),
 };
 
 std::unique_ptr<Movie> Movie::load(const string& path) {
@@ -31,6 +33,14 @@ bool Movie::getKey(int key, unsigned player) {
 	return (m_keys[player] >> key) & 1;
 }
 
+void Movie::applyKeys(Emulator* emulator) const {
+	for (unsigned p = 0; p < m_players; ++p) {
+		for (int key = 0; key < N_BUTTONS; ++key) {
+			emulator->setKey(p, key, (m_keys[p] >> key) & 1);
+		}
+	}
+}
+
 void Movie::setKey(int key, bool set, unsigned player) {
 	m_keys[player] &= ~(1 << key);
 	m_keys[player] |= set << key;
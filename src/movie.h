@@ -8,15 +8,34 @@
 
 namespace Retro {
 
+// How RMV movies and movie indexes store each keyframe
+enum KeyframeEncoding : uint32_t {
+	KEYFRAME_RAW = 0,
+	// XOR delta against the first keyframe, which is always raw
+	KEYFRAME_DELTA = 1,
+};
+
 class Movie {
 public:
 	static std::unique_ptr<Movie> load(const std::string& path);
 	virtual ~Movie() {}
 
 	virtual std::string getGameName() const { return {}; }
+	virtual std::string getPlatform() const { return {}; }
 
 	virtual bool step() = 0;
 
+	// Formats with random access know their length and can resume stepping
+	// at any frame. A keyframe is a savestate taken just before its frame
+	// ran; restoring one and stepping forward reaches any later frame.
+	virtual size_t frames() const { return 0; }
+	virtual bool seek(size_t) { return false; }
+	virtual bool getKeyframe(size_t, size_t*, std::vector<uint8_t>*) const { return false; }
+
+	// Recordings that embed keyframes ask for one before stepping a frame
+	virtual bool wantsKeyframe() const { return false; }
+	virtual void addKeyframe(const uint8_t*, size_t) {}
+
 	virtual void close() {}
 
 	virtual bool getState(std::vector<uint8_t>*) const { return false; }
@@ -24,6 +43,8 @@ public:
 
 	bool getKey(int, unsigned player = 0);
 	void setKey(int key, bool, unsigned player = 0);
+	// Presses the current frame's keys for every player on the emulator
+	void applyKeys(Emulator*) const;
 
 	unsigned players() const { return m_players; }
 
@@ -0,0 +1,369 @@
+#include "replay.h"
+
+#include "data.h"
+#include "imageops.h"
+#include "movie.h"
+#include "script.h"
+#include "utils.h"
+#include "zipfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+using namespace std;
+using namespace Retro;
+
+constexpr size_t Replay::DEFAULT_CHUNK_FRAMES;
+
+namespace {
+
+// One array of a shard, built up a frame at a time
+struct Array {
+	Array(const string& name, const string& descr, vector<size_t> shape, size_t itemSize)
+		: name(name)
+		, descr(descr)
+		, shape(move(shape)) {
+		rowSize = itemSize;
+		for (size_t dim : this->shape) {
+			rowSize *= dim;
+		}
+	}
+
+	uint8_t* append() {
+		data.resize(data.size() + rowSize);
+		return &data[data.size() - rowSize];
+	}
+
+	string name;
+	string descr;
+	vector<size_t> shape;
+	size_t rowSize;
+	vector<uint8_t> data;
+};
+
+// numpy unicode arrays hold UCS4 code points, but names are UTF-8
+vector<uint32_t> decodeUtf8(const string& text) {
+	vector<uint32_t> codepoints;
+	for (size_t i = 0; i < text.size();) {
+		uint8_t lead = text[i];
+		// Continuation bytes after the lead; 4 marks an invalid lead
+		size_t extra = lead < 0x80 ? 0 : lead < 0xC0 ? 4 : lead < 0xE0 ? 1 : lead < 0xF0 ? 2 : lead < 0xF8 ? 3 : 4;
+		uint32_t codepoint = lead & (0x7F >> (extra ? extra + 1 : 0));
+		size_t c = 1;
+		for (; c <= extra && extra < 4 && i + c < text.size() && (text[i + c] & 0xC0) == 0x80; ++c) {
+			codepoint = (codepoint << 6) | (text[i + c] & 0x3F);
+		}
+		codepoints.push_back(c > extra ? codepoint : 0xFFFD);
+		i += c;
+	}
+	return codepoints;
+}
+
+class ShardWriter {
+public:
+	ShardWriter(const string& prefix, Replay::Format format, int compression)
+		: m_prefix(prefix)
+		, m_format(format)
+		, m_compression(compression) {
+	}
+
+	// Arrays without a frame axis, written to every shard as they are
+	void setConstant(Array&& array) { m_constants.emplace_back(move(array)); }
+
+	bool write(const vector<Array*>& arrays, size_t frames, vector<string>* shards);
+
+private:
+	static string header(const Array&, size_t frames);
+
+	string m_prefix;
+	Replay::Format m_format;
+	int m_compression;
+	vector<Array> m_constants;
+};
+
+// Writes an .npy v1.0 header; leading frames is left out if 0
+string ShardWriter::header(const Array& array, size_t frames) {
+	string dict = "{'descr': '" + array.descr + "', 'fortran_order': False, 'shape': (";
+	vector<size_t> shape = array.shape;
+	if (frames) {
+		shape.insert(shape.begin(), frames);
+	}
+	for (size_t i = 0; i < shape.size(); ++i) {
+		dict += (i ? ", " : "") + to_string(shape[i]);
+	}
+	dict += shape.size() == 1 ? ",), }" : "), }";
+	// Pad so the data starts 64-byte aligned, as numpy does, for mmap users
+	size_t length = 10 + dict.size() + 1;
+	dict.append((64 - length % 64) % 64, ' ');
+	dict += '\n';
+	string out("\x93NUMPY\x01\x00", 8);
+	out += static_cast<char>(dict.size() & 0xFF);
+	out += static_cast<char>(dict.size() >> 8);
+	return out + dict;
+}
+
+bool ShardWriter::write(const vector<Array*>& arrays, size_t frames, vector<string>* shards) {
+	char index[16];
+	snprintf(index, sizeof(index), "-%05zu", shards->size());
+	string base = m_prefix + index;
+
+	vector<pair<const Array*, size_t>> contents;
+	for (const Array* array : arrays) {
+		contents.emplace_back(array, frames);
+	}
+	for (const Array& array : m_constants) {
+		contents.emplace_back(&array, 0);
+	}
+
+	if (m_format == Replay::Format::NPZ) {
+		string path = base + ".npz";
+		remove(path.c_str());
+		Zip zip(path);
+		if (!zip.open(true)) {
+			return false;
+		}
+		zip.setCompression(m_compression);
+		for (const auto& content : contents) {
+			Zip::File* file = zip.openFile(content.first->name + ".npy", true);
+			if (!file) {
+				return false;
+			}
+			string head = header(*content.first, content.second);
+			if (file->write(head.data(), head.size()) != static_cast<ssize_t>(head.size()) || file->write(content.first->data.data(), content.first->data.size()) != static_cast<ssize_t>(content.first->data.size())) {
+				return false;
+			}
+		}
+		if (!zip.close()) {
+			return false;
+		}
+		shards->emplace_back(path);
+		return true;
+	}
+
+	for (const auto& content : contents) {
+		string path = base + "." + content.first->name + ".npy";
+		ofstream out(path, ios::binary);
+		string head = header(*content.first, content.second);
+		out.write(head.data(), head.size());
+		out.write(reinterpret_cast<const char*>(content.first->data.data()), content.first->data.size());
+		out.close();
+		if (!out) {
+			return false;
+		}
+	}
+	shards->emplace_back(base);
+	return true;
+}
+}
+
+Replay::Replay(unsigned threads)
+	: m_pool(threads) {
+}
+
+vector<Replay::Result> Replay::run(const vector<Job>& jobs) {
+	vector<Result> results(jobs.size());
+	m_pool.parallelFor(jobs.size(), [&](size_t i) {
+		results[i] = replay(jobs[i]);
+	});
+	return results;
+}
+
+Replay::Result Replay::replay(const Job& job) const {
+	Result result;
+	unique_ptr<Movie> movie = Movie::load(job.movie);
+	if (!movie) {
+		result.error = "Could not load movie";
+		return result;
+	}
+	Emulator emulator;
+	if (!emulator.loadRom(job.rom)) {
+		result.error = "Could not load ROM";
+		return result;
+	}
+
+	GameData data;
+	Scenario scen(data);
+	// The scenario is still loaded without OUTPUT_RAM for its crop
+	bool loadData = !job.data.empty() || !job.scenario.empty();
+	bool useData = loadData && (m_outputs & OUTPUT_RAM);
+	// Scenarios with scripts have to replay one at a time
+	unique_lock<mutex> scriptLock(ScriptContext::mutex(), defer_lock);
+	if (loadData) {
+		emulator.configureData(&data);
+		scriptLock.lock();
+		if ((!job.data.empty() && !data.load(job.data)) || (!job.scenario.empty() && !scen.load(job.scenario))) {
+			result.error = "Could not load data or scenario";
+			return result;
+		}
+		if (!useData || scen.scripts().empty()) {
+			scriptLock.unlock();
+		} else {
+			scen.reloadScripts();
+		}
+	}
+
+	vector<uint8_t> state;
+	if (movie->getState(&state) && !state.empty() && !emulator.unserialize(state.data(), state.size())) {
+		result.error = "Could not restore the movie's initial state";
+		return result;
+	}
+
+	unsigned players = movie->players();
+	size_t buttons = min<size_t>(emulator.buttons().size(), N_BUTTONS);
+	unsigned outputs = m_outputs & (OUTPUT_VIDEO | OUTPUT_RAM);
+
+	// The first frame stands in for an environment reset: it provides the
+	// first observation and the baseline rewards are measured from
+	if (!movie->step()) {
+		result.ok = true;
+		return result;
+	}
+	movie->applyKeys(&emulator);
+	emulator.run(outputs);
+	vector<int64_t> values;
+	vector<string> names;
+	if (useData) {
+		scen.restart();
+		data.updateRam();
+		scen.update();
+		names = data.variableNames();
+		values.resize(names.size());
+	}
+
+	ShardWriter writer(job.output, m_format, m_compression);
+	if (!names.empty()) {
+		vector<vector<uint32_t>> decoded;
+		size_t length = 1;
+		for (const auto& name : names) {
+			decoded.emplace_back(decodeUtf8(name));
+			length = max(length, decoded.back().size());
+		}
+		Array nameArray("variable_names", "<U" + to_string(length), { names.size() }, 4 * length);
+		uint8_t* out = nameArray.append();
+		memset(out, 0, nameArray.rowSize);
+		for (size_t i = 0; i < decoded.size(); ++i) {
+			for (size_t c = 0; c < decoded[i].size(); ++c) {
+				putLE(&out[(i * length + c) * 4], decoded[i][c], 4);
+			}
+		}
+		writer.setConstant(move(nameArray));
+	}
+
+	Array frameArray("frame", "<i8", {}, sizeof(int64_t));
+	Array actionArray("actions", "|b1", { players, buttons }, 1);
+	Array rewardArray("rewards", "<f4", { players }, sizeof(float));
+	Array doneArray("done", "|b1", {}, 1);
+	Array variableArray("variables", "<i8", { names.size() }, sizeof(int64_t));
+	vector<Array*> arrays{ &frameArray, &actionArray };
+	if (useData) {
+		arrays.insert(arrays.end(), { &rewardArray, &doneArray });
+		if (!names.empty()) {
+			arrays.emplace_back(&variableArray);
+		}
+	}
+	unique_ptr<Array> obsArray;
+
+	size_t chunk = 0;
+	auto flush = [&]() {
+		if (!chunk) {
+			return true;
+		}
+		vector<Array*> written(arrays);
+		if (obsArray) {
+			written.emplace_back(obsArray.get());
+		}
+		bool ok = writer.write(written, chunk, &result.shards);
+		for (Array* array : written) {
+			array->data.clear();
+		}
+		chunk = 0;
+		return ok;
+	};
+
+	for (size_t frame = 1; movie->step(); ++frame) {
+		if (outputs & OUTPUT_VIDEO) {
+			size_t width = emulator.getImageWidth();
+			size_t height = emulator.getImageHeight();
+			Image screen;
+			if (emulator.getImageDepth() == 16) {
+				screen = Image(Image::Format::RGB565, emulator.getImageData(), width, height, emulator.getImagePitch());
+			} else if (emulator.getImageDepth() == 32) {
+				screen = Image(Image::Format::RGBX888, emulator.getImageData(), width, height, emulator.getImagePitch());
+			} else {
+				result.error = "Unsupported screen format";
+				return result;
+			}
+			// Crop the way RetroEnv does for player 1's observations
+			size_t x = 0;
+			size_t y = 0;
+			size_t w = 0;
+			size_t h = 0;
+			scen.getCrop(&x, &y, &w, &h);
+			if (x >= width || y >= height) {
+				x = 0;
+				y = 0;
+			}
+			if (!w || x + w > width) {
+				w = width - x;
+			}
+			if (!h || y + h > height) {
+				h = height - y;
+			}
+			screen = screen.crop(x, y, w, h);
+			width = w;
+			height = h;
+			// A shard has one resolution, so a resolution change starts a new one
+			if (obsArray && (obsArray->shape[0] != height || obsArray->shape[1] != width)) {
+				if (!flush()) {
+					result.error = "Could not write shard";
+					return result;
+				}
+				obsArray.reset();
+			}
+			if (!obsArray) {
+				obsArray = make_unique<Array>("obs", "|u1", vector<size_t>{ height, width, 3 }, 1);
+				obsArray->data.reserve(obsArray->rowSize * m_chunkFrames);
+			}
+			Image out(Image::Format::RGB888, static_cast<void*>(obsArray->append()), width, height, width * 3);
+			screen.copyTo(&out);
+		}
+
+		movie->applyKeys(&emulator);
+		*reinterpret_cast<int64_t*>(frameArray.append()) = frame;
+		uint8_t* action = actionArray.append();
+		for (unsigned p = 0; p < players; ++p) {
+			for (size_t key = 0; key < buttons; ++key) {
+				action[p * buttons + key] = movie->getKey(key, p);
+			}
+		}
+		emulator.run(outputs);
+
+		if (useData) {
+			data.updateRam();
+			scen.update();
+			float* rewards = reinterpret_cast<float*>(rewardArray.append());
+			for (unsigned p = 0; p < players; ++p) {
+				rewards[p] = scen.currentReward(p);
+			}
+			*doneArray.append() = scen.isDone();
+			if (!names.empty()) {
+				data.lookupAll(values.data());
+				memcpy(variableArray.append(), values.data(), sizeof(int64_t) * values.size());
+			}
+		}
+
+		++result.frames;
+		if (++chunk == m_chunkFrames && !flush()) {
+			result.error = "Could not write shard";
+			return result;
+		}
+	}
+	if (!flush()) {
+		result.error = "Could not write shard";
+		return result;
+	}
+	result.ok = true;
+	return result;
+}
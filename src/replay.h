@@ -0,0 +1,70 @@
+#pragma once
+
+#include "emulator.h"
+#include "threadpool.h"
+
+#include <string>
+#include <vector>
+
+namespace Retro {
+
+// Replays movies without rendering anything to screen and writes what every
+// frame produced to numbered shards of numpy arrays, one series per movie.
+// Each shard holds up to chunkFrames frames:
+//   frame           int64 (n,)                   movie frame index
+//   actions         bool (n, players, buttons)   buttons pressed that frame
+//   obs             uint8 (n, height, width, 3)  screen the buttons were pressed on
+//   rewards         float32 (n, players)         reward the frame earned
+//   done            bool (n,)                    scenario done after the frame
+//   variables       int64 (n, variables)         data.json variables after the frame
+//   variable_names  unicode (variables,)
+// obs is only written with OUTPUT_VIDEO, and rewards, done and variables only
+// with OUTPUT_RAM and a data file or scenario to read them from.
+class Replay {
+public:
+	enum class Format {
+		NPZ, // <output>-00000.npz, loadable with numpy.load
+		NPY, // <output>-00000.<array>.npy, loadable with numpy.load(mmap_mode=...)
+	};
+
+	struct Job {
+		std::string movie;
+		std::string rom;
+		std::string output;
+		std::string data;
+		std::string scenario;
+	};
+
+	struct Result {
+		bool ok = false;
+		size_t frames = 0;
+		std::vector<std::string> shards;
+		std::string error;
+	};
+
+	static constexpr size_t DEFAULT_CHUNK_FRAMES = 1000;
+
+	Replay(unsigned threads = 0);
+
+	void setChunkFrames(size_t frames) { m_chunkFrames = frames ? frames : DEFAULT_CHUNK_FRAMES; }
+	void setFormat(Format format) { m_format = format; }
+	void setOutputs(unsigned outputs) { m_outputs = outputs; }
+	// Zip level for NPZ shards, or -1 for libzip's default; 0 stores them
+	// uncompressed
+	void setCompression(int level) { m_compression = level; }
+
+	unsigned threads() const { return m_pool.size(); }
+
+	// Replays every job across the pool. A failed job doesn't stop the rest.
+	std::vector<Result> run(const std::vector<Job>&);
+
+private:
+	Result replay(const Job&) const;
+
+	ThreadPool m_pool;
+	size_t m_chunkFrames = DEFAULT_CHUNK_FRAMES;
+	Format m_format = Format::NPZ;
+	unsigned m_outputs = OUTPUT_ALL;
+	int m_compression = -1;
+};
+}
@@ -18,10 +18,18 @@ static inline T _hypot(T x, T y) {
 #include "memory.h"
 #include "search.h"
 #include "script.h"
+#include "snapshot.h"
+#include "statedelta.h"
+#include "threadpool.h"
 #include "movie.h"
 #include "movie-bk2.h"
+#include "movie-index.h"
+#include "movie-rmv.h"
+#include "replay.h"
 
+#include <array>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -34,19 +42,25 @@ struct PyGameData;
 struct PyRetroEmulator {
 	Retro::Emulator m_re;
 	int m_cheats = 0;
+
+	// Max-pooled copy of the last two frames of a step, used in place of the
+	// core's framebuffer while m_pooled is set
+	std::vector<uint8_t> m_lastFrame;
+	std::vector<uint8_t> m_pooledFrame;
+	bool m_pooled = false;
+
+	// Scratch space for delta-encoded states
+	std::vector<uint8_t> m_stateBuffer;
+	std::vector<uint8_t> m_deltaBuffer;
+
 	PyRetroEmulator(const string& rom_path) {
-		if (Emulator::isLoaded()) {
-			throw std::runtime_error("Cannot create multiple emulator instances per process, make sure to call env.close() on each environment before creating a new one");
-		}
 		if (!m_re.loadRom(rom_path.c_str())) {
 			throw std::runtime_error("Could not load ROM");
 		}
 		m_re.run(); // otherwise you get a segfault when you try to get screen for the first time
 	}
 
-	void step() {
-		m_re.run();
-	}
+	py::tuple step(unsigned repeat, py::handle data, bool maxPool, py::handle movie, unsigned outputs);
 
 	py::bytes getState() {
 		size_t size = m_re.serializeSize();
@@ -56,23 +70,99 @@ struct PyRetroEmulator {
 	}
 
 	bool setState(py::bytes o) {
+		m_pooled = false;
 		return m_re.unserialize(PyBytes_AsString(o.ptr()), PyBytes_Size(o.ptr()));
 	}
 
-	py::array_t<uint8_t> getScreen() {
-		long w = m_re.getImageWidth();
-		long h = m_re.getImageHeight();
-		py::array_t<uint8_t> arr({ { h, w, 3 } });
-		uint8_t* data = arr.mutable_data();
-		Image out(Image::Format::RGB888, data, w, h, w);
+	py::bytes getStateDelta(py::bytes base) {
+		m_stateBuffer.resize(m_re.serializeSize());
+		if (!m_re.serialize(m_stateBuffer.data(), m_stateBuffer.size())) {
+			throw std::runtime_error("Could not serialize emulator state");
+		}
+		encodeStateDelta(PyBytes_AsString(base.ptr()), PyBytes_Size(base.ptr()), m_stateBuffer.data(), m_stateBuffer.size(), &m_deltaBuffer);
+		return py::bytes(reinterpret_cast<const char*>(m_deltaBuffer.data()), m_deltaBuffer.size());
+	}
+
+	bool setStateDelta(py::bytes base, py::bytes delta) {
+		if (!applyStateDelta(PyBytes_AsString(base.ptr()), PyBytes_Size(base.ptr()), PyBytes_AsString(delta.ptr()), PyBytes_Size(delta.ptr()), &m_stateBuffer)) {
+			return false;
+		}
+		m_pooled = false;
+		return m_re.unserialize(m_stateBuffer.data(), m_stateBuffer.size());
+	}
+
+	static py::bytes encodeDelta(py::bytes base, py::bytes state) {
+		std::vector<uint8_t> delta;
+		encodeStateDelta(PyBytes_AsString(base.ptr()), PyBytes_Size(base.ptr()), PyBytes_AsString(state.ptr()), PyBytes_Size(state.ptr()), &delta);
+		return py::bytes(reinterpret_cast<const char*>(delta.data()), delta.size());
+	}
+
+	static py::bytes applyDelta(py::bytes base, py::bytes delta) {
+		std::vector<uint8_t> state;
+		if (!applyStateDelta(PyBytes_AsString(base.ptr()), PyBytes_Size(base.ptr()), PyBytes_AsString(delta.ptr()), PyBytes_Size(delta.ptr()), &state)) {
+			throw std::runtime_error("Invalid state delta for this base");
+		}
+		return py::bytes(reinterpret_cast<const char*>(state.data()), state.size());
+	}
+
+	py::array_t<uint8_t> getScreen(size_t x, size_t y, size_t w, size_t h) {
+		Image in = screen(x, y, w, h);
+		py::array_t<uint8_t> arr({ in.height(), in.width(), size_t(3) });
+		copyScreen(in, arr.mutable_data());
+		return arr;
+	}
+
+	// Renders the cropped screen into out. A (height, width) array receives
+	// grayscale, a (height, width, 3) array RGB. If out is smaller than the
+	// crop the image is area-averaged down to fit.
+	void getScreenInto(py::array_t<uint8_t, py::array::c_style> out, size_t x, size_t y, size_t w, size_t h) {
+		Image in = screen(x, y, w, h);
+		bool gray = out.ndim() == 2;
+		if (!gray && (out.ndim() != 3 || out.shape(2) != 3)) {
+			throw std::runtime_error("out must be a contiguous uint8 array of shape (height, width) or (height, width, 3)");
+		}
+		size_t oh = out.shape(0);
+		size_t ow = out.shape(1);
+		if (ow > in.width() || oh > in.height()) {
+			throw std::runtime_error("out is larger than the screen");
+		}
+		if (!gray && ow == in.width() && oh == in.height()) {
+			copyScreen(in, out.mutable_data());
+			return;
+		}
+		Image scaled(gray ? Image::Format::G8 : Image::Format::RGB888, out.mutable_data(), ow, oh, gray ? ow : ow * 3);
+		in.scaleTo(&scaled);
+	}
+
+	// Returns the framebuffer clipped to the given rectangle. A zero width or height,
+	// or one extending past the edge of the screen, extends to the edge.
+	Image screen(size_t x = 0, size_t y = 0, size_t w = 0, size_t h = 0) {
+		size_t width = m_re.getImageWidth();
+		size_t height = m_re.getImageHeight();
+		const void* data = m_pooled ? m_pooledFrame.data() : m_re.getImageData();
 		Image in;
 		if (m_re.getImageDepth() == 16) {
-			in = Image(Image::Format::RGB565, m_re.getImageData(), w, h, m_re.getImagePitch());
+			in = Image(Image::Format::RGB565, data, width, height, m_re.getImagePitch());
 		} else if (m_re.getImageDepth() == 32) {
-			in = Image(Image::Format::RGBX888, m_re.getImageData(), w, h, m_re.getImagePitch());
+			in = Image(Image::Format::RGBX888, data, width, height, m_re.getImagePitch());
+		} else {
+			throw std::runtime_error("Unsupported screen format");
 		}
-		in.copyTo(&out);
-		return arr;
+		if (x >= width || y >= height) {
+			throw std::runtime_error("Crop origin is outside of the screen");
+		}
+		if (!w || x + w > width) {
+			w = width - x;
+		}
+		if (!h || y + h > height) {
+			h = height - y;
+		}
+		return in.crop(x, y, w, h);
+	}
+
+	static void copyScreen(const Image& in, uint8_t* data) {
+		Image out(Image::Format::RGB888, data, in.width(), in.height(), in.width() * 3);
+		Image(in).copyTo(&out);
 	}
 
 	double getScreenRate() {
@@ -80,12 +170,29 @@ struct PyRetroEmulator {
 	}
 
 	py::array_t<int16_t> getAudio() {
-		py::array_t<int16_t> arr(py::array::ShapeContainer{ m_re.getAudioSamples(), 2 });
+		size_t channels = m_re.getAudioChannels();
+		py::array_t<int16_t> arr(py::array::ShapeContainer{ static_cast<size_t>(m_re.getAudioSamples()), channels });
 		int16_t* data = arr.mutable_data();
-		memcpy(data, m_re.getAudioData(), m_re.getAudioSamples() * 4);
+		memcpy(data, m_re.getAudioData(), m_re.getAudioSamples() * channels * sizeof(int16_t));
+		return arr;
+	}
+
+	// Read-only view of the emulator's audio buffer. It is only valid until
+	// the next step or audio reconfiguration.
+	py::array_t<int16_t> getAudioView() {
+		size_t channels = m_re.getAudioChannels();
+		py::array_t<int16_t> arr({ static_cast<size_t>(m_re.getAudioSamples()), channels }, m_re.getAudioData(), py::cast(this, py::return_value_policy::reference));
+		arr.attr("setflags")(py::arg("write") = false);
 		return arr;
 	}
 
+	void configureAudio(double rate, unsigned channels) {
+		if (channels != 1 && channels != 2) {
+			throw std::runtime_error("channels must be 1 or 2");
+		}
+		m_re.configureAudio(rate, channels);
+	}
+
 	double getAudioRate() {
 		return m_re.getAudioRate();
 	}
@@ -151,6 +258,42 @@ struct PyMemoryView {
 		}
 		return obj;
 	}
+
+	// Read-only views of the live blocks. They are only valid while the
+	// emulator is loaded and the memory layout is unchanged.
+	py::dict views() {
+		py::dict obj;
+		for (const auto& iter : m_mem.blocks()) {
+			py::array_t<uint8_t> arr({ iter.second.size() }, { size_t(1) }, static_cast<const uint8_t*>(iter.second.offset(0)), py::cast(this, py::return_value_policy::reference));
+			arr.attr("setflags")(py::arg("write") = false);
+			obj[py::int_(iter.first)] = arr;
+		}
+		return obj;
+	}
+
+	size_t size() const {
+		return m_mem.totalSize();
+	}
+
+	void gather(py::array_t<uint8_t, py::array::c_style> out, py::handle addresses) {
+		if (addresses.is_none()) {
+			if (static_cast<size_t>(out.size()) < m_mem.totalSize()) {
+				throw std::runtime_error("output buffer is too small");
+			}
+			m_mem.gather(out.mutable_data());
+			return;
+		}
+		py::array_t<size_t, py::array::c_style | py::array::forcecast> addrs = py::array_t<size_t, py::array::c_style | py::array::forcecast>::ensure(addresses);
+		if (!addrs) {
+			throw std::runtime_error("addresses must be an array of integers");
+		}
+		if (out.size() < addrs.size()) {
+			throw std::runtime_error("output buffer is too small");
+		}
+		if (!m_mem.gather(addrs.data(), addrs.size(), out.mutable_data())) {
+			throw std::runtime_error("address is not mapped");
+		}
+	}
 };
 
 struct PySearch {
@@ -219,8 +362,20 @@ struct PySearch {
 struct PyGameData {
 	Retro::GameData m_data;
 	Retro::Scenario m_scen{ m_data };
+	// Reused by lookupArray, so each result is only valid until the next call
+	py::array_t<int64_t> m_values;
+
+	// Script contexts are shared across the process, so only lock when
+	// this scenario has scripts
+	std::unique_lock<std::mutex> scriptLock() const {
+		if (m_scen.scripts().empty()) {
+			return {};
+		}
+		return std::unique_lock<std::mutex>(ScriptContext::mutex());
+	}
 
 	bool load(py::handle data = py::none(), py::handle scen = py::none()) {
+		std::lock_guard<std::mutex> lock(ScriptContext::mutex());
 		ScriptContext::reset();
 
 		bool success = true;
@@ -246,6 +401,7 @@ struct PyGameData {
 
 	void reset() {
 		m_scen.restart();
+		std::lock_guard<std::mutex> lock(ScriptContext::mutex());
 		m_scen.reloadScripts();
 	}
 
@@ -267,9 +423,18 @@ struct PyGameData {
 
 	void updateRam() {
 		m_data.updateRam();
+		auto lock = scriptLock();
 		m_scen.update();
 	}
 
+	void setFullRamHistory(bool full) {
+		m_data.setFullRamHistory(full);
+	}
+
+	bool fullRamHistory() const {
+		return m_data.fullRamHistory();
+	}
+
 	py::object lookupValue(py::str name) const {
 		try {
 			Variant data = m_data.lookupValue(name);
@@ -312,6 +477,27 @@ struct PyGameData {
 		return data;
 	}
 
+	py::array_t<int64_t> lookupArray() {
+		if (m_data.hasCustomValues()) {
+			throw std::runtime_error("Custom values set with set_value can't be looked up as an array");
+		}
+		size_t size = m_data.variableNames().size();
+		if (static_cast<size_t>(m_values.size()) != size) {
+			m_values = py::array_t<int64_t>({ size }, { sizeof(int64_t) });
+		}
+		m_data.lookupAll(m_values.mutable_data());
+		return m_values;
+	}
+
+	py::dict variableIndex() const {
+		py::dict index;
+		const auto& names = m_data.variableNames();
+		for (size_t i = 0; i < names.size(); ++i) {
+			index[py::str(names[i])] = i;
+		}
+		return index;
+	}
+
 	py::dict getVariable(py::str name) const {
 		py::dict obj;
 		Retro::Variable var = m_data.getVariable(name);
@@ -394,12 +580,232 @@ void PyRetroEmulator::configureData(PyGameData& data) {
 	m_re.configureData(&data.m_data);
 }
 
+struct PyVecRetroEmulator {
+	std::vector<PyRetroEmulator*> m_envs;
+	std::vector<PyGameData*> m_data;
+	py::list m_refs;
+	Retro::ThreadPool m_pool;
+
+	long m_screenWidth;
+	long m_screenHeight;
+	// Player 0's scenario crop for each emulator, as RetroEnv observes
+	std::vector<std::array<size_t, 4>> m_crops;
+	long m_width;
+	long m_height;
+	unsigned m_players;
+	py::array_t<uint8_t> m_obs;
+	py::array_t<float> m_rewards;
+	py::array_t<bool> m_dones;
+
+	PyVecRetroEmulator(py::list envs, py::handle data, unsigned players, unsigned threads)
+		: m_pool(threads)
+		, m_players(players) {
+		if (!envs.size()) {
+			throw std::runtime_error("No emulators given");
+		}
+		if (!players || players > MAX_PLAYERS) {
+			throw std::runtime_error("players must be between 1 and MAX_PLAYERS");
+		}
+		// Each emulator is stepped on its own thread, so none can appear twice
+		std::unordered_set<const void*> seen;
+		for (const auto& env : envs) {
+			m_envs.emplace_back(env.cast<PyRetroEmulator*>());
+			m_refs.append(env);
+			if (!seen.insert(m_envs.back()).second) {
+				throw std::runtime_error("The same emulator was given more than once");
+			}
+		}
+		if (!data.is_none()) {
+			for (const auto& datum : data) {
+				m_data.emplace_back(datum.cast<PyGameData*>());
+				m_refs.append(datum);
+				if (!seen.insert(m_data.back()).second) {
+					throw std::runtime_error("The same data object was given more than once");
+				}
+			}
+			if (m_data.size() != m_envs.size()) {
+				throw std::runtime_error("Number of data objects does not match number of emulators");
+			}
+		}
+		checkScripts();
+
+		m_screenWidth = m_envs[0]->m_re.getImageWidth();
+		m_screenHeight = m_envs[0]->m_re.getImageHeight();
+		for (size_t i = 0; i < m_envs.size(); ++i) {
+			if (m_envs[i]->m_re.getImageWidth() != m_screenWidth || m_envs[i]->m_re.getImageHeight() != m_screenHeight) {
+				throw std::runtime_error("All emulators must have the same resolution");
+			}
+			std::array<size_t, 4> crop{};
+			if (!m_data.empty()) {
+				m_data[i]->m_scen.getCrop(&crop[0], &crop[1], &crop[2], &crop[3]);
+			}
+			Image screen = m_envs[i]->screen(crop[0], crop[1], crop[2], crop[3]);
+			if (!i) {
+				m_width = screen.width();
+				m_height = screen.height();
+			} else if (static_cast<long>(screen.width()) != m_width || static_cast<long>(screen.height()) != m_height) {
+				throw std::runtime_error("All emulators must have the same cropped resolution");
+			}
+			m_crops.emplace_back(crop);
+		}
+		m_obs = py::array_t<uint8_t>({ static_cast<long>(m_envs.size()), m_height, m_width, 3L });
+		m_rewards = py::array_t<float>({ m_envs.size(), static_cast<size_t>(players) });
+		m_dones = py::array_t<bool>({ m_envs.size() }, { sizeof(bool) });
+	}
+
+	size_t numEnvs() const {
+		return m_envs.size();
+	}
+
+	// Script contexts are shared across the process and bound to the last
+	// scenario that loaded them, so they can only serve a single emulator
+	void checkScripts() const {
+		if (m_envs.size() < 2) {
+			return;
+		}
+		for (const auto* data : m_data) {
+			if (!data->m_scen.scripts().empty()) {
+				throw std::runtime_error("Scenarios with scripts can't be stepped with more than one emulator");
+			}
+		}
+	}
+
+	py::tuple step(py::array_t<uint8_t, py::array::c_style | py::array::forcecast> actions) {
+		size_t buttons = actions.ndim() == 3 ? actions.shape(2) : 0;
+		if (actions.ndim() != 3 || actions.shape(0) != static_cast<py::ssize_t>(m_envs.size()) || actions.shape(1) != static_cast<py::ssize_t>(m_players)) {
+			throw std::runtime_error("actions must have shape (num_envs, players, buttons)");
+		}
+		if (buttons > N_BUTTONS) {
+			throw std::runtime_error("buttons > N_BUTTONS");
+		}
+
+		checkScripts();
+
+		const uint8_t* actionData = actions.data();
+		uint8_t* obs = m_obs.mutable_data();
+		float* rewards = m_rewards.mutable_data();
+		bool* dones = m_dones.mutable_data();
+		size_t frameSize = m_width * m_height * 3;
+		std::function<void(size_t)> job = [&](size_t i) {
+			Retro::Emulator& re = m_envs[i]->m_re;
+			const uint8_t* action = &actionData[i * m_players * buttons];
+			for (unsigned p = 0; p < m_players; ++p) {
+				for (size_t key = 0; key < buttons; ++key) {
+					re.setKey(p, key, action[p * buttons + key]);
+				}
+			}
+			re.run(m_data.empty() ? Retro::OUTPUT_VIDEO : Retro::OUTPUT_VIDEO | Retro::OUTPUT_RAM);
+			if (re.getImageWidth() != m_screenWidth || re.getImageHeight() != m_screenHeight) {
+				throw std::runtime_error("Emulator resolution changed");
+			}
+			const auto& crop = m_crops[i];
+			PyRetroEmulator::copyScreen(m_envs[i]->screen(crop[0], crop[1], crop[2], crop[3]), &obs[i * frameSize]);
+
+			if (m_data.empty()) {
+				for (unsigned p = 0; p < m_players; ++p) {
+					rewards[i * m_players + p] = 0;
+				}
+				dones[i] = false;
+				return;
+			}
+			PyGameData& data = *m_data[i];
+			data.m_data.updateRam();
+			auto lock = data.scriptLock();
+			data.m_scen.update();
+			for (unsigned p = 0; p < m_players; ++p) {
+				rewards[i * m_players + p] = data.m_scen.currentReward(p);
+			}
+			dones[i] = data.m_scen.isDone();
+		};
+		{
+			py::gil_scoped_release release;
+			m_pool.parallelFor(m_envs.size(), job);
+		}
+		return py::make_tuple(m_obs, m_rewards, m_dones);
+	}
+};
+
+struct PySnapshotPool {
+	Retro::SnapshotPool m_pool;
+	std::vector<uint8_t> m_scratch;
+
+	PySnapshotPool(size_t pageSize, size_t reserve)
+		: m_pool(pageSize) {
+		m_pool.reserve((reserve + m_pool.pageSize() - 1) / m_pool.pageSize());
+	}
+
+	SnapshotPool::Handle save(PyRetroEmulator& emu) {
+		m_scratch.resize(emu.m_re.serializeSize());
+		if (!emu.m_re.serialize(m_scratch.data(), m_scratch.size())) {
+			throw std::runtime_error("Could not serialize emulator state");
+		}
+		return m_pool.save(m_scratch.data(), m_scratch.size());
+	}
+
+	bool restore(PyRetroEmulator& emu, SnapshotPool::Handle handle) {
+		checkHandle(handle);
+		m_scratch.resize(m_pool.size(handle));
+		if (!m_pool.load(handle, m_scratch.data(), m_scratch.size())) {
+			return false;
+		}
+		emu.m_pooled = false;
+		return emu.m_re.unserialize(m_scratch.data(), m_scratch.size());
+	}
+
+	void release(SnapshotPool::Handle handle) {
+		checkHandle(handle);
+		m_pool.release(handle);
+	}
+
+	SnapshotPool::Handle addState(py::bytes state) {
+		return m_pool.save(PyBytes_AsString(state.ptr()), PyBytes_Size(state.ptr()));
+	}
+
+	py::bytes getState(SnapshotPool::Handle handle) {
+		checkHandle(handle);
+		py::bytes bytes(NULL, m_pool.size(handle));
+		m_pool.load(handle, PyBytes_AsString(bytes.ptr()), m_pool.size(handle));
+		return bytes;
+	}
+
+	size_t numSnapshots() const {
+		return m_pool.snapshots();
+	}
+
+	size_t numPages() const {
+		return m_pool.pagesUsed();
+	}
+
+	size_t pageSize() const {
+		return m_pool.pageSize();
+	}
+
+	size_t reservedBytes() const {
+		return m_pool.bytesReserved();
+	}
+
+	void checkHandle(SnapshotPool::Handle handle) const {
+		if (!m_pool.valid(handle)) {
+			throw std::runtime_error("Invalid snapshot handle");
+		}
+	}
+};
+
 struct PyMovie {
 	std::unique_ptr<Retro::Movie> m_movie;
+	std::unique_ptr<Retro::MovieIndex> m_index;
+	std::string m_path;
 	bool recording = false;
-	PyMovie(py::str name, bool record, unsigned players) {
+	PyMovie(py::str name, bool record, unsigned players, unsigned keyframeInterval) {
 		recording = record;
-		if (record) {
+		std::string path = name;
+		m_path = path;
+		if (record && path.size() > 4 && path.compare(path.size() - 4, 4, ".rmv") == 0) {
+			m_movie = std::make_unique<MovieRMV>(path, true, players, keyframeInterval);
+			if (!static_cast<MovieRMV*>(m_movie.get())->ok()) {
+				m_movie.reset();
+			}
+		} else if (record) {
 			m_movie = std::make_unique<MovieBK2>(name, true, players);
 		} else {
 			m_movie = Movie::load(name);
@@ -410,7 +816,13 @@ struct PyMovie {
 	}
 
 	void configure(py::str name, const PyRetroEmulator& emu) {
-		if (recording) {
+		if (!recording) {
+			return;
+		}
+		if (MovieRMV* rmv = dynamic_cast<MovieRMV*>(m_movie.get())) {
+			rmv->setGameName(name);
+			rmv->setPlatform(emu.m_re.core());
+		} else {
 			static_cast<MovieBK2*>(m_movie.get())->setGameName(name);
 			static_cast<MovieBK2*>(m_movie.get())->loadKeymap(emu.m_re.core());
 		}
@@ -449,8 +861,215 @@ struct PyMovie {
 	void setState(py::bytes data) {
 		m_movie->setState(reinterpret_cast<uint8_t*>(PyBytes_AsString(data.ptr())), PyBytes_Size(data.ptr()));
 	}
+
+	size_t frames() const {
+		return m_movie->frames();
+	}
+
+	// With an emulator, also restores it to the state it had just before frame
+	bool seek(size_t frame, py::handle emulator) {
+		if (emulator.is_none()) {
+			return m_movie->seek(frame);
+		}
+		PyRetroEmulator& emu = emulator.cast<PyRetroEmulator&>();
+		emu.m_pooled = false;
+		py::gil_scoped_release release;
+		return MovieIndex::seek(m_movie.get(), &emu.m_re, frame, m_index.get());
+	}
+
+	// Loads the movie's keyframe sidecar, or builds and saves one by
+	// replaying the movie on emulator, which must have its game loaded
+	bool loadIndex(PyRetroEmulator& emu, py::handle cacheDir, unsigned interval) {
+		if (recording) {
+			return false;
+		}
+		std::string dir = cacheDir.is_none() ? std::string() : std::string(py::str(cacheDir));
+		auto index = std::make_unique<MovieIndex>();
+		bool ok;
+		{
+			py::gil_scoped_release release;
+			ok = index->open(m_path, m_movie.get(), &emu.m_re, dir, interval);
+		}
+		if (ok) {
+			m_index = std::move(index);
+		}
+		return ok;
+	}
+
+	py::object getKeyframe(size_t frame) const {
+		size_t keyframe;
+		std::vector<uint8_t> data;
+		bool found = m_index ? m_index->getKeyframe(frame, &keyframe, &data) : m_movie->getKeyframe(frame, &keyframe, &data);
+		if (!found) {
+			return py::none();
+		}
+		return py::make_tuple(keyframe, py::bytes(reinterpret_cast<const char*>(data.data()), data.size()));
+	}
+
+	bool wantsKeyframe() const {
+		return m_movie->wantsKeyframe();
+	}
+
+	void addKeyframe(py::bytes data) {
+		m_movie->addKeyframe(reinterpret_cast<uint8_t*>(PyBytes_AsString(data.ptr())), PyBytes_Size(data.ptr()));
+	}
+
+	static bool convert(const string& from, const string& to) {
+		return MovieRMV::convert(from, to);
+	}
+};
+
+struct PyReplay {
+	Retro::Replay m_replay;
+	std::vector<Retro::Replay::Job> m_jobs;
+
+	PyReplay(unsigned threads, size_t chunkFrames, const string& format, unsigned outputs, int compression)
+		: m_replay(threads) {
+		if (format == "npz") {
+			m_replay.setFormat(Retro::Replay::Format::NPZ);
+		} else if (format == "npy") {
+			m_replay.setFormat(Retro::Replay::Format::NPY);
+		} else {
+			throw std::runtime_error("format must be npz or npy");
+		}
+		m_replay.setChunkFrames(chunkFrames);
+		m_replay.setOutputs(outputs);
+		if (compression > Retro::Zip::BEST_COMPRESSION) {
+			throw std::runtime_error("compression must be at most 9");
+		}
+		m_replay.setCompression(compression);
+	}
+
+	void add(const string& movie, const string& rom, const string& output, py::handle data, py::handle scenario) {
+		Retro::Replay::Job job{ movie, rom, output };
+		if (!data.is_none()) {
+			job.data = py::str(data);
+		}
+		if (!scenario.is_none()) {
+			job.scenario = py::str(scenario);
+		}
+		m_jobs.emplace_back(std::move(job));
+	}
+
+	size_t numJobs() const {
+		return m_jobs.size();
+	}
+
+	unsigned threads() const {
+		return m_replay.threads();
+	}
+
+	// Replays every added movie and clears the queue
+	py::list run() {
+		std::vector<Retro::Replay::Result> results;
+		{
+			py::gil_scoped_release release;
+			results = m_replay.run(m_jobs);
+		}
+		py::list out;
+		for (size_t i = 0; i < results.size(); ++i) {
+			py::dict result;
+			result["movie"] = m_jobs[i].movie;
+			result["ok"] = results[i].ok;
+			result["frames"] = results[i].frames;
+			py::list shards;
+			for (const auto& shard : results[i].shards) {
+				shards.append(shard);
+			}
+			result["shards"] = shards;
+			result["error"] = results[i].error;
+			out.append(result);
+		}
+		m_jobs.clear();
+		return out;
+	}
 };
 
+// Runs up to repeat frames with the current buttons, updating data and summing
+// its rewards each frame and stopping early once it reports done. If movie is
+// given the buttons are recorded for every frame. With maxPool the screen is
+// the per-channel maximum of the last two frames run. outputs applies to the
+// final frame; the frames before it skip audio and, unless needed for pooling,
+// video, so a core that honors this may leave the screen stale if data ends
+// the step early.
+py::tuple PyRetroEmulator::step(unsigned repeat, py::handle data, bool maxPool, py::handle movie, unsigned outputs) {
+	PyGameData* gameData = data.is_none() ? nullptr : data.cast<PyGameData*>();
+	Retro::Movie* recording = movie.is_none() ? nullptr : movie.cast<PyMovie*>()->m_movie.get();
+	if (!repeat) {
+		throw std::runtime_error("repeat must be at least 1");
+	}
+	if (gameData && !(outputs & Retro::OUTPUT_RAM)) {
+		throw std::runtime_error("Rewards and done need OUTPUT_RAM");
+	}
+	float rewards[MAX_PLAYERS]{};
+	bool done = false;
+	unsigned frames = 0;
+	m_pooled = false;
+	{
+		py::gil_scoped_release release;
+		// Only the last frames are rendered, so the repeat always runs to the
+		// end; rewards stop counting once the scenario is done
+		while (frames < repeat) {
+			bool last = frames == repeat - 1;
+			unsigned frameOutputs = outputs & Retro::OUTPUT_RAM;
+			if (last) {
+				frameOutputs = outputs;
+			} else if (maxPool && frames == repeat - 2) {
+				frameOutputs |= Retro::OUTPUT_VIDEO;
+			}
+			if (maxPool && last && frames) {
+				const uint8_t* frame = static_cast<const uint8_t*>(m_re.getImageData());
+				m_lastFrame.assign(frame, frame + m_re.getImagePitch() * m_re.getImageHeight());
+			}
+			if (recording) {
+				if (recording->wantsKeyframe()) {
+					m_stateBuffer.resize(m_re.serializeSize());
+					if (m_re.serialize(m_stateBuffer.data(), m_stateBuffer.size())) {
+						recording->addKeyframe(m_stateBuffer.data(), m_stateBuffer.size());
+					}
+				}
+				for (unsigned p = 0; p < recording->players(); ++p) {
+					for (int key = 0; key < N_BUTTONS; ++key) {
+						recording->setKey(key, m_re.getKey(p, key), p);
+					}
+				}
+				recording->step();
+			}
+			m_re.run(frameOutputs);
+			++frames;
+			if (gameData) {
+				gameData->m_data.updateRam();
+				auto lock = gameData->scriptLock();
+				gameData->m_scen.update();
+				if (!done) {
+					for (unsigned p = 0; p < MAX_PLAYERS; ++p) {
+						rewards[p] += gameData->m_scen.currentReward(p);
+					}
+					done = gameData->m_scen.isDone();
+				}
+			}
+		}
+		size_t frameSize = m_re.getImagePitch() * m_re.getImageHeight();
+		bool poolable = m_re.getImageDepth() == 16 || m_re.getImageDepth() == 32;
+		if (maxPool && poolable && repeat > 1 && m_lastFrame.size() == frameSize) {
+			m_pooledFrame.resize(frameSize);
+			Image current = screen();
+			size_t width = m_re.getImageWidth();
+			size_t height = m_re.getImageHeight();
+			Image::Format format = m_re.getImageDepth() == 16 ? Image::Format::RGB565 : Image::Format::RGBX888;
+			Image previous(format, static_cast<const void*>(m_lastFrame.data()), width, height, m_re.getImagePitch());
+			Image pooled(format, static_cast<void*>(m_pooledFrame.data()), width, height, m_re.getImagePitch());
+			current.maxTo(previous, &pooled);
+			m_pooled = true;
+		}
+	}
+	py::list rewardList;
+	for (unsigned p = 0; p < MAX_PLAYERS; ++p) {
+		rewardList.append(rewards[p]);
+	}
+	return py::make_tuple(rewardList, done);
+}
+
 py::str corePath(py::handle hint = py::none()) {
 	return Retro::corePath(py::str(hint));
 }
@@ -464,25 +1083,59 @@ PYBIND11_MODULE(_retro, m) {
 
 	py::class_<PyRetroEmulator>(m, "RetroEmulator")
 		.def(py::init<const string&>())
-		.def("step", &PyRetroEmulator::step)
+		.def("step", &PyRetroEmulator::step, py::arg("repeat") = 1, py::arg("data") = py::none(), py::arg("max_pool") = false, py::arg("movie") = py::none(), py::arg("outputs") = static_cast<unsigned>(Retro::OUTPUT_ALL))
 		.def("set_button_mask", &PyRetroEmulator::setButtonMask, py::arg("mask"), py::arg("player") = 0)
 		.def("get_state", &PyRetroEmulator::getState)
 		.def("set_state", &PyRetroEmulator::setState)
-		.def("get_screen", &PyRetroEmulator::getScreen)
+		.def("get_state_delta", &PyRetroEmulator::getStateDelta, py::arg("base"))
+		.def("set_state_delta", &PyRetroEmulator::setStateDelta, py::arg("base"), py::arg("delta"))
+		.def("get_screen", &PyRetroEmulator::getScreen, py::arg("x") = 0, py::arg("y") = 0, py::arg("width") = 0, py::arg("height") = 0)
+		.def("get_screen_into", &PyRetroEmulator::getScreenInto, py::arg("out").noconvert(), py::arg("x") = 0, py::arg("y") = 0, py::arg("width") = 0, py::arg("height") = 0)
 		.def("get_screen_rate", &PyRetroEmulator::getScreenRate)
 		.def("get_audio", &PyRetroEmulator::getAudio)
+		.def("get_audio_view", &PyRetroEmulator::getAudioView)
 		.def("get_audio_rate", &PyRetroEmulator::getAudioRate)
+		.def("configure_audio", &PyRetroEmulator::configureAudio, py::arg("rate") = 0, py::arg("channels") = 2)
 		.def("get_resolution", &PyRetroEmulator::getResolution)
 		.def("configure_data", &PyRetroEmulator::configureData)
 		.def("add_cheat", &PyRetroEmulator::addCheat)
 		.def("clear_cheats", &PyRetroEmulator::clearCheats)
+		.def_static("encode_state_delta", &PyRetroEmulator::encodeDelta, py::arg("base"), py::arg("state"))
+		.def_static("apply_state_delta", &PyRetroEmulator::applyDelta, py::arg("base"), py::arg("delta"))
 		.def_static("load_core_info", &PyRetroEmulator::loadCoreInfo);
 
+	py::class_<PyVecRetroEmulator>(m, "VecRetroEmulator")
+		.def(py::init<py::list, py::handle, unsigned, unsigned>(), py::arg("emulators"), py::arg("data") = py::none(), py::arg("players") = 1, py::arg("threads") = 0)
+		.def("num_envs", &PyVecRetroEmulator::numEnvs)
+		.def("step", &PyVecRetroEmulator::step, py::arg("actions"));
+
+	py::class_<PyReplay>(m, "Replay")
+		.def(py::init<unsigned, size_t, const string&, unsigned, int>(), py::arg("threads") = 0, py::arg("chunk_frames") = Retro::Replay::DEFAULT_CHUNK_FRAMES, py::arg("format") = "npz", py::arg("outputs") = static_cast<unsigned>(Retro::OUTPUT_VIDEO | Retro::OUTPUT_RAM), py::arg("compression") = static_cast<int>(Retro::Zip::DEFAULT_COMPRESSION))
+		.def("add", &PyReplay::add, py::arg("movie"), py::arg("rom"), py::arg("output"), py::arg("data") = py::none(), py::arg("scenario") = py::none())
+		.def("run", &PyReplay::run)
+		.def("__len__", &PyReplay::numJobs)
+		.def_property_readonly("threads", &PyReplay::threads);
+
+	py::class_<PySnapshotPool>(m, "SnapshotPool")
+		.def(py::init<size_t, size_t>(), py::arg("page_size") = 4096, py::arg("reserve") = 0)
+		.def("save", &PySnapshotPool::save, py::arg("emulator"))
+		.def("restore", &PySnapshotPool::restore, py::arg("emulator"), py::arg("handle"))
+		.def("release", &PySnapshotPool::release, py::arg("handle"))
+		.def("add_state", &PySnapshotPool::addState, py::arg("state"))
+		.def("get_state", &PySnapshotPool::getState, py::arg("handle"))
+		.def("__len__", &PySnapshotPool::numSnapshots)
+		.def_property_readonly("num_pages", &PySnapshotPool::numPages)
+		.def_property_readonly("page_size", &PySnapshotPool::pageSize)
+		.def_property_readonly("reserved_bytes", &PySnapshotPool::reservedBytes);
+
 	py::class_<PyMemoryView>(m, "Memory")
 		.def(py::init<Retro::AddressSpace&>())
 		.def("extract", &PyMemoryView::extract, py::arg("address"), py::arg("type"))
 		.def("assign", &PyMemoryView::assign, py::arg("address"), py::arg("type"), py::arg("value"))
 		.def_property_readonly("blocks", &PyMemoryView::blocks)
+		.def_property_readonly("views", &PyMemoryView::views)
+		.def_property_readonly("size", &PyMemoryView::size)
+		.def("gather", &PyMemoryView::gather, py::arg("out").noconvert(), py::arg("addresses") = py::none())
 		.def("__setitem__", &PyMemoryView::setitem, py::arg("item"), py::arg("value"))
 		.def("__getitem__", &PyMemoryView::getitem, py::arg("item"));
 
@@ -501,9 +1154,12 @@ PYBIND11_MODULE(_retro, m) {
 		.def("filter_action", &PyGameData::filterAction)
 		.def("valid_actions", &PyGameData::validActions)
 		.def("update_ram", &PyGameData::updateRam)
+		.def_property("full_ram_history", &PyGameData::fullRamHistory, &PyGameData::setFullRamHistory)
 		.def("lookup_value", &PyGameData::lookupValue)
 		.def("set_value", &PyGameData::setValue)
 		.def("lookup_all", &PyGameData::lookupAll)
+		.def("lookup_array", &PyGameData::lookupArray)
+		.def("variable_index", &PyGameData::variableIndex)
 		.def("get_variable", &PyGameData::getVariable)
 		.def("set_variable", &PyGameData::setVariable)
 		.def("remove_variable", &PyGameData::removeVariable)
@@ -517,10 +1173,10 @@ PYBIND11_MODULE(_retro, m) {
 		.def("total_reward", &PyGameData::totalReward, py::arg("player") = 0)
 		.def("is_done", &PyGameData::isDone)
 		.def("crop_info", &PyGameData::cropInfo, py::arg("player") = 0)
-		.def_property_readonly("memory", &PyGameData::memory);
+		.def_property_readonly("memory", py::cpp_function(&PyGameData::memory, py::keep_alive<0, 1>()));
 
 	py::class_<PyMovie>(m, "Movie")
-		.def(py::init<py::str, bool, unsigned>(), py::arg("path"), py::arg("record") = false, py::arg("players") = 1)
+		.def(py::init<py::str, bool, unsigned, unsigned>(), py::arg("path"), py::arg("record") = false, py::arg("players") = 1, py::arg("keyframe_interval") = MovieRMV::DEFAULT_KEYFRAME_INTERVAL)
 		.def("configure", &PyMovie::configure)
 		.def("get_game", &PyMovie::getGameName)
 		.def("step", &PyMovie::step)
@@ -529,7 +1185,19 @@ PYBIND11_MODULE(_retro, m) {
 		.def("get_key", &PyMovie::getKey)
 		.def("set_key", &PyMovie::setKey)
 		.def("get_state", &PyMovie::getState)
-		.def("set_state", &PyMovie::setState);
+		.def("set_state", &PyMovie::setState)
+		.def_property_readonly("frames", &PyMovie::frames)
+		.def("seek", &PyMovie::seek, py::arg("frame"), py::arg("emulator") = py::none())
+		.def("load_index", &PyMovie::loadIndex, py::arg("emulator"), py::arg("cache_dir") = py::none(), py::arg("interval") = Retro::MovieIndex::DEFAULT_INTERVAL)
+		.def("get_keyframe", &PyMovie::getKeyframe)
+		.def("wants_keyframe", &PyMovie::wantsKeyframe)
+		.def("add_keyframe", &PyMovie::addKeyframe)
+		.def_static("convert", &PyMovie::convert, py::arg("source"), py::arg("dest"));
+
+	m.attr("OUTPUT_VIDEO") = static_cast<unsigned>(Retro::OUTPUT_VIDEO);
+	m.attr("OUTPUT_AUDIO") = static_cast<unsigned>(Retro::OUTPUT_AUDIO);
+	m.attr("OUTPUT_RAM") = static_cast<unsigned>(Retro::OUTPUT_RAM);
+	m.attr("OUTPUT_ALL") = static_cast<unsigned>(Retro::OUTPUT_ALL);
 
 	m.def("core_path", &::corePath, py::arg("hint") = py::none());
 	m.def("data_path", &::dataPath, py::arg("hint") = py::none());
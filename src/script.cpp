@@ -12,6 +12,7 @@ static unordered_map<string, function<shared_ptr<ScriptContext>()>> s_scriptType
 };
 
 static unordered_map<string, shared_ptr<ScriptContext>> s_scriptContexts;
+static mutex s_scriptMutex;
 
 shared_ptr<ScriptContext> ScriptContext::get(const string& type) {
 	if (type.empty() && s_scriptContexts.size() == 1) {
@@ -46,6 +47,10 @@ void ScriptContext::reset() {
 	s_scriptContexts.clear();
 }
 
+mutex& ScriptContext::mutex() {
+	return s_scriptMutex;
+}
+
 void ScriptContext::setData(GameData* data) {
 	m_data = data;
 }
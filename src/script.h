@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -16,6 +17,9 @@ public:
 	static std::shared_ptr<ScriptContext> get(const std::string& type);
 	static std::vector<std::string> listContexts();
 	static void reset();
+	// Contexts are shared by the whole process; hold this while resetting,
+	// loading or calling into them
+	static std::mutex& mutex();
 
 	virtual void setData(GameData*);
 	virtual void setScenario(const Scenario*);
@@ -1,9 +1,15 @@
 #include "search.h"
 
 #include "data.h"
+#include "threadpool.h"
 
-#include <unordered_map>
-#include <unordered_set>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#include <mutex>
+#include <stdexcept>
 
 using namespace Retro;
 using namespace std;
@@ -85,11 +91,70 @@ TypedSearchResult::operator Variable() const {
 }
 
 Search::Search()
-	: m_types(s_defaultTypes) {
+	: Search(s_defaultTypes) {
 }
 
 Search::Search(const vector<DataType>& types)
 	: m_types(types) {
+	// Type ids follow the initial type order, which breaks ties between
+	// candidates at the same address
+	for (const auto& type : m_types) {
+		internType(type);
+	}
+}
+
+uint32_t Search::internType(const DataType& type) {
+	for (uint32_t i = 0; i < m_typeTable.size(); ++i) {
+		if (m_typeTable[i] == type) {
+			return i;
+		}
+	}
+	m_typeTable.emplace_back(type);
+	return m_typeTable.size() - 1;
+}
+
+uint32_t Search::internForm(const SearchResult& result, uint32_t type) {
+	auto key = make_tuple(type, result.mult, result.div, result.bias);
+	auto iter = m_formIndex.find(key);
+	if (iter != m_formIndex.end()) {
+		return iter->second;
+	}
+	m_forms.emplace_back(Form{ type, result.mult, result.div, result.bias });
+	m_formIndex.emplace(key, m_forms.size() - 1);
+
+	vector<uint32_t> order(m_forms.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		const Form& fa = m_forms[a];
+		const Form& fb = m_forms[b];
+		return make_tuple(fa.mult, fa.div, fa.bias, fa.type) < make_tuple(fb.mult, fb.div, fb.bias, fb.type);
+	});
+	m_formRank.resize(order.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		m_formRank[order[i]] = i;
+	}
+	return m_forms.size() - 1;
+}
+
+bool Search::findForm(const TypedSearchResult& result, uint32_t* form) const {
+	for (uint32_t type = 0; type < m_typeTable.size(); ++type) {
+		if (m_typeTable[type] == result.type) {
+			auto iter = m_formIndex.find(make_tuple(type, result.mult, result.div, result.bias));
+			if (iter == m_formIndex.end()) {
+				return false;
+			}
+			*form = iter->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+TypedSearchResult Search::makeResult(const CandidateSet::Candidate& candidate) const {
+	const Form& form = m_forms[candidate.second];
+	return TypedSearchResult(SearchResult{ candidate.first, form.mult, form.div, form.bias }, m_typeTable[form.type]);
 }
 
 void Search::search(const AddressSpace& mem, int64_t value) {
@@ -171,73 +236,166 @@ void Search::search(const AddressSpace& mem, int64_t value) {
 	reduceOnTypes(mem, results, value);
 }
 
-void Search::delta(const AddressSpace& mem, const AddressSpace& oldMem, Operation op, int64_t reference) {
-	vector<DataType> newTypes;
-	multimap<size_t, DataType> results;
-	for (const auto& type : m_types) {
-		for (const auto& block : mem.blocks()) {
-			const MemoryView<>& oldBlock = oldMem.block(block.first);
-			const DynamicMemoryView dynmem(const_cast<void*>(block.second.offset(0)), block.second.size(), type, mem.overlay());
-			const DynamicMemoryView dynmemOld(const_cast<void*>(oldBlock.offset(0)), oldBlock.size(), type, mem.overlay());
-			vector<size_t> addresses;
-			if (m_hasStarted) {
-				for (const auto& result : m_current) {
-					if (result.type == type && result.address >= block.first && result.address + type.width - block.first <= block.second.size()) {
-						addresses.push_back(result.address);
+// Delta searches over many types share one pool. A search that finds it
+// busy, e.g. from another thread, runs serially instead of waiting.
+static ThreadPool& searchPool() {
+	static ThreadPool pool;
+	return pool;
+}
+static mutex s_searchPoolMutex;
+
+// First index at or after start where the blocks differ, or size
+static size_t nextDifference(const uint8_t* a, const uint8_t* b, size_t start, size_t size) {
+	size_t i = start;
+#ifdef __SSE2__
+	for (; i + 16 <= size; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&a[i]));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&b[i]));
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) ^ 0xFFFF;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	for (; i + 16 <= size; i += 16) {
+		if (vminvq_u8(vceqq_u8(vld1q_u8(&a[i]), vld1q_u8(&b[i]))) != 0xFF) {
+			break;
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if (a[i] != b[i]) {
+			return i;
+		}
+	}
+	return size;
+}
+
+vector<size_t> Search::deltaType(const AddressSpace& mem, const AddressSpace& oldMem, uint32_t form, Operation op, int64_t reference) const {
+	const DataType& type = m_typeTable[m_forms[form].type];
+	vector<size_t> results;
+	// When an unchanged value can't match, only addresses near a changed
+	// byte need decoding. A value at i only reads bytes in [i - 8, i + 16).
+	bool skipUnchanged = !calculate(op, reference, 0);
+	for (const auto& block : mem.blocks()) {
+		const MemoryView<>& oldBlock = oldMem.block(block.first);
+		const DynamicMemoryView dynmem(const_cast<void*>(block.second.offset(0)), block.second.size(), type, mem.overlay());
+		const DynamicMemoryView dynmemOld(const_cast<void*>(oldBlock.offset(0)), oldBlock.size(), type, mem.overlay());
+		const CompiledVariable compiled = mem.compile(Variable{ type, block.first });
+		const uint8_t* data = static_cast<const uint8_t*>(block.second.offset(0));
+		const uint8_t* oldData = static_cast<const uint8_t*>(oldBlock.offset(0));
+		size_t size = min(block.second.size(), oldBlock.size());
+		auto test = [&](size_t i) {
+			int64_t delta;
+			if (compiled.decode && ((i + type.width - 1) | compiled.swizzle) < size) {
+				delta = compiled.decodeAt(data, i) - compiled.decodeAt(oldData, i);
+			} else {
+				delta = dynmem[i] - dynmemOld[i];
+			}
+			return calculate(op, reference, delta) != 0;
+		};
+
+		if (m_hasStarted) {
+			m_current.forEachAddress(form, [&](size_t address) {
+				if (address >= block.first && address + type.width - block.first <= block.second.size()) {
+					if (test(address - block.first)) {
+						results.push_back(address);
 					}
 				}
-				if (!addresses.size()) {
-					continue;
-				}
-			}
+			});
+			continue;
+		}
 
-			if (addresses.size()) {
-				for (const auto& i : addresses) {
-					int64_t delta = dynmem[i - block.first] - dynmemOld[i - block.first];
-					if (calculate(op, reference, delta)) {
-						if (!newTypes.size() || newTypes.back() != type) {
-							newTypes.emplace_back(type);
-						}
-						results.emplace(i, type);
-					}
+		for (size_t i = 0; i + type.width <= block.second.size(); ++i) {
+			if (skipUnchanged && block.second.size() == oldBlock.size()) {
+				size_t change = nextDifference(data, oldData, i < 8 ? 0 : i - 8, size);
+				if (change >= size) {
+					break;
 				}
-			} else {
-				for (size_t i = 0; i + type.width <= block.second.size(); ++i) {
-					int64_t delta = dynmem[i] - dynmemOld[i];
-					if (calculate(op, reference, delta)) {
-						if (!newTypes.size() || newTypes.back() != type) {
-							newTypes.emplace_back(type);
-						}
-						results.emplace(i + block.first, type);
+				if (change >= i + 16) {
+					i = change - 15;
+					if (i + type.width > block.second.size()) {
+						break;
 					}
 				}
 			}
+			if (test(i)) {
+				results.push_back(i + block.first);
+			}
+		}
+	}
+	// Overlapping blocks are the only way to get out of order
+	if (!is_sorted(results.begin(), results.end())) {
+		sort(results.begin(), results.end());
+	}
+	return results;
+}
+
+void Search::delta(const AddressSpace& mem, const AddressSpace& oldMem, Operation op, int64_t reference) {
+	// Delta matches are always unscaled
+	vector<uint32_t> forms;
+	for (const auto& type : m_types) {
+		forms.emplace_back(internForm(SearchResult{ 0, 1, 1, 0 }, internType(type)));
+	}
+
+	vector<vector<size_t>> found(m_types.size());
+	auto job = [&](size_t t) {
+		found[t] = deltaType(mem, oldMem, forms[t], op, reference);
+	};
+	unique_lock<mutex> lock(s_searchPoolMutex, try_to_lock);
+	if (lock.owns_lock() && m_types.size() > 1) {
+		searchPool().parallelFor(m_types.size(), job);
+	} else {
+		for (size_t t = 0; t < m_types.size(); ++t) {
+			job(t);
 		}
 	}
-	m_types = move(newTypes);
 
-	vector<TypedSearchResult> results2;
-	for (const auto& result : results) {
-		results2.emplace_back(SearchResult{ result.first, 1, 1, 0 }, result.second);
+	CandidateSet results;
+	vector<DataType> newTypes;
+	for (size_t t = 0; t < m_types.size(); ++t) {
+		for (size_t address : found[t]) {
+			results.insert(address, forms[t]);
+		}
+		if (found[t].size()) {
+			newTypes.emplace_back(m_types[t]);
+		}
 	}
+	m_types = move(newTypes);
 
-	intersectCurrent(move(results2));
+	intersectCurrent(move(results));
 }
 
 vector<SearchResult> Search::results() const {
 	vector<SearchResult> results;
-	for (const auto& iter : m_current) {
-		if (results.size() && results.back() == iter) {
-			continue;
+	m_current.forEach(m_formRank, [&](const CandidateSet::Candidate& candidate) {
+		const Form& form = m_forms[candidate.second];
+		SearchResult result{ candidate.first, form.mult, form.div, form.bias };
+		if (!results.size() || results.back() != result) {
+			results.emplace_back(result);
 		}
-		results.emplace_back(iter);
-	}
+		return true;
+	});
+
+	return results;
+}
 
+vector<TypedSearchResult> Search::typedResults() const {
+	vector<TypedSearchResult> results;
+	results.reserve(m_current.size());
+	m_current.forEach(m_formRank, [&](const CandidateSet::Candidate& candidate) {
+		results.emplace_back(makeResult(candidate));
+		return true;
+	});
 	return results;
 }
 
-const vector<TypedSearchResult>& Search::typedResults() const {
-	return m_current;
+TypedSearchResult Search::typedResult(size_t index) const {
+	CandidateSet::Candidate candidate;
+	if (!m_current.at(index, m_formRank, &candidate)) {
+		throw out_of_range("Search result out of range");
+	}
+	return makeResult(candidate);
 }
 
 vector<DataType> Search::validTypes() const {
@@ -245,19 +403,22 @@ vector<DataType> Search::validTypes() const {
 }
 
 void Search::stuff(const vector<TypedSearchResult>& fakeResults) {
-	m_current = vector<TypedSearchResult>(fakeResults.begin(), fakeResults.end());
+	m_current.clear();
+	for (const auto& result : fakeResults) {
+		m_current.insert(result.address, internForm(result, internType(result.type)));
+	}
 	m_hasStarted = true;
 }
 
 void Search::remove(const vector<TypedSearchResult>& removedResults) {
-	vector<TypedSearchResult> out;
-	unordered_set<TypedSearchResult, hash<TypedSearchResult>> results{ removedResults.begin(), removedResults.end() };
-	for (const auto& result : m_current) {
-		if (results.find(result) == results.end()) {
-			out.emplace_back(result);
+	CandidateSet removed;
+	for (const auto& result : removedResults) {
+		uint32_t form;
+		if (findForm(result, &form)) {
+			removed.insert(result.address, form);
 		}
 	}
-	m_current = move(out);
+	m_current.difference(removed);
 }
 
 size_t Search::numResults() const {
@@ -265,36 +426,24 @@ size_t Search::numResults() const {
 }
 
 bool Search::hasUniqueResult() const {
-	if (!m_current.size()) {
+	if (m_current.empty()) {
 		return false;
 	}
-	const TypedSearchResult& result = m_current.front();
-	for (const auto& iter : m_current) {
+	const TypedSearchResult result = uniqueResult();
+	bool unique = true;
+	m_current.forEach(m_formRank, [&](const CandidateSet::Candidate& candidate) {
+		const TypedSearchResult iter = makeResult(candidate);
 		if (result == iter || static_cast<const SearchResult&>(result) == iter) {
-			continue;
-		}
-		if (result.address + result.type.width - 1 != iter.address + iter.type.width - 1) {
-			return false;
+			return true;
 		}
-	}
-	return true;
+		unique = result.address + result.type.width - 1 == iter.address + iter.type.width - 1;
+		return unique;
+	});
+	return unique;
 }
 
 TypedSearchResult Search::uniqueResult() const {
-	return m_current.front();
-}
-
-Search& Search::operator=(const Search& other) {
-	m_current.clear();
-	for (const auto& iter : other.m_current) {
-		m_current.emplace_back(iter);
-	}
-	m_types.clear();
-	for (const auto& iter : other.m_types) {
-		m_types.emplace_back(iter);
-	}
-	m_hasStarted = other.m_hasStarted;
-	return *this;
+	return typedResult(0);
 }
 
 vector<SearchResult> Search::makeResults(vector<size_t> addrs, uint64_t mult, uint64_t div, int64_t bias) {
@@ -358,28 +507,56 @@ vector<size_t> Search::searchValue(const AddressSpace& mem, int64_t value) {
 	return results;
 }
 
+static void scanByte(const uint8_t* data, size_t size, uint8_t value, size_t base, vector<size_t>& results) {
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i needle = _mm_set1_epi8(value);
+	for (; i + 16 <= size; i += 16) {
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i])), needle));
+		while (mask) {
+			results.push_back(base + i + __builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	const uint8x16_t needle = vdupq_n_u8(value);
+	for (; i + 16 <= size; i += 16) {
+		if (!vmaxvq_u8(vceqq_u8(vld1q_u8(&data[i]), needle))) {
+			continue;
+		}
+		for (size_t j = i; j < i + 16; ++j) {
+			if (data[j] == value) {
+				results.push_back(base + j);
+			}
+		}
+	}
+#endif
+	for (; i < size; ++i) {
+		if (data[i] == value) {
+			results.push_back(base + i);
+		}
+	}
+}
+
 vector<size_t> Search::searchByte(const AddressSpace& mem, uint8_t value, const vector<size_t> addresses, ssize_t offset) {
 	vector<size_t> results;
 	if (addresses.size()) {
 		for (const auto& i : addresses) {
 			if (offset < 0 && i < -offset) {
 				continue;
-			} else if (!mem.hasBlock(i) || !mem.hasBlock(i + offset)) {
-				continue;
 			}
-			if (mem[i + offset] == value) {
+			// Candidates come from this address space, so only the neighbor
+			// can be unmapped
+			uint8_t byte;
+			if (mem.peek(i + offset, &byte) && byte == value) {
 				results.push_back(i + offset);
 			}
 		}
 	} else {
+		size_t start = offset > 0 ? offset : 0;
 		for (const auto& block : mem.blocks()) {
-			if (offset < 0) {
-				offset = 0;
-			}
-			for (ssize_t i = offset; i < block.second.size(); ++i) {
-				if (block.second[i] == value) {
-					results.push_back(i + block.first);
-				}
+			if (start < block.second.size()) {
+				scanByte(static_cast<const uint8_t*>(block.second.offset(start)), block.second.size() - start, value, block.first + start, results);
 			}
 		}
 	}
@@ -407,11 +584,16 @@ vector<size_t> Search::overlap(const vector<size_t> start, vector<size_t> end, s
 
 void Search::reduceOnTypes(const AddressSpace& mem, const vector<SearchResult>& in, int64_t value) {
 	DataType bcd("=d8");
-	multimap<SearchResult, DataType> results;
+	CandidateSet results;
 	for (const auto& type : m_types) {
+		uint32_t typeId = internType(type);
 		auto result = in.cbegin();
 		for (const auto& block : mem.blocks()) {
 			const DynamicMemoryView dynmem(const_cast<void*>(block.second.offset(0)), block.second.size(), type, mem.overlay());
+			// Only the decoder and swizzle are used, which depend on the type
+			// and overlay but not the address
+			const CompiledVariable compiled = mem.compile(Variable{ type, block.first });
+			const uint8_t* data = static_cast<const uint8_t*>(block.second.offset(0));
 			for (; result != in.cend(); ++result) {
 				if (type.width + result->address - block.first > block.second.size()) {
 					break;
@@ -419,7 +601,13 @@ void Search::reduceOnTypes(const AddressSpace& mem, const vector<SearchResult>&
 				if (result->address < block.first) {
 					continue;
 				}
-				int64_t inmem = dynmem[result->address - block.first];
+				size_t offset = result->address - block.first;
+				int64_t inmem;
+				if (compiled.decode && ((offset + type.width - 1) | compiled.swizzle) < block.second.size()) {
+					inmem = compiled.decodeAt(data, offset);
+				} else {
+					inmem = dynmem[offset];
+				}
 				if (type.repr == Repr::BCD) {
 					if (!isBcd(result->mult) || !isBcd(result->div)) {
 						continue;
@@ -432,47 +620,203 @@ void Search::reduceOnTypes(const AddressSpace& mem, const vector<SearchResult>&
 				}
 				inmem -= result->bias;
 				if (value == inmem) {
-					results.emplace(*result, type);
+					results.insert(result->address, internForm(*result, typeId));
 				}
 			}
 		}
 	}
 
-	vector<TypedSearchResult> results2;
-	for (const auto& result : results) {
-		results2.emplace_back(result.first, result.second);
+	intersectCurrent(move(results));
+}
+
+void Search::intersectCurrent(CandidateSet&& results) {
+	if (m_hasStarted) {
+		m_current.intersect(results);
+	} else {
+		m_current = move(results);
+	}
+
+	m_hasStarted = true;
+}
+
+void CandidateSet::insert(size_t address, uint32_t form) {
+	size_t key = address / CHUNK_BITS;
+	// Candidates mostly arrive in address order, so try the last group first
+	auto group = m_chunks.end();
+	if (m_chunks.empty() || (--group)->first != key) {
+		group = m_chunks.emplace(key, Group()).first;
+	}
+	Group& chunks = group->second;
+	auto chunk = lower_bound(chunks.begin(), chunks.end(), form, [](const Chunk& c, uint32_t f) {
+		return c.form < f;
+	});
+	if (chunk == chunks.end() || chunk->form != form) {
+		chunk = chunks.insert(chunk, Chunk{ form, 0, {} });
+	}
+	uint64_t bit = 1ULL << (address % 64);
+	uint64_t& word = chunk->words[address % CHUNK_BITS / 64];
+	if (!(word & bit)) {
+		word |= bit;
+		++chunk->count;
+		++m_size;
 	}
+}
 
-	intersectCurrent(move(results2));
+bool CandidateSet::contains(size_t address, uint32_t form) const {
+	auto group = m_chunks.find(address / CHUNK_BITS);
+	if (group == m_chunks.end()) {
+		return false;
+	}
+	for (const auto& chunk : group->second) {
+		if (chunk.form == form) {
+			return (chunk.words[address % CHUNK_BITS / 64] >> (address % 64)) & 1;
+		}
+	}
+	return false;
 }
 
-void Search::intersectCurrent(vector<TypedSearchResult>&& results) {
-	if (m_hasStarted) {
-		vector<TypedSearchResult> out;
-		auto oldResults = m_current.begin();
-		for (const auto& result : results) {
-			if (oldResults == m_current.end()) {
-				break;
+void CandidateSet::intersect(const CandidateSet& other) {
+	m_size = 0;
+	auto theirs = other.m_chunks.cbegin();
+	for (auto group = m_chunks.begin(); group != m_chunks.end();) {
+		while (theirs != other.m_chunks.cend() && theirs->first < group->first) {
+			++theirs;
+		}
+		if (theirs == other.m_chunks.cend() || theirs->first != group->first) {
+			group = m_chunks.erase(group);
+			continue;
+		}
+		Group& chunks = group->second;
+		auto match = theirs->second.cbegin();
+		size_t kept = 0;
+		for (auto& chunk : chunks) {
+			while (match != theirs->second.cend() && match->form < chunk.form) {
+				++match;
 			}
-			// Invariant: always stored ordered by address
-			while (oldResults != m_current.end() && static_cast<const SearchResult&>(*oldResults) < result) {
-				++oldResults;
+			if (match == theirs->second.cend() || match->form != chunk.form) {
+				continue;
 			}
-			auto thisAddress = oldResults;
-			while (thisAddress != m_current.end() && thisAddress->address == result.address) {
-				if (*thisAddress == result) {
-					out.emplace_back(result);
-					break;
+			for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+				chunk.words[w] &= match->words[w];
+			}
+			if (recount(&chunk)) {
+				m_size += chunk.count;
+				chunks[kept] = chunk;
+				++kept;
+			}
+		}
+		chunks.erase(chunks.begin() + kept, chunks.end());
+		if (kept) {
+			++group;
+		} else {
+			group = m_chunks.erase(group);
+		}
+	}
+}
+
+void CandidateSet::difference(const CandidateSet& other) {
+	auto theirs = other.m_chunks.cbegin();
+	for (auto group = m_chunks.begin(); group != m_chunks.end();) {
+		while (theirs != other.m_chunks.cend() && theirs->first < group->first) {
+			++theirs;
+		}
+		if (theirs == other.m_chunks.cend() || theirs->first != group->first) {
+			++group;
+			continue;
+		}
+		Group& chunks = group->second;
+		auto match = theirs->second.cbegin();
+		size_t kept = 0;
+		for (auto& chunk : chunks) {
+			while (match != theirs->second.cend() && match->form < chunk.form) {
+				++match;
+			}
+			if (match != theirs->second.cend() && match->form == chunk.form) {
+				m_size -= chunk.count;
+				for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+					chunk.words[w] &= ~match->words[w];
 				}
-				++thisAddress;
+				m_size += recount(&chunk);
+			}
+			if (chunk.count) {
+				chunks[kept] = chunk;
+				++kept;
 			}
 		}
-		m_current = move(out);
-	} else {
-		m_current = move(results);
+		chunks.erase(chunks.begin() + kept, chunks.end());
+		if (kept) {
+			++group;
+		} else {
+			group = m_chunks.erase(group);
+		}
 	}
+}
 
-	m_hasStarted = true;
+void CandidateSet::clear() {
+	m_chunks.clear();
+	m_size = 0;
+}
+
+bool CandidateSet::at(size_t index, const vector<uint32_t>& rank, Candidate* candidate) const {
+	vector<const Chunk*> order;
+	// Whole groups and words are skipped by their counts
+	for (const auto& group : m_chunks) {
+		size_t total = 0;
+		for (const auto& chunk : group.second) {
+			total += chunk.count;
+		}
+		if (index >= total) {
+			index -= total;
+			continue;
+		}
+		orderGroup(group.second, rank, &order);
+		for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+			uint64_t any = 0;
+			size_t count = 0;
+			for (const Chunk* chunk : order) {
+				any |= chunk->words[w];
+				count += __builtin_popcountll(chunk->words[w]);
+			}
+			if (index >= count) {
+				index -= count;
+				continue;
+			}
+			while (any) {
+				unsigned bit = __builtin_ctzll(any);
+				any &= any - 1;
+				for (const Chunk* chunk : order) {
+					if (!((chunk->words[w] >> bit) & 1)) {
+						continue;
+					}
+					if (!index) {
+						*candidate = Candidate{ group.first * CHUNK_BITS + w * 64 + bit, chunk->form };
+						return true;
+					}
+					--index;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void CandidateSet::orderGroup(const Group& group, const vector<uint32_t>& rank, vector<const Chunk*>* order) {
+	order->clear();
+	for (const auto& chunk : group) {
+		order->push_back(&chunk);
+	}
+	sort(order->begin(), order->end(), [&rank](const Chunk* a, const Chunk* b) {
+		return rank[a->form] < rank[b->form];
+	});
+}
+
+size_t CandidateSet::recount(Chunk* chunk) {
+	size_t count = 0;
+	for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+		count += __builtin_popcountll(chunk->words[w]);
+	}
+	chunk->count = count;
+	return count;
 }
 
 // From CityHash
@@ -3,6 +3,8 @@
 #include "memory.h"
 #include "utils.h"
 
+#include <map>
+#include <tuple>
 #include <vector>
 
 namespace Retro {
@@ -29,6 +31,90 @@ struct TypedSearchResult : public SearchResult {
 	operator Variable() const;
 };
 
+// A set of (address, form) pairs, stored as one bitmap per form for each
+// fixed-size chunk of the address space that holds any candidates. Set
+// operations and counting run a word at a time and empty chunks are
+// dropped, so sparse results spread over distant blocks stay small.
+class CandidateSet {
+public:
+	typedef std::pair<size_t, uint32_t> Candidate;
+
+	void insert(size_t address, uint32_t form);
+	bool contains(size_t address, uint32_t form) const;
+	void intersect(const CandidateSet&);
+	void difference(const CandidateSet&);
+	void clear();
+
+	size_t size() const { return m_size; }
+	bool empty() const { return !m_size; }
+
+	// Candidates are visited by address and then by ascending rank[form],
+	// until fn returns false
+	template<typename F>
+	void forEach(const std::vector<uint32_t>& rank, F fn) const;
+	template<typename F>
+	void forEachAddress(uint32_t form, F fn) const;
+	bool at(size_t index, const std::vector<uint32_t>& rank, Candidate*) const;
+
+private:
+	static constexpr size_t CHUNK_BITS = 1024;
+	struct Chunk {
+		uint32_t form;
+		uint32_t count;
+		uint64_t words[CHUNK_BITS / 64];
+	};
+	typedef std::vector<Chunk> Group;
+
+	static void orderGroup(const Group&, const std::vector<uint32_t>& rank, std::vector<const Chunk*>* order);
+	static size_t recount(Chunk*);
+
+	// Groups are keyed by chunk index and sorted by form id
+	std::map<size_t, Group> m_chunks;
+	size_t m_size = 0;
+};
+
+template<typename F>
+void CandidateSet::forEach(const std::vector<uint32_t>& rank, F fn) const {
+	std::vector<const Chunk*> order;
+	for (const auto& group : m_chunks) {
+		orderGroup(group.second, rank, &order);
+		for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+			uint64_t any = 0;
+			for (const Chunk* chunk : order) {
+				any |= chunk->words[w];
+			}
+			while (any) {
+				unsigned bit = __builtin_ctzll(any);
+				any &= any - 1;
+				size_t address = group.first * CHUNK_BITS + w * 64 + bit;
+				for (const Chunk* chunk : order) {
+					if ((chunk->words[w] >> bit) & 1 && !fn(Candidate{ address, chunk->form })) {
+						return;
+					}
+				}
+			}
+		}
+	}
+}
+
+template<typename F>
+void CandidateSet::forEachAddress(uint32_t form, F fn) const {
+	for (const auto& group : m_chunks) {
+		for (const auto& chunk : group.second) {
+			if (chunk.form != form) {
+				continue;
+			}
+			for (size_t w = 0; w < CHUNK_BITS / 64; ++w) {
+				uint64_t word = chunk.words[w];
+				while (word) {
+					fn(group.first * CHUNK_BITS + w * 64 + __builtin_ctzll(word));
+					word &= word - 1;
+				}
+			}
+		}
+	}
+}
+
 class Search {
 public:
 	Search();
@@ -37,7 +123,8 @@ public:
 	void delta(const AddressSpace& mem, const AddressSpace& oldMem, Operation op, int64_t reference);
 
 	std::vector<SearchResult> results() const;
-	const std::vector<TypedSearchResult>& typedResults() const;
+	std::vector<TypedSearchResult> typedResults() const;
+	TypedSearchResult typedResult(size_t index) const;
 	std::vector<DataType> validTypes() const;
 
 	void stuff(const std::vector<TypedSearchResult>&);
@@ -48,19 +135,37 @@ public:
 	bool hasUniqueResult() const;
 	TypedSearchResult uniqueResult() const;
 
-	Search& operator=(const Search&);
-
 private:
+	// Candidates refer to a shared table of every distinct type and scale
+	// seen. Ties at one address are ordered by scale and then type, with
+	// type ids following the initial type order.
+	struct Form {
+		uint32_t type;
+		uint64_t mult;
+		uint64_t div;
+		int64_t bias;
+	};
+
+	uint32_t internType(const DataType&);
+	uint32_t internForm(const SearchResult&, uint32_t type);
+	bool findForm(const TypedSearchResult&, uint32_t* form) const;
+	TypedSearchResult makeResult(const CandidateSet::Candidate&) const;
+
 	std::vector<SearchResult> makeResults(std::vector<size_t> addrs, uint64_t mult = 1, uint64_t div = 1, int64_t bias = 0);
 	std::vector<size_t> searchValue(const AddressSpace& mem, int64_t value);
 	std::vector<size_t> searchByte(const AddressSpace& mem, uint8_t value, const std::vector<size_t> addresses = {}, ssize_t offset = 0);
 	std::vector<size_t> overlap(const std::vector<size_t> start, std::vector<size_t> end, size_t width);
 	void reduceOnTypes(const AddressSpace& mem, const std::vector<SearchResult>&, int64_t value);
+	std::vector<size_t> deltaType(const AddressSpace& mem, const AddressSpace& oldMem, uint32_t form, Operation, int64_t reference) const;
+
+	void intersectCurrent(CandidateSet&&);
 
-	void intersectCurrent(std::vector<TypedSearchResult>&&);
-	void differenceCurrent(const std::vector<TypedSearchResult>&);
+	std::vector<DataType> m_typeTable;
+	std::vector<Form> m_forms;
+	std::vector<uint32_t> m_formRank;
+	std::map<std::tuple<uint32_t, uint64_t, uint64_t, int64_t>, uint32_t> m_formIndex;
+	CandidateSet m_current;
 
-	std::vector<TypedSearchResult> m_current;
 	std::vector<DataType> m_types;
 	bool m_hasStarted = false;
 };
@@ -0,0 +1,162 @@
+#include "snapshot.h"
+
+#include <cstring>
+
+using namespace Retro;
+using namespace std;
+
+static const uint32_t NO_PAGE = UINT32_MAX;
+
+SnapshotPool::SnapshotPool(size_t pageSize, size_t pagesPerSlab)
+	: m_pageSize(pageSize ? pageSize : 4096)
+	, m_pagesPerSlab(pagesPerSlab ? pagesPerSlab : 1) {
+	m_scratch.resize(m_pageSize);
+}
+
+void SnapshotPool::reserve(size_t pages) {
+	while (m_refs.size() < pages) {
+		size_t first = m_refs.size();
+		m_slabs.emplace_back(new uint8_t[m_pageSize * m_pagesPerSlab]);
+		m_refs.resize(first + m_pagesPerSlab, 0);
+		m_hashes.resize(first + m_pagesPerSlab, 0);
+		for (size_t i = first + m_pagesPerSlab; i > first; --i) {
+			m_freePages.push_back(i - 1);
+		}
+	}
+}
+
+uint8_t* SnapshotPool::page(uint32_t id) {
+	return &m_slabs[id / m_pagesPerSlab][(id % m_pagesPerSlab) * m_pageSize];
+}
+
+const uint8_t* SnapshotPool::page(uint32_t id) const {
+	return &m_slabs[id / m_pagesPerSlab][(id % m_pagesPerSlab) * m_pageSize];
+}
+
+uint64_t SnapshotPool::hash(const uint8_t* data) const {
+	uint64_t h = 0x9E3779B97F4A7C15ULL;
+	size_t i = 0;
+	for (; i + 8 <= m_pageSize; i += 8) {
+		uint64_t word;
+		memcpy(&word, &data[i], sizeof(word));
+		h = (h ^ word) * 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 32;
+	}
+	for (; i < m_pageSize; ++i) {
+		h = (h ^ data[i]) * 0x100000001B3ULL;
+	}
+	return h;
+}
+
+uint32_t SnapshotPool::allocPage() {
+	if (m_freePages.empty()) {
+		reserve(m_refs.size() + 1);
+	}
+	uint32_t id = m_freePages.back();
+	m_freePages.pop_back();
+	return id;
+}
+
+uint32_t SnapshotPool::intern(const uint8_t* data, uint32_t sibling) {
+	// Consecutive snapshots usually share most pages at the same offsets, so
+	// try that before hashing
+	if (sibling != NO_PAGE && !memcmp(page(sibling), data, m_pageSize)) {
+		++m_refs[sibling];
+		return sibling;
+	}
+	uint64_t h = hash(data);
+	auto existing = m_index.find(h);
+	if (existing != m_index.end() && !memcmp(page(existing->second), data, m_pageSize)) {
+		++m_refs[existing->second];
+		return existing->second;
+	}
+	uint32_t id = allocPage();
+	memcpy(page(id), data, m_pageSize);
+	m_refs[id] = 1;
+	m_hashes[id] = h;
+	if (existing == m_index.end()) {
+		m_index.emplace(h, id);
+	}
+	return id;
+}
+
+void SnapshotPool::unref(uint32_t id) {
+	if (--m_refs[id]) {
+		return;
+	}
+	auto indexed = m_index.find(m_hashes[id]);
+	if (indexed != m_index.end() && indexed->second == id) {
+		m_index.erase(indexed);
+	}
+	m_freePages.push_back(id);
+}
+
+SnapshotPool::Handle SnapshotPool::save(const void* data, size_t size) {
+	Handle handle;
+	if (m_freeSnapshots.empty()) {
+		handle = m_snapshots.size();
+		m_snapshots.emplace_back();
+	} else {
+		handle = m_freeSnapshots.back();
+		m_freeSnapshots.pop_back();
+	}
+	const Snapshot* sibling = valid(m_last) ? &m_snapshots[m_last] : nullptr;
+	Snapshot& snapshot = m_snapshots[handle];
+	snapshot.size = size;
+	snapshot.live = true;
+	snapshot.pages.clear();
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t offset = 0, i = 0; offset < size; offset += m_pageSize, ++i) {
+		const uint8_t* chunk = &bytes[offset];
+		if (size - offset < m_pageSize) {
+			memcpy(m_scratch.data(), chunk, size - offset);
+			memset(&m_scratch[size - offset], 0, m_pageSize - (size - offset));
+			chunk = m_scratch.data();
+		}
+		uint32_t near = sibling && i < sibling->pages.size() ? sibling->pages[i] : NO_PAGE;
+		snapshot.pages.push_back(intern(chunk, near));
+	}
+	m_last = handle;
+	return handle;
+}
+
+bool SnapshotPool::load(Handle handle, void* data, size_t size) {
+	if (!valid(handle) || m_snapshots[handle].size != size) {
+		return false;
+	}
+	const Snapshot& snapshot = m_snapshots[handle];
+	uint8_t* bytes = static_cast<uint8_t*>(data);
+	for (size_t i = 0; i < snapshot.pages.size(); ++i) {
+		size_t offset = i * m_pageSize;
+		size_t length = size - offset < m_pageSize ? size - offset : m_pageSize;
+		memcpy(&bytes[offset], page(snapshot.pages[i]), length);
+	}
+	m_last = handle;
+	return true;
+}
+
+void SnapshotPool::release(Handle handle) {
+	if (!valid(handle)) {
+		return;
+	}
+	Snapshot& snapshot = m_snapshots[handle];
+	for (uint32_t id : snapshot.pages) {
+		unref(id);
+	}
+	snapshot.pages.clear();
+	snapshot.size = 0;
+	snapshot.live = false;
+	m_freeSnapshots.push_back(handle);
+	if (m_last == handle) {
+		m_last = NO_PAGE;
+	}
+}
+
+bool SnapshotPool::valid(Handle handle) const {
+	return handle < m_snapshots.size() && m_snapshots[handle].live;
+}
+
+size_t SnapshotPool::size(Handle handle) const {
+	return valid(handle) ? m_snapshots[handle].size : 0;
+}
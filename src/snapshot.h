@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Retro {
+
+// Stores savestates as lists of fixed-size pages carved out of large slabs.
+// Pages are reference counted and shared between snapshots whose contents
+// match, so a tree of states that differ in a few bytes costs little more
+// than one full state plus the changed pages.
+class SnapshotPool {
+public:
+	typedef uint32_t Handle;
+
+	SnapshotPool(size_t pageSize = 4096, size_t pagesPerSlab = 256);
+	SnapshotPool(const SnapshotPool&) = delete;
+
+	// Makes room for at least this many pages up front
+	void reserve(size_t pages);
+
+	Handle save(const void* data, size_t size);
+	bool load(Handle, void* data, size_t size);
+	void release(Handle);
+
+	bool valid(Handle) const;
+	size_t size(Handle) const;
+
+	size_t snapshots() const { return m_snapshots.size() - m_freeSnapshots.size(); }
+	size_t pagesUsed() const { return m_refs.size() - m_freePages.size(); }
+	size_t pageSize() const { return m_pageSize; }
+	size_t bytesReserved() const { return m_slabs.size() * m_pagesPerSlab * m_pageSize; }
+
+private:
+	struct Snapshot {
+		size_t size = 0;
+		bool live = false;
+		std::vector<uint32_t> pages;
+	};
+
+	uint8_t* page(uint32_t);
+	const uint8_t* page(uint32_t) const;
+	uint32_t intern(const uint8_t* data, uint32_t sibling);
+	uint32_t allocPage();
+	void unref(uint32_t);
+	uint64_t hash(const uint8_t* data) const;
+
+	size_t m_pageSize;
+	size_t m_pagesPerSlab;
+	std::vector<std::unique_ptr<uint8_t[]>> m_slabs;
+	std::vector<uint32_t> m_refs;
+	std::vector<uint64_t> m_hashes;
+	std::vector<uint32_t> m_freePages;
+	std::unordered_map<uint64_t, uint32_t> m_index;
+	std::vector<uint8_t> m_scratch;
+
+	std::vector<Snapshot> m_snapshots;
+	std::vector<Handle> m_freeSnapshots;
+
+	// Most recently saved or loaded snapshot, compared against first
+	Handle m_last = UINT32_MAX;
+};
+}
@@ -0,0 +1,121 @@
+#include "statedelta.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace Retro {
+
+static const char DELTA_MAGIC[4] = { 'R', 'D', 'L', '1' };
+
+// Unchanged spans shorter than this stay inside a run; splitting them would
+// cost more in headers than it saves
+static const size_t MIN_GAP = 8;
+
+static void putVarint(vector<uint8_t>* out, uint64_t value) {
+	while (value >= 0x80) {
+		out->push_back(value | 0x80);
+		value >>= 7;
+	}
+	out->push_back(value);
+}
+
+static bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t* value) {
+	*value = 0;
+	for (unsigned shift = 0; in < end && shift < 64; shift += 7) {
+		uint8_t byte = *in++;
+		*value |= uint64_t(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void encodeStateDelta(const void* basePtr, size_t baseSize, const void* statePtr, size_t size, vector<uint8_t>* delta) {
+	const uint8_t* base = static_cast<const uint8_t*>(basePtr);
+	const uint8_t* state = static_cast<const uint8_t*>(statePtr);
+	auto baseAt = [&](size_t i) -> uint8_t { return i < baseSize ? base[i] : 0; };
+	size_t overlap = min(size, baseSize);
+
+	delta->assign(DELTA_MAGIC, DELTA_MAGIC + sizeof(DELTA_MAGIC));
+	putVarint(delta, size);
+	putVarint(delta, baseSize);
+
+	size_t i = 0;
+	while (i < size) {
+		size_t start = i;
+		while (i + 8 <= overlap && !memcmp(&state[i], &base[i], 8)) {
+			i += 8;
+		}
+		// Bytes past the end of base are always stored, so a decoder can bound
+		// the state size by the length of the delta
+		while (i < overlap && state[i] == base[i]) {
+			++i;
+		}
+		if (i == size) {
+			break;
+		}
+
+		size_t runStart = i;
+		size_t runEnd = i;
+		while (i < size && i - runEnd < MIN_GAP) {
+			if (i >= baseSize || state[i] != base[i]) {
+				runEnd = i + 1;
+			}
+			++i;
+		}
+		i = runEnd;
+
+		putVarint(delta, runStart - start);
+		putVarint(delta, runEnd - runStart);
+		for (size_t j = runStart; j < runEnd; ++j) {
+			delta->push_back(state[j] ^ baseAt(j));
+		}
+	}
+}
+
+bool applyStateDelta(const void* basePtr, size_t baseSize, const void* deltaPtr, size_t deltaSize, vector<uint8_t>* state) {
+	const uint8_t* base = static_cast<const uint8_t*>(basePtr);
+	const uint8_t* in = static_cast<const uint8_t*>(deltaPtr);
+	const uint8_t* end = in + deltaSize;
+	if (deltaSize < sizeof(DELTA_MAGIC) || memcmp(in, DELTA_MAGIC, sizeof(DELTA_MAGIC))) {
+		return false;
+	}
+	in += sizeof(DELTA_MAGIC);
+	uint64_t size;
+	uint64_t encodedBaseSize;
+	if (!getVarint(in, end, &size) || !getVarint(in, end, &encodedBaseSize) || encodedBaseSize != baseSize) {
+		return false;
+	}
+	if (size > baseSize && size - baseSize > uint64_t(end - in)) {
+		return false;
+	}
+
+	state->resize(size);
+	uint8_t* out = state->data();
+	size_t overlap = min<size_t>(size, baseSize);
+	memcpy(out, base, overlap);
+	memset(&out[overlap], 0, size - overlap);
+
+	uint64_t offset = 0;
+	while (in < end) {
+		uint64_t skip;
+		uint64_t length;
+		if (!getVarint(in, end, &skip) || !getVarint(in, end, &length)) {
+			return false;
+		}
+		if (skip > size - offset || length > size - offset - skip || length > uint64_t(end - in)) {
+			return false;
+		}
+		offset += skip;
+		for (uint64_t j = 0; j < length; ++j) {
+			out[offset + j] ^= in[j];
+		}
+		offset += length;
+		in += length;
+	}
+	return true;
+}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace Retro {
+
+// Encodes state as the XOR against base, keeping only the runs that differ.
+// Each run is stored as a varint count of unchanged bytes, a varint length
+// and the XORed bytes. base and state may differ in size; any bytes past the
+// end of base are always stored.
+void encodeStateDelta(const void* base, size_t baseSize, const void* state, size_t size, std::vector<uint8_t>* delta);
+
+// Rebuilds a state from the base it was encoded against. Returns false if
+// the delta is malformed or was made against a base of a different size.
+bool applyStateDelta(const void* base, size_t baseSize, const void* delta, size_t deltaSize, std::vector<uint8_t>* state);
+}
@@ -0,0 +1,99 @@
+#include "threadpool.h"
+
+using namespace Retro;
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threads) {
+	if (!threads) {
+		threads = thread::hardware_concurrency();
+	}
+	for (unsigned i = 1; i < threads; ++i) {
+		m_workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_start.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(size_t n, const function<void(size_t)>& job) {
+	if (m_workers.empty() || n < 2) {
+		for (size_t i = 0; i < n; ++i) {
+			job(i);
+		}
+		return;
+	}
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_job = &job;
+		m_size = n;
+		m_next = 0;
+		m_done = 0;
+		++m_generation;
+	}
+	m_start.notify_all();
+	drain();
+
+	unique_lock<mutex> lock(m_mutex);
+	m_finish.wait(lock, [this]() { return m_done == m_size; });
+	m_job = nullptr;
+	if (m_error) {
+		exception_ptr error = m_error;
+		m_error = nullptr;
+		rethrow_exception(error);
+	}
+}
+
+void ThreadPool::work() {
+	uint64_t generation = 0;
+	while (true) {
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_start.wait(lock, [this, generation]() { return m_exit || m_generation != generation; });
+			if (m_exit) {
+				return;
+			}
+			generation = m_generation;
+		}
+		drain();
+	}
+}
+
+void ThreadPool::drain() {
+	while (true) {
+		size_t i;
+		const function<void(size_t)>* job;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (!m_job || m_next >= m_size) {
+				return;
+			}
+			i = m_next++;
+			job = m_job;
+		}
+		exception_ptr error;
+		try {
+			(*job)(i);
+		} catch (...) {
+			error = current_exception();
+		}
+		bool last;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (error && !m_error) {
+				m_error = error;
+			}
+			last = ++m_done == m_size;
+		}
+		if (last) {
+			m_finish.notify_all();
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Retro {
+
+class ThreadPool {
+public:
+	ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned size() const { return m_workers.size() + 1; }
+
+	// Calls job(i) for every i in [0, n) and returns once all calls finish.
+	// The calling thread takes part in the work. The first exception thrown
+	// by a job is rethrown here after the remaining jobs complete.
+	void parallelFor(size_t n, const std::function<void(size_t)>& job);
+
+private:
+	void work();
+	void drain();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_finish;
+
+	const std::function<void(size_t)>* m_job = nullptr;
+	size_t m_size = 0;
+	size_t m_next = 0;
+	size_t m_done = 0;
+	uint64_t m_generation = 0;
+	bool m_exit = false;
+	std::exception_ptr m_error;
+};
+}
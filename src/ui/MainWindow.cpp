@@ -493,7 +493,7 @@ void MainWindow::performSearch() {
 
 	const Retro::Search* search = m_searchModel.getDataBacking()->getSearch(name);
 	if (search->hasUniqueResult()) {
-		m_searchModel.getDataBacking()->setVariable(name, search->typedResults()[0]);
+		m_searchModel.getDataBacking()->setVariable(name, search->typedResult(0));
 		m_controller->variablesUpdated();
 		if (m_ui->searchName->text() == m_searchResultsModel.getVariable()) {
 			m_searchResultsModel.setVariable(QString());
@@ -541,7 +541,7 @@ void MainWindow::migrateSearch() {
 	}
 	Retro::GameData* data = m_searchResultsModel.getDataBacking();
 	Retro::Search* search = data->getSearch(m_searchResultsModel.getVariable().toStdString());
-	Retro::TypedSearchResult result = search->typedResults()[indices[0].row()];
+	Retro::TypedSearchResult result = search->typedResult(indices[0].row());
 	data->setVariable(m_searchResultsModel.getVariable().toStdString(), result);
 	m_controller->variablesUpdated();
 	m_dataModel.refresh();
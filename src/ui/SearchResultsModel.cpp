@@ -5,7 +5,7 @@
 using namespace Retro;
 
 int SearchResultsModel::rowCount(const QModelIndex&) const {
-	return m_results ? m_results->size() : 0;
+	return m_numResults;
 }
 
 int SearchResultsModel::columnCount(const QModelIndex&) const {
@@ -53,11 +53,11 @@ QVariant SearchResultsModel::data(const QModelIndex& index, int role) const {
 
 	switch (index.column()) {
 	case 0:
-		return static_cast<qint64>(m_data->lookupValue((*m_results)[index.row()]));
+		return static_cast<qint64>(m_data->lookupValue(m_search->typedResult(index.row())));
 	case 1:
-		return QString::number((*m_results)[index.row()].address, 16);
+		return QString::number(m_search->typedResult(index.row()).address, 16);
 	case 2:
-		return (*m_results)[index.row()].type.type;
+		return m_search->typedResult(index.row()).type.type;
 	}
 	return QVariant();
 }
@@ -69,7 +69,7 @@ bool SearchResultsModel::setData(const QModelIndex& index, const QVariant& value
 
 	switch (index.column()) {
 	case 0:
-		m_data->lookupValue((*m_results)[index.row()]) = value.toLongLong();
+		m_data->lookupValue(m_search->typedResult(index.row())) = value.toLongLong();
 		return true;
 	}
 	return false;
@@ -105,8 +105,8 @@ void SearchResultsModel::refresh() {
 }
 
 void SearchResultsModel::refreshImpl() {
-	m_results = nullptr;
+	m_numResults = 0;
 	if (m_data && m_search) {
-		m_results = &m_search->typedResults();
+		m_numResults = m_search->numResults();
 	}
 }
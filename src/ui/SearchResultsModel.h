@@ -31,6 +31,6 @@ private:
 	Retro::GameData* m_data = nullptr;
 
 	Retro::Search* m_search = nullptr;
-	const std::vector<Retro::TypedSearchResult>* m_results = nullptr;
+	size_t m_numResults = 0;
 	QString m_variable;
 };
@@ -40,6 +40,20 @@ int64_t calculate(Operation op, int64_t reference, int64_t value) {
 	return 0;
 }
 
+void putLE(uint8_t* out, uint64_t value, size_t bytes) {
+	for (size_t i = 0; i < bytes; ++i) {
+		out[i] = value >> (i * 8);
+	}
+}
+
+uint64_t getLE(const uint8_t* in, size_t bytes) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < bytes; ++i) {
+		value |= uint64_t(in[i]) << (i * 8);
+	}
+	return value;
+}
+
 string drillUp(const vector<string>& targets, const string& fail, const string& hint) {
 	char rpath[PATH_MAX];
 	string path(".");
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -23,5 +25,9 @@ enum class Operation {
 
 int64_t calculate(Operation op, int64_t reference, int64_t value);
 
+// Little-endian integers of the given width in bytes, for binary file headers
+void putLE(uint8_t* out, uint64_t value, size_t bytes);
+uint64_t getLE(const uint8_t* in, size_t bytes);
+
 std::string drillUp(const std::vector<std::string>& targets, const std::string& fail = {}, const std::string& hint = ".");
 }
@@ -5,6 +5,12 @@
 using namespace Retro;
 using namespace std;
 
+constexpr int Zip::DEFAULT_COMPRESSION;
+constexpr int Zip::STORE;
+constexpr int Zip::BEST_SPEED;
+constexpr int Zip::BEST_COMPRESSION;
+constexpr size_t Zip::File::READ_AHEAD;
+
 Zip::Zip(const string& path)
 	: m_path(path) {
 }
@@ -18,16 +24,21 @@ bool Zip::open(bool readwrite) {
 	return m_zip;
 }
 
-void Zip::close() {
+bool Zip::close() {
 	if (!m_zip) {
-		return;
+		return true;
 	}
+	bool success = true;
 	for (auto& file : m_files) {
-		file->close();
+		success = file->close() && success;
+	}
+	if (zip_close(m_zip) < 0) {
+		zip_discard(m_zip);
+		success = false;
 	}
-	zip_close(m_zip);
 	m_zip = nullptr;
 	m_files.clear();
+	return success;
 }
 
 Zip::File* Zip::openFile(const std::string& name, bool write) {
@@ -42,49 +53,120 @@ Zip::File* Zip::openFile(const std::string& name, bool write) {
 		}
 		zf = new Zip::File(m_zip, name, file);
 	} else {
-		zf = new Zip::File(m_zip, name);
+		zf = new Zip::File(m_zip, name, nullptr, m_compression);
 	}
 	m_files.emplace_back(zf);
 	return zf;
 }
 
-Zip::File::File(zip_t* zip, const std::string& name, zip_file_t* file)
+Zip::File::File(zip_t* zip, const std::string& name, zip_file_t* file, int compression)
 	: m_zip(zip)
 	, m_file(file)
-	, m_name(name) {
+	, m_name(name)
+	, m_compression(compression) {
+}
+
+bool Zip::File::fill() {
+	if (!m_file) {
+		return false;
+	}
+	// Consumed data is only dropped when refilling, rather than erased
+	// from the front of the buffer one read at a time
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_bufferPos);
+	m_bufferPos = 0;
+	size_t size = m_buffer.size();
+	m_buffer.resize(size + READ_AHEAD);
+	zip_int64_t r = zip_fread(m_file, &m_buffer[size], READ_AHEAD);
+	m_buffer.resize(size + max<zip_int64_t>(r, 0));
+	return r > 0;
 }
 
 string Zip::File::readline() {
-	auto pos = m_buffer.end();
-	pos = find(m_buffer.begin(), m_buffer.end(), '\n');
+	string s;
+	readline(&s);
+	return s;
+}
+
+bool Zip::File::readline(string* line) {
+	size_t searched = m_bufferPos;
+	auto pos = find(m_buffer.begin() + searched, m_buffer.end(), '\n');
 	while (pos == m_buffer.end()) {
-		size_t size = m_buffer.size();
-		m_buffer.resize(size + 256);
-		size_t r = read(static_cast<void*>(&m_buffer[size]), 256);
-		if (!r) {
-			string s(m_buffer.begin(), m_buffer.end() - 256);
+		searched = m_buffer.size() - m_bufferPos;
+		if (!fill()) {
+			line->assign(m_buffer.begin() + m_bufferPos, m_buffer.end());
 			m_buffer.clear();
-			return s;
-		}
-		if (r < 256) {
-			m_buffer.erase(m_buffer.end() - 256 + r, m_buffer.end());
+			m_bufferPos = 0;
+			return !line->empty();
 		}
-		pos = find(m_buffer.begin(), m_buffer.end(), '\n');
+		pos = find(m_buffer.begin() + searched, m_buffer.end(), '\n');
 	}
-	if (pos != m_buffer.begin() && *(pos - 1) == '\r') {
+	auto end = pos;
+	if (end != m_buffer.begin() + m_bufferPos && *(end - 1) == '\r') {
 		// Strip out carriage returns
-		--pos;
-	}
-	string s(m_buffer.begin(), pos);
-	if (*pos == '\r') {
-		++pos;
+		--end;
 	}
-	m_buffer.erase(m_buffer.begin(), pos + 1);
-	return s;
+	line->assign(m_buffer.begin() + m_bufferPos, end);
+	m_bufferPos = pos - m_buffer.begin() + 1;
+	return true;
 }
 
 ssize_t Zip::File::read(void* buffer, size_t size) {
-	return zip_fread(m_file, buffer, size);
+	if (!m_file) {
+		return -1;
+	}
+	char* out = static_cast<char*>(buffer);
+	size_t buffered = min(size, m_buffer.size() - m_bufferPos);
+	copy_n(m_buffer.begin() + m_bufferPos, buffered, out);
+	m_bufferPos += buffered;
+	size_t done = buffered;
+	if (done < size && size - done >= READ_AHEAD) {
+		// Large reads go straight into the caller's memory
+		zip_int64_t r = zip_fread(m_file, out + done, size - done);
+		if (r < 0) {
+			return done ? done : -1;
+		}
+		return done + r;
+	}
+	while (done < size && (m_bufferPos < m_buffer.size() || fill())) {
+		size_t chunk = min(size - done, m_buffer.size() - m_bufferPos);
+		copy_n(m_buffer.begin() + m_bufferPos, chunk, out + done);
+		m_bufferPos += chunk;
+		done += chunk;
+	}
+	return done;
+}
+
+ssize_t Zip::File::size() const {
+	zip_stat_t stat;
+	zip_stat_init(&stat);
+	if (zip_stat(m_zip, m_name.c_str(), 0, &stat) < 0 || !(stat.valid & ZIP_STAT_SIZE)) {
+		return -1;
+	}
+	return stat.size;
+}
+
+bool Zip::File::readAll(vector<uint8_t>* data) {
+	if (!m_file) {
+		return false;
+	}
+	data->clear();
+	ssize_t expected = size();
+	// The directory might be wrong, so still read until the end of the file
+	size_t capacity = expected >= 0 ? expected + 1 : READ_AHEAD;
+	while (true) {
+		size_t used = data->size();
+		data->resize(capacity);
+		ssize_t r = read(&(*data)[used], capacity - used);
+		if (r < 0) {
+			data->clear();
+			return false;
+		}
+		data->resize(used + r);
+		if (used + r < capacity) {
+			return true;
+		}
+		capacity *= 2;
+	}
 }
 
 ssize_t Zip::File::write(const void* buffer, size_t size) {
@@ -92,17 +174,22 @@ ssize_t Zip::File::write(const void* buffer, size_t size) {
 	return size;
 }
 
-void Zip::File::close() {
+bool Zip::File::close() {
 	if (m_file) {
 		zip_fclose(m_file);
 	} else if (m_buffer.size()) {
 		zip_source_t* source = zip_source_buffer(m_zip, static_cast<void*>(&m_buffer.front()), m_buffer.size(), 0);
 		if (!source) {
-			return;
+			return false;
 		}
 		zip_int64_t i = zip_file_add(m_zip, m_name.c_str(), source, ZIP_FL_OVERWRITE);
 		if (i < 0) {
-			return;
+			zip_source_free(source);
+			return false;
+		}
+		if (m_compression >= 0 && zip_set_file_compression(m_zip, i, m_compression ? ZIP_CM_DEFLATE : ZIP_CM_STORE, min(m_compression, BEST_COMPRESSION)) < 0) {
+			return false;
 		}
 	}
+	return true;
 }
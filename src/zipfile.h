@@ -2,6 +2,7 @@
 
 #include "zip.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,37 +11,64 @@ namespace Retro {
 
 class Zip {
 public:
+	// Compression levels for written files
+	static constexpr int DEFAULT_COMPRESSION = -1;
+	static constexpr int STORE = 0;
+	static constexpr int BEST_SPEED = 1;
+	static constexpr int BEST_COMPRESSION = 9;
+
 	class File {
 	public:
-		File(zip_t*, const std::string& name, zip_file_t* = nullptr);
+		static constexpr size_t READ_AHEAD = 64 * 1024;
+
+		File(zip_t*, const std::string& name, zip_file_t* = nullptr, int compression = DEFAULT_COMPRESSION);
 		File(File&) = delete;
 
+		// Reads are served from a large read-ahead buffer, so small reads and
+		// lines don't each go through the decompressor
 		std::string readline();
+		bool readline(std::string* line);
 		ssize_t read(void* buffer, size_t size);
+
+		// Uncompressed size from the directory, or -1 if it isn't recorded
+		ssize_t size() const;
+		// Reads the rest of the file, allocating once when the size is known
+		bool readAll(std::vector<uint8_t>* data);
+
 		ssize_t write(const void* buffer, size_t size);
+		void setCompression(int level) { m_compression = level; }
 
 	private:
-		void close();
+		bool fill();
+		bool close();
 		friend class Zip;
 
 		zip_t* m_zip;
 		zip_file_t* m_file;
 		std::vector<char> m_buffer;
+		size_t m_bufferPos = 0;
 		std::string m_name;
+		int m_compression;
 	};
 
 	Zip(const std::string& path);
 	~Zip();
 
 	bool open(bool readwrite = false);
-	void close();
+	// False if any written file or the archive itself could not be saved
+	bool close();
 
 	File* openFile(const std::string& name, bool write = false);
 
+	// Level for files opened for writing from now on: STORE, a deflate
+	// level from BEST_SPEED to BEST_COMPRESSION, or DEFAULT_COMPRESSION
+	void setCompression(int level) { m_compression = level; }
+
 private:
 	std::string m_path;
 
 	zip_t* m_zip = nullptr;
 	std::vector<std::unique_ptr<File>> m_files;
+	int m_compression = DEFAULT_COMPRESSION;
 };
 }
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+
+#include "audio.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace Retro {
+
+static vector<int16_t> makeStereo(size_t frames, int16_t start = 0) {
+	vector<int16_t> samples(frames * 2);
+	for (size_t i = 0; i < frames; ++i) {
+		samples[i * 2] = start + i;
+		samples[i * 2 + 1] = -(start + int16_t(i));
+	}
+	return samples;
+}
+
+TEST(AudioBuffer, Stereo) {
+	AudioBuffer buffer;
+	buffer.configure(1000, 60, 0, 2, 16);
+	EXPECT_EQ(buffer.capacity(), 16);
+	EXPECT_EQ(buffer.rate(), 1000);
+
+	for (int span = 0; span < 5; ++span) {
+		vector<int16_t> samples = makeStereo(7, span * 7);
+		buffer.begin();
+		buffer.write(samples.data(), 4);
+		buffer.write(samples[8], samples[9]);
+		buffer.write(&samples[10], 2);
+		ASSERT_EQ(buffer.frames(), 7);
+		const int16_t* data = buffer.data();
+		for (size_t i = 0; i < samples.size(); ++i) {
+			EXPECT_EQ(data[i], samples[i]);
+		}
+	}
+}
+
+TEST(AudioBuffer, Overflow) {
+	AudioBuffer buffer;
+	buffer.configure(1000, 60, 0, 2, 16);
+	vector<int16_t> samples = makeStereo(40);
+	buffer.begin();
+	buffer.write(samples.data(), 3);
+	buffer.write(&samples[6], 37);
+	ASSERT_EQ(buffer.frames(), 16);
+	const int16_t* data = buffer.data();
+	for (size_t i = 0; i < 16; ++i) {
+		EXPECT_EQ(data[i * 2], 24 + int(i));
+		EXPECT_EQ(data[i * 2 + 1], -24 - int(i));
+	}
+}
+
+TEST(AudioBuffer, Mono) {
+	AudioBuffer buffer;
+	buffer.configure(1000, 60, 0, 1, 16);
+	EXPECT_EQ(buffer.channels(), 1);
+	int16_t samples[] = { 100, 300, -5, -6, 32767, 32767 };
+	buffer.begin();
+	buffer.write(samples, 3);
+	ASSERT_EQ(buffer.frames(), 3);
+	EXPECT_EQ(buffer.data()[0], 200);
+	EXPECT_EQ(buffer.data()[1], -6);
+	EXPECT_EQ(buffer.data()[2], 32767);
+}
+
+TEST(AudioBuffer, Resample) {
+	AudioBuffer buffer;
+	buffer.configure(1000, 10, 500);
+	EXPECT_EQ(buffer.rate(), 500);
+	vector<int16_t> samples = makeStereo(100);
+	buffer.begin();
+	buffer.write(samples.data(), 100);
+	ASSERT_EQ(buffer.frames(), 50);
+	for (size_t i = 0; i < 50; ++i) {
+		EXPECT_EQ(buffer.data()[i * 2], int(i * 2));
+	}
+
+	buffer.configure(1000, 10, 4000);
+	buffer.begin();
+	buffer.write(samples.data(), 3);
+	ASSERT_EQ(buffer.frames(), 8);
+	for (size_t i = 0; i < 8; ++i) {
+		EXPECT_EQ(buffer.data()[i * 2], int(i + 2) / 4);
+		EXPECT_EQ(buffer.data()[i * 2 + 1], -int(i + 2) / 4);
+	}
+}
+}
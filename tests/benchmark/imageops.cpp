@@ -0,0 +1,65 @@
+#include "imageops-kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace Retro;
+using namespace std;
+
+// Times each image kernel on a 320x224 frame for every kernel set available
+// on this host, e.g. ./benchmark-imageops 5000
+
+static const size_t W = 320;
+static const size_t H = 224;
+
+static double bench(int iterations, const function<void()>& kernel) {
+	kernel();
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		kernel();
+	}
+	chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main(int argc, char** argv) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+	vector<uint16_t> in565(W * H);
+	vector<uint32_t> inX888(W * H);
+	for (size_t i = 0; i < W * H; ++i) {
+		in565[i] = i * 2654435761U >> 7;
+		inX888[i] = i * 2654435761U;
+	}
+	vector<uint8_t> out(W * H * 3);
+
+	vector<const ImageOps::Kernels*> sets{ ImageOps::baseKernels() };
+	if (ImageOps::activeKernels() != ImageOps::baseKernels()) {
+		sets.emplace_back(ImageOps::activeKernels());
+	}
+
+	printf("%-24s", "kernel (us/frame)");
+	for (const auto* set : sets) {
+		printf("%10s", set->name);
+	}
+	printf("\n");
+
+	vector<pair<const char*, function<void(const ImageOps::Kernels*)>>> kernels{
+		{ "565To888", [&](const ImageOps::Kernels* k) { k->image565To888(in565.data(), out.data(), W, H, W * 2); } },
+		{ "X888To888", [&](const ImageOps::Kernels* k) { k->imageX888To888(inX888.data(), out.data(), W, H, W * 4); } },
+		{ "Halve565ToGray", [&](const ImageOps::Kernels* k) { k->imageHalve565ToGray(in565.data(), out.data(), W, H, W * 2); } },
+		{ "HalveX888ToGray", [&](const ImageOps::Kernels* k) { k->imageHalveX888ToGray(inX888.data(), out.data(), W, H, W * 4); } },
+		{ "Quarter565ToGray", [&](const ImageOps::Kernels* k) { k->imageQuarter565ToGray(in565.data(), out.data(), W, H, W * 2); } },
+		{ "QuarterX888ToGray", [&](const ImageOps::Kernels* k) { k->imageQuarterX888ToGray(inX888.data(), out.data(), W, H, W * 4); } },
+	};
+	for (const auto& kernel : kernels) {
+		printf("%-24s", kernel.first);
+		for (const auto* set : sets) {
+			printf("%10.2f", bench(iterations, [&]() { kernel.second(set); }));
+		}
+		printf("\n");
+	}
+	return 0;
+}
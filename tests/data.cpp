@@ -65,6 +65,25 @@ TEST(GameData, Manual2) {
 	EXPECT_THAT(data.listVariables(), UnorderedElementsAre(make_pair("foo", Variable(">n2", 0)), make_pair("bar", Variable(">n1", 1))));
 }
 
+TEST(GameData, LookupArray) {
+	GameData data;
+	uint8_t ram[] = { 1, 2 };
+	data.addressSpace().addBlock(0, sizeof(ram), ram);
+	data.updateRam();
+	data.setVariable("foo", {"|u1", 0});
+	data.setVariable("bar", {"|u1", 1});
+	data.setVariable("baz", {"|u1", 8});
+	const auto& names = data.variableNames();
+	ASSERT_EQ(names.size(), 3);
+
+	int64_t values[3];
+	data.lookupAll(values);
+	for (size_t i = 0; i < names.size(); ++i) {
+		EXPECT_EQ(data.variableSlot(names[i]), i);
+		EXPECT_EQ(values[i], names[i] == "baz" ? 0 : static_cast<int64_t>(data.lookupValue(names[i])));
+	}
+}
+
 TEST(GameData, Load) {
 	GameData data;
 	uint8_t ram[] = { 1 };
@@ -123,6 +142,48 @@ TEST(GameData, Delta) {
 	EXPECT_EQI(data.lookupDelta("foo"), 1);
 }
 
+TEST(GameData, DeltaRedefine) {
+	GameData data;
+	uint8_t ram[] = { 1, 5 };
+	data.addressSpace().addBlock(0, sizeof(ram), ram);
+	data.setVariable("foo", {"|u1", 0});
+	data.setVariable("bar", {"|u1", 1});
+	data.updateRam();
+	EXPECT_EQI(data.lookupDelta("foo"), 0);
+
+	ram[0] = 3;
+	data.updateRam();
+	data.setVariable("bar", {"|u1", 0});
+	EXPECT_EQI(data.lookupDelta("foo"), 2);
+	EXPECT_EQI(data.lookupDelta("bar"), 0);
+
+	ram[0] = 4;
+	data.updateRam();
+	EXPECT_EQI(data.lookupDelta("foo"), 1);
+	EXPECT_EQI(data.lookupDelta("bar"), 1);
+
+	data.removeVariable("bar");
+	EXPECT_EQI(data.lookupDelta("foo"), 1);
+	EXPECT_EQI(data.lookupDelta("bar"), 0);
+}
+
+TEST(GameData, DeltaFullHistory) {
+	GameData data;
+	data.setFullRamHistory(true);
+	uint8_t ram[] = { 1, 5 };
+	data.addressSpace().addBlock(0, sizeof(ram), ram);
+	data.updateRam();
+	ram[1] = 7;
+	data.updateRam();
+	data.setVariable("foo", {"|u1", 1});
+	EXPECT_EQI(data.lookupDelta("foo"), 2);
+
+	data.setFullRamHistory(false);
+	EXPECT_THROW(data.lookupDelta("foo"), out_of_range);
+	data.updateRam();
+	EXPECT_EQI(data.lookupDelta("foo"), 0);
+}
+
 TEST(Scenario, Measurement) {
 	EXPECT_EQ(Scenario::measurement("", M::ABSOLUTE), M::ABSOLUTE);
 	EXPECT_EQ(Scenario::measurement("", M::DELTA), M::DELTA);
@@ -394,6 +455,81 @@ TEST(Scenario, MultipleReward) {
 	EXPECT_FLOAT_EQ(scen.currentReward(), 4);
 }
 
+TEST(Scenario, DoneNodes) {
+	GameData data;
+	Scenario scen(data);
+
+	uint8_t ram[] = { 1, 1, 1 };
+	data.addressSpace().addBlock(0, sizeof(ram), ram);
+	data.setVariable("foo", {"|u1", 0});
+	data.setVariable("bar", {"|u1", 1});
+	data.setVariable("baz", {"|u1", 2});
+
+	auto node = make_shared<Scenario::DoneNode>();
+	node->vars.emplace("bar", Scenario::DoneSpec{ M::ABSOLUTE, O::ZERO, 0 });
+	node->vars.emplace("baz", Scenario::DoneSpec{ M::ABSOLUTE, O::ZERO, 0 });
+	node->condition = Scenario::DoneCondition::ALL;
+	scen.setDoneVariable("foo", { M::ABSOLUTE, O::ZERO, 0 });
+	scen.setDoneNode("both", node);
+
+	data.updateRam();
+	scen.update();
+	EXPECT_FALSE(scen.isDone());
+
+	ram[1] = 0;
+	data.updateRam();
+	scen.update();
+	EXPECT_FALSE(scen.isDone());
+
+	ram[2] = 0;
+	data.updateRam();
+	scen.update();
+	EXPECT_TRUE(scen.isDone());
+
+	scen.setDoneCondition(Scenario::DoneCondition::ALL);
+	scen.update();
+	EXPECT_FALSE(scen.isDone());
+
+	ram[0] = 0;
+	data.updateRam();
+	scen.update();
+	EXPECT_TRUE(scen.isDone());
+}
+
+TEST(Scenario, Recompile) {
+	GameData data;
+	Scenario scen(data);
+
+	uint8_t ram[] = { 1, 3 };
+	data.addressSpace().addBlock(0, sizeof(ram), ram);
+	data.setVariable("foo", {"|u1", 0});
+
+	scen.setRewardVariable("foo", { M::ABSOLUTE, O::NOOP, 0, 1, 0 });
+
+	data.updateRam();
+	scen.update();
+	EXPECT_FLOAT_EQ(scen.currentReward(), 1);
+
+	data.setVariable("foo", {"|u1", 1});
+	scen.update();
+	EXPECT_FLOAT_EQ(scen.currentReward(), 3);
+
+	data.setValue("qux", 2);
+	scen.setRewardVariable("qux", { M::ABSOLUTE, O::NOOP, 0, 1, 0 });
+	scen.update();
+	EXPECT_FLOAT_EQ(scen.currentReward(), 5);
+
+	data.restart();
+	EXPECT_THROW(scen.update(), invalid_argument);
+
+	data.setVariable("qux", {"|u1", 0});
+	scen.update();
+	EXPECT_FLOAT_EQ(scen.currentReward(), 4);
+
+	data.removeVariable("foo");
+	EXPECT_THROW(scen.update(), invalid_argument);
+}
+
 TEST(Scenario, LoadReward) {
 	GameData data;
 	Scenario scen(data);
@@ -111,6 +111,19 @@ TEST_P(EmulatorTest, Output) {
 	EXPECT_THAT(e.getAudioData(), NotNull());
 }
 
+TEST_P(EmulatorTest, SkipOutputs) {
+	const auto& param = GetParam();
+	Emulator e;
+	ASSERT_TRUE(e.loadRom("roms/" + param.rom));
+	e.run();
+	e.run(OUTPUT_RAM);
+	EXPECT_EQ(e.getAudioSamples(), 0);
+	EXPECT_THAT(e.getImageData(), NotNull());
+
+	e.run();
+	EXPECT_GT(e.getAudioSamples(), 0);
+}
+
 TEST_P(EmulatorTest, States) {
 	const auto& param = GetParam();
 	Emulator e;
@@ -129,6 +142,36 @@ TEST_P(EmulatorTest, States) {
 	e.run();
 }
 
+TEST_P(EmulatorTest, MultipleInstances) {
+	const auto& param = GetParam();
+	Emulator e;
+	Emulator f;
+	ASSERT_TRUE(e.loadRom("roms/" + param.rom));
+	ASSERT_TRUE(f.loadRom("roms/" + param.rom));
+	EXPECT_TRUE(e.isLoaded());
+	EXPECT_TRUE(f.isLoaded());
+	f.run();
+
+	vector<uint8_t> before(f.serializeSize());
+	ASSERT_TRUE(f.serialize(before.data(), before.size()));
+	for (int i = 0; i < 10; ++i) {
+		e.run();
+	}
+	vector<uint8_t> after(f.serializeSize());
+	ASSERT_TRUE(f.serialize(after.data(), after.size()));
+	EXPECT_EQ(before, after);
+
+	vector<uint8_t> v(e.serializeSize());
+	ASSERT_TRUE(e.serialize(v.data(), v.size()));
+	EXPECT_TRUE(f.unserialize(v.data(), v.size()));
+	f.run();
+
+	f.unloadCore();
+	e.run();
+	e.run();
+	EXPECT_GT(e.getAudioSamples(), 0);
+}
+
 vector<EmulatorTestParam> s_systems{
 	{ "Nes", "Dr88-FamiconIntro.nes" },
 	{ "Snes", "Anthrox-SineDotDemo.sfc" },
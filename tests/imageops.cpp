@@ -0,0 +1,314 @@
+#include "gtest/gtest.h"
+
+#include "imageops.h"
+#include "imageops-kernels.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace Retro {
+
+static vector<uint16_t> make565(size_t w, size_t h) {
+	vector<uint16_t> pixels(w * h);
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		pixels[i] = i * 2654435761U >> 7;
+	}
+	return pixels;
+}
+
+static vector<uint32_t> makeX888(size_t w, size_t h) {
+	vector<uint32_t> pixels(w * h);
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		pixels[i] = i * 2654435761U;
+	}
+	return pixels;
+}
+
+TEST(Image, Copy565To888) {
+	const size_t w = 37;
+	const size_t h = 5;
+	vector<uint16_t> in = make565(w, h);
+	vector<uint8_t> out(w * h * 3 + 1, 0xAA);
+	Image src(Image::Format::RGB565, in.data(), w, h, w * 2);
+	Image dst(Image::Format::RGB888, out.data(), w, h, w * 3);
+	src.copyTo(&dst);
+	for (size_t i = 0; i < w * h; ++i) {
+		EXPECT_EQ(out[i * 3], (in[i] & 0xF800) >> 8);
+		EXPECT_EQ(out[i * 3 + 1], (in[i] & 0x07E0) >> 3);
+		EXPECT_EQ(out[i * 3 + 2], (in[i] & 0x001F) << 3);
+	}
+	EXPECT_EQ(out.back(), 0xAA);
+}
+
+TEST(Image, CropX888To888) {
+	const size_t w = 40;
+	const size_t h = 8;
+	vector<uint32_t> in = makeX888(w, h);
+	Image src(Image::Format::RGBX888, in.data(), w, h, w * 4);
+	Image cropped = src.crop(3, 2, 21, 5);
+	EXPECT_EQ(cropped.width(), 21);
+	EXPECT_EQ(cropped.height(), 5);
+
+	vector<uint8_t> out(21 * 5 * 3);
+	Image dst(Image::Format::RGB888, out.data(), 21, 5, 21 * 3);
+	cropped.copyTo(&dst);
+	for (size_t y = 0; y < 5; ++y) {
+		for (size_t x = 0; x < 21; ++x) {
+			uint32_t pixel = in[(y + 2) * w + x + 3];
+			const uint8_t* rgb = &out[(y * 21 + x) * 3];
+			EXPECT_EQ(rgb[0], (pixel >> 16) & 0xFF);
+			EXPECT_EQ(rgb[1], (pixel >> 8) & 0xFF);
+			EXPECT_EQ(rgb[2], pixel & 0xFF);
+		}
+	}
+}
+
+TEST(Image, CropDirect) {
+	const size_t w = 20;
+	const size_t h = 6;
+	vector<uint16_t> in = make565(w, h);
+	Image src(Image::Format::RGB565, in.data(), w, h, w * 2);
+	vector<uint16_t> out(7 * 3);
+	Image dst(Image::Format::RGB565, out.data(), 7, 3, 7 * 2);
+	src.crop(5, 1, 7, 3).copyTo(&dst);
+	for (size_t y = 0; y < 3; ++y) {
+		for (size_t x = 0; x < 7; ++x) {
+			EXPECT_EQ(out[y * 7 + x], in[(y + 1) * w + x + 5]);
+		}
+	}
+	EXPECT_THROW(src.crop(15, 0, 6, 1), invalid_argument);
+	EXPECT_THROW(src.crop(0, 4, 1, 3), invalid_argument);
+}
+
+TEST(Image, ScaleToGray) {
+	const size_t w = 30;
+	const size_t h = 21;
+	vector<uint32_t> in = makeX888(w, h);
+	Image src(Image::Format::RGBX888, in.data(), w, h, w * 4);
+	vector<uint8_t> out(10 * 7);
+	Image dst(Image::Format::G8, out.data(), 10, 7, 10);
+	src.scaleTo(&dst);
+	for (size_t y = 0; y < 7; ++y) {
+		for (size_t x = 0; x < 10; ++x) {
+			unsigned sum = 0;
+			for (size_t sy = y * 3; sy < y * 3 + 3; ++sy) {
+				for (size_t sx = x * 3; sx < x * 3 + 3; ++sx) {
+					uint32_t pixel = in[sy * w + sx];
+					sum += (pixel & 0xFF) + ((pixel >> 8) & 0xFF) + ((pixel >> 16) & 0xFF);
+				}
+			}
+			EXPECT_EQ(out[y * 10 + x], sum / 36);
+		}
+	}
+}
+
+TEST(Image, ScaleToRGB) {
+	const size_t w = 8;
+	const size_t h = 4;
+	vector<uint16_t> in(w * h);
+	for (size_t i = 0; i < in.size(); ++i) {
+		in[i] = (i & 1) ? 0xF800 : 0x001F;
+	}
+	Image src(Image::Format::RGB565, in.data(), w, h, w * 2);
+	vector<uint8_t> out(4 * 2 * 3);
+	Image dst(Image::Format::RGB888, out.data(), 4, 2, 4 * 3);
+	src.scaleTo(&dst);
+	for (size_t i = 0; i < 8; ++i) {
+		EXPECT_EQ(out[i * 3], 0xF8 / 2);
+		EXPECT_EQ(out[i * 3 + 1], 0);
+		EXPECT_EQ(out[i * 3 + 2], 0xF8 / 2);
+	}
+
+	Image larger(Image::Format::RGB888, out.data(), w + 1, 1, (w + 1) * 3);
+	EXPECT_THROW(src.scaleTo(&larger), invalid_argument);
+}
+
+// Mean of R + G + B (gray) or of each channel over the source pixels an
+// output pixel covers
+static vector<uint8_t> areaAverage(const vector<uint32_t>& rgb, size_t w, size_t h, size_t ow, size_t oh, bool gray) {
+	vector<uint8_t> out;
+	for (size_t y = 0; y < oh; ++y) {
+		size_t y0 = y * h / oh;
+		size_t y1 = max((y + 1) * h / oh, y0 + 1);
+		for (size_t x = 0; x < ow; ++x) {
+			size_t x0 = x * w / ow;
+			size_t x1 = max((x + 1) * w / ow, x0 + 1);
+			unsigned sum[3]{};
+			for (size_t sy = y0; sy < y1; ++sy) {
+				for (size_t sx = x0; sx < x1; ++sx) {
+					uint32_t pixel = rgb[sy * w + sx];
+					sum[0] += (pixel >> 16) & 0xFF;
+					sum[1] += (pixel >> 8) & 0xFF;
+					sum[2] += pixel & 0xFF;
+				}
+			}
+			unsigned count = (y1 - y0) * (x1 - x0);
+			if (gray) {
+				out.push_back((sum[0] + sum[1] + sum[2]) / (count * 4));
+			} else {
+				for (unsigned c = 0; c < 3; ++c) {
+					out.push_back(sum[c] / count);
+				}
+			}
+		}
+	}
+	return out;
+}
+
+TEST(Image, ScaleAreaAverage) {
+	// Odd widths leave tails after the vector loops; exact halves and quarters
+	// must average the same way as every other size
+	const size_t w = 37;
+	const size_t h = 24;
+	vector<uint16_t> in565 = make565(w, h);
+	vector<uint32_t> inX888 = makeX888(w, h);
+	vector<uint32_t> rgb565(w * h);
+	for (size_t i = 0; i < rgb565.size(); ++i) {
+		rgb565[i] = ((in565[i] & 0xF800) << 8) | ((in565[i] & 0x07E0) << 5) | ((in565[i] & 0x001F) << 3);
+	}
+	Image src565(Image::Format::RGB565, in565.data(), w, h, w * 2);
+	Image srcX888(Image::Format::RGBX888, inX888.data(), w, h, w * 4);
+
+	for (auto size : vector<pair<size_t, size_t>>{ { 18, 12 }, { 9, 6 }, { 5, 5 }, { 36, 23 }, { 1, 1 } }) {
+		size_t ow = size.first;
+		size_t oh = size.second;
+		for (bool gray : { true, false }) {
+			size_t channels = gray ? 1 : 3;
+			vector<uint8_t> out(ow * oh * channels);
+			Image dst(gray ? Image::Format::G8 : Image::Format::RGB888, out.data(), ow, oh, ow * channels);
+			src565.scaleTo(&dst);
+			EXPECT_EQ(out, areaAverage(rgb565, w, h, ow, oh, gray)) << ow << "x" << oh << " 565";
+			srcX888.scaleTo(&dst);
+			EXPECT_EQ(out, areaAverage(inX888, w, h, ow, oh, gray)) << ow << "x" << oh << " X888";
+		}
+	}
+}
+
+TEST(Image, ScaleExactDivisors) {
+	// Exact halves and quarters go to the gray kernels; every kernel set has
+	// to match the area average, vector loops and tails alike
+	const size_t h = 16;
+	for (size_t w : { 8, 40, 64, 72, 136 }) {
+		// Padded rows, so strides differ from widths
+		size_t pitch = w + 4;
+		vector<uint16_t> in565 = make565(pitch, h);
+		vector<uint32_t> inX888 = makeX888(pitch, h);
+		vector<uint32_t> rgb565(w * h);
+		vector<uint32_t> rgbX888(w * h);
+		for (size_t y = 0; y < h; ++y) {
+			for (size_t x = 0; x < w; ++x) {
+				uint16_t pixel = in565[y * pitch + x];
+				rgb565[y * w + x] = ((pixel & 0xF800) << 8) | ((pixel & 0x07E0) << 5) | ((pixel & 0x001F) << 3);
+				rgbX888[y * w + x] = inX888[y * pitch + x];
+			}
+		}
+		Image src565(Image::Format::RGB565, in565.data(), w, h, pitch * 2);
+		Image srcX888(Image::Format::RGBX888, inX888.data(), w, h, pitch * 4);
+
+		for (size_t divisor : { 2, 4 }) {
+			size_t ow = w / divisor;
+			size_t oh = h / divisor;
+			vector<uint8_t> expected565 = areaAverage(rgb565, w, h, ow, oh, true);
+			vector<uint8_t> expectedX888 = areaAverage(rgbX888, w, h, ow, oh, true);
+			vector<uint8_t> out(ow * oh);
+			for (const ImageOps::Kernels* kernels : { ImageOps::baseKernels(), ImageOps::activeKernels() }) {
+				auto kernel565 = divisor == 2 ? kernels->imageHalve565ToGray : kernels->imageQuarter565ToGray;
+				auto kernelX888 = divisor == 2 ? kernels->imageHalveX888ToGray : kernels->imageQuarterX888ToGray;
+				kernel565(in565.data(), out.data(), w, h, pitch * 2);
+				EXPECT_EQ(out, expected565) << kernels->name << " " << w << "/" << divisor << " 565";
+				kernelX888(inX888.data(), out.data(), w, h, pitch * 4);
+				EXPECT_EQ(out, expectedX888) << kernels->name << " " << w << "/" << divisor << " X888";
+			}
+
+			Image dst(Image::Format::G8, out.data(), ow, oh, ow);
+			src565.scaleTo(&dst);
+			EXPECT_EQ(out, expected565) << w << "/" << divisor << " 565";
+			srcX888.scaleTo(&dst);
+			EXPECT_EQ(out, expectedX888) << w << "/" << divisor << " X888";
+		}
+	}
+}
+
+TEST(Image, Max565) {
+	const size_t w = 37;
+	const size_t h = 3;
+	vector<uint16_t> a = make565(w, h);
+	vector<uint16_t> b = make565(w, h + 1);
+	b.erase(b.begin(), b.begin() + w);
+	vector<uint16_t> out(w * h);
+	Image srcA(Image::Format::RGB565, a.data(), w, h, w * 2);
+	Image srcB(Image::Format::RGB565, b.data(), w, h, w * 2);
+	Image dst(Image::Format::RGB565, out.data(), w, h, w * 2);
+	srcA.maxTo(srcB, &dst);
+	for (size_t i = 0; i < w * h; ++i) {
+		EXPECT_EQ(out[i] & 0xF800, max(a[i] & 0xF800, b[i] & 0xF800));
+		EXPECT_EQ(out[i] & 0x07E0, max(a[i] & 0x07E0, b[i] & 0x07E0));
+		EXPECT_EQ(out[i] & 0x001F, max(a[i] & 0x001F, b[i] & 0x001F));
+	}
+}
+
+TEST(Image, MaxX888) {
+	const size_t w = 21;
+	const size_t h = 3;
+	vector<uint32_t> a = makeX888(w, h);
+	vector<uint32_t> b = makeX888(w, h + 1);
+	b.erase(b.begin(), b.begin() + w);
+	vector<uint32_t> out(w * h);
+	Image srcA(Image::Format::RGBX888, a.data(), w, h, w * 4);
+	Image srcB(Image::Format::RGBX888, b.data(), w, h, w * 4);
+	Image dst(Image::Format::RGBX888, out.data(), w, h, w * 4);
+	srcA.maxTo(srcB, &dst);
+	for (size_t i = 0; i < w * h; ++i) {
+		for (int shift = 0; shift < 24; shift += 8) {
+			EXPECT_EQ((out[i] >> shift) & 0xFF, max((a[i] >> shift) & 0xFF, (b[i] >> shift) & 0xFF));
+		}
+	}
+}
+
+class ImageKernelsTest : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(ImageKernelsTest, MatchBase) {
+	const ImageOps::Kernels* base = ImageOps::baseKernels();
+	const ImageOps::Kernels* avx2 = ImageOps::avx2Kernels();
+	if (!avx2 || ImageOps::activeKernels() != avx2) {
+		return;
+	}
+	size_t w = GetParam();
+	const size_t h = 12;
+	vector<uint16_t> in565 = make565(w, h);
+	vector<uint32_t> inX888 = makeX888(w, h);
+	vector<uint8_t> expected(w * h * 3);
+	vector<uint8_t> actual(w * h * 3);
+
+	base->image565To888(in565.data(), expected.data(), w, h, w * 2);
+	avx2->image565To888(in565.data(), actual.data(), w, h, w * 2);
+	EXPECT_EQ(expected, actual);
+
+	base->imageX888To888(inX888.data(), expected.data(), w, h, w * 4);
+	avx2->imageX888To888(inX888.data(), actual.data(), w, h, w * 4);
+	EXPECT_EQ(expected, actual);
+
+	w &= ~3;
+	expected.assign(w * h, 0);
+	actual.assign(w * h, 0);
+	base->imageHalve565ToGray(in565.data(), expected.data(), w, h, GetParam() * 2);
+	avx2->imageHalve565ToGray(in565.data(), actual.data(), w, h, GetParam() * 2);
+	EXPECT_EQ(expected, actual);
+
+	base->imageHalveX888ToGray(inX888.data(), expected.data(), w, h, GetParam() * 4);
+	avx2->imageHalveX888ToGray(inX888.data(), actual.data(), w, h, GetParam() * 4);
+	EXPECT_EQ(expected, actual);
+
+	base->imageQuarter565ToGray(in565.data(), expected.data(), w, h, GetParam() * 2);
+	avx2->imageQuarter565ToGray(in565.data(), actual.data(), w, h, GetParam() * 2);
+	EXPECT_EQ(expected, actual);
+
+	base->imageQuarterX888ToGray(inX888.data(), expected.data(), w, h, GetParam() * 4);
+	avx2->imageQuarterX888ToGray(inX888.data(), actual.data(), w, h, GetParam() * 4);
+	EXPECT_EQ(expected, actual);
+}
+
+INSTANTIATE_TEST_CASE_P(Widths, ImageKernelsTest, ::testing::Values(4, 16, 37, 64, 100, 160, 256, 320));
+}
@@ -1487,4 +1487,98 @@ TEST(DataTypeEncode, x01020304) {
 	EXPECT_THAT(mem, ElementsAre(3, 4, 1, 2));
 }
 
+TEST(AddressSpace, Lookup) {
+	uint8_t low[16];
+	uint8_t mid[16];
+	uint8_t high[8];
+	for (int i = 0; i < 16; ++i) {
+		low[i] = i;
+		mid[i] = 0x40 + i;
+	}
+	for (int i = 0; i < 8; ++i) {
+		high[i] = 0x80 + i;
+	}
+	AddressSpace mem;
+	mem.addBlock(0x100, sizeof(high), high);
+	mem.addBlock(0x10, sizeof(low), low);
+	mem.addBlock(0x18, sizeof(mid), mid);
+
+	EXPECT_FALSE(mem.hasBlock(0));
+	EXPECT_FALSE(mem.hasBlock(0xF));
+	EXPECT_TRUE(mem.hasBlock(0x10));
+	EXPECT_TRUE(mem.hasBlock(0x27));
+	EXPECT_FALSE(mem.hasBlock(0x28));
+	EXPECT_FALSE(mem.hasBlock(0xFF));
+	EXPECT_TRUE(mem.hasBlock(0x107));
+	EXPECT_FALSE(mem.hasBlock(0x108));
+
+	// Overlapping addresses belong to the block that starts lowest
+	EXPECT_EQ(mem[size_t(0x10)], 0);
+	EXPECT_EQ(mem[size_t(0x1F)], 0xF);
+	EXPECT_EQ(mem[size_t(0x20)], 0x48);
+	EXPECT_EQ(mem[size_t(0x104)], 0x84);
+	EXPECT_EQ(mem[size_t(0x11)], 1);
+	EXPECT_EQ(mem.block(0x20).offset(0), mid);
+	EXPECT_THROW(mem[size_t(0x28)], std::out_of_range);
+	EXPECT_THROW(mem.block(0x9), std::out_of_range);
+
+	EXPECT_EQ(mem[Variable(DataType(">u2"), 0x1E)], 0x0E0F);
+
+	mem.reset();
+	EXPECT_FALSE(mem.hasBlock(0x10));
+}
+
+TEST(AddressSpace, Gather) {
+	uint8_t low[4] = { 1, 2, 3, 4 };
+	uint8_t high[2] = { 5, 6 };
+	AddressSpace mem;
+	mem.addBlock(0x100, sizeof(high), high);
+	mem.addBlock(0x10, sizeof(low), low);
+	ASSERT_EQ(mem.totalSize(), 6);
+
+	uint8_t all[6];
+	mem.gather(all);
+	EXPECT_THAT(all, ElementsAre(1, 2, 3, 4, 5, 6));
+
+	size_t addresses[] = { 0x101, 0x10, 0x13 };
+	uint8_t some[3];
+	EXPECT_TRUE(mem.gather(addresses, 3, some));
+	EXPECT_THAT(some, ElementsAre(6, 1, 4));
+
+	addresses[1] = 0x14;
+	EXPECT_FALSE(mem.gather(addresses, 3, some));
+}
+
+TEST(AddressSpace, Compile) {
+	uint8_t data[32];
+	for (int i = 0; i < 32; ++i) {
+		data[i] = i * 37 + 0x89;
+	}
+	AddressSpace mem;
+	mem.addBlock(0x100, sizeof(data), data);
+	AddressSpace swapped;
+	swapped.addBlock(0x100, sizeof(data), data);
+	swapped.setOverlay(MemoryOverlay{ '=', '>', 2 });
+
+	for (const char* type : { "|u1", "|i1", "|d1", "|n1", ">u2", "<i2", ">d3", "<n4", ">u4", "<i4", "<d6", ">n8", ">i8", "<u8", "><u4", "<>u4" }) {
+		for (size_t address = 0x100; address + DataType(type).width <= 0x120; ++address) {
+			Variable var(type, address, address & 1 ? UINT64_MAX : 0x7F7F);
+			CompiledVariable compiled = mem.compile(var);
+			EXPECT_EQ(mem.read(compiled), mem[var]) << type << " " << address;
+			CompiledVariable compiledSwapped = swapped.compile(var);
+			EXPECT_EQ(swapped.read(compiledSwapped), swapped[var]) << type << " " << address;
+		}
+	}
+
+	// Compiled variables stay correct if the layout changes underneath them
+	CompiledVariable compiled = mem.compile(Variable(">u2", 0x104));
+	EXPECT_NE(compiled.decode, nullptr);
+	uint8_t other[8]{ 1, 2, 3, 4, 5, 6, 7, 8 };
+	mem.reset();
+	mem.addBlock(0x104, sizeof(other), other);
+	EXPECT_EQ(mem.read(compiled), 0x0102);
+	mem.reset();
+	EXPECT_THROW(mem.read(compiled), std::out_of_range);
+}
+
 }
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "coreinfo.h"
+#include "emulator.h"
+#include "movie-bk2.h"
+#include "movie-index.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace ::testing;
+
+namespace Retro {
+
+class MovieIndexTest : public Test {
+public:
+	virtual void SetUp() override;
+	virtual void TearDown() override;
+
+	vector<uint8_t> screen(Emulator&);
+
+	string rom = "roms/Dr88-FamiconIntro.nes";
+	string path;
+};
+
+void MovieIndexTest::SetUp() {
+	ifstream in("../retro/cores/fceumm.json");
+	ostringstream out;
+	Retro::corePath("../retro/cores");
+	out << in.rdbuf();
+	Retro::loadCoreInfo(out.str());
+	path = TempDir() + "movie-index-test.bk2";
+
+	Emulator e;
+	ASSERT_TRUE(e.loadRom(rom));
+	vector<uint8_t> state(e.serializeSize());
+	ASSERT_TRUE(e.serialize(state.data(), state.size()));
+	MovieBK2 movie(path, true, 1);
+	movie.loadKeymap("Nes");
+	movie.setState(state.data(), state.size());
+	for (unsigned f = 0; f < 300; ++f) {
+		movie.setKey(3, f % 40 == 5);
+		movie.setKey(8, f % 3 == 0);
+		movie.step();
+	}
+	movie.close();
+}
+
+void MovieIndexTest::TearDown() {
+	remove(path.c_str());
+	remove(MovieIndex::sidecarPath(path).c_str());
+}
+
+vector<uint8_t> MovieIndexTest::screen(Emulator& e) {
+	const uint8_t* data = static_cast<const uint8_t*>(e.getImageData());
+	return vector<uint8_t>(data, data + e.getImagePitch() * e.getImageHeight());
+}
+
+TEST_F(MovieIndexTest, Seek) {
+	Emulator e;
+	ASSERT_TRUE(e.loadRom(rom));
+	unique_ptr<Movie> movie = Movie::load(path);
+	ASSERT_TRUE(movie);
+
+	MovieIndex index;
+	ASSERT_TRUE(index.open(path, movie.get(), &e, {}, 64));
+	EXPECT_EQ(index.frames(), 300);
+	EXPECT_EQ(index.keyframes(), 5);
+	EXPECT_EQ(index.interval(), 64);
+
+	// Without the index, seeking replays from the start
+	ASSERT_TRUE(MovieIndex::seek(movie.get(), &e, 200));
+	vector<uint8_t> expected = screen(e);
+	ASSERT_TRUE(MovieIndex::seek(movie.get(), &e, 10, &index));
+	ASSERT_TRUE(MovieIndex::seek(movie.get(), &e, 200, &index));
+	EXPECT_EQ(screen(e), expected);
+	ASSERT_TRUE(movie->step());
+	EXPECT_EQ(movie->getKey(8), 200 % 3 == 0);
+	EXPECT_FALSE(MovieIndex::seek(movie.get(), &e, 301, &index));
+
+	// The sidecar is reused while the movie is unchanged
+	MovieIndex cached;
+	ASSERT_TRUE(cached.load(MovieIndex::sidecarPath(path), MovieIndex::hashFile(path)));
+	EXPECT_EQ(cached.keyframes(), 5);
+	size_t keyframe;
+	vector<uint8_t> a;
+	vector<uint8_t> b;
+	ASSERT_TRUE(index.getKeyframe(250, &keyframe, &a));
+	EXPECT_EQ(keyframe, 192);
+	ASSERT_TRUE(cached.getKeyframe(250, &keyframe, &b));
+	EXPECT_EQ(a, b);
+	EXPECT_FALSE(cached.load(MovieIndex::sidecarPath(path), MovieIndex::hashFile(path) + 1));
+}
+}
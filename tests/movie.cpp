@@ -0,0 +1,291 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "coreinfo.h"
+#include "movie-bk2.h"
+#include "movie-index.h"
+#include "movie-rmv.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+using namespace ::testing;
+
+namespace Retro {
+
+class MovieTest : public Test {
+public:
+	virtual void SetUp() override;
+	virtual void TearDown() override;
+
+	string path;
+};
+
+void MovieTest::SetUp() {
+	loadCoreInfo(R"({"Nes": {
+		"lib": "fceumm",
+		"ext": ["nes"],
+		"buttons": ["B", null, "SELECT", "START", "UP", "DOWN", "LEFT", "RIGHT", "A"]
+	}})");
+	path = TempDir() + "movie-test.bk2";
+	remove(path.c_str());
+}
+
+void MovieTest::TearDown() {
+	remove(path.c_str());
+}
+
+static bool pressed(unsigned frame, int key, unsigned player) {
+	return (frame * 7 + key * 3 + player) % 5 < 2;
+}
+
+TEST_F(MovieTest, BK2RoundTrip) {
+	const unsigned frames = 500;
+	vector<uint8_t> state(3000);
+	for (size_t i = 0; i < state.size(); ++i) {
+		state[i] = i * 13;
+	}
+	{
+		MovieBK2 movie(path, true, 2);
+		movie.loadKeymap("Nes");
+		movie.setGameName("Test");
+		movie.setState(state.data(), state.size());
+		for (unsigned f = 0; f < frames; ++f) {
+			for (unsigned p = 0; p < 2; ++p) {
+				for (int k = 0; k < 9; ++k) {
+					movie.setKey(k, pressed(f, k, p), p);
+				}
+			}
+			ASSERT_TRUE(movie.step());
+		}
+		movie.close();
+	}
+
+	unique_ptr<Movie> movie = Movie::load(path);
+	ASSERT_TRUE(movie);
+	EXPECT_EQ(movie->players(), 2);
+	EXPECT_EQ(movie->getGameName(), "Test");
+	vector<uint8_t> loaded;
+	ASSERT_TRUE(movie->getState(&loaded));
+	EXPECT_EQ(loaded, state);
+	for (unsigned f = 0; f < frames; ++f) {
+		ASSERT_TRUE(movie->step());
+		for (unsigned p = 0; p < 2; ++p) {
+			for (int k = 0; k < 9; ++k) {
+				// Index 1 has no button, so it can't be recorded
+				EXPECT_EQ(movie->getKey(k, p), k != 1 && pressed(f, k, p)) << "frame " << f << " key " << k;
+			}
+		}
+	}
+	EXPECT_FALSE(movie->step());
+}
+
+TEST_F(MovieTest, BK2Log) {
+	{
+		MovieBK2 movie(path, true, 1);
+		movie.loadKeymap("Nes");
+		movie.setKey(0, true);
+		movie.setKey(8, true);
+		movie.step();
+		movie.step();
+		movie.close();
+	}
+	Zip zip(path);
+	ASSERT_TRUE(zip.open());
+	Zip::File* log = zip.openFile("Input Log.txt");
+	ASSERT_TRUE(log);
+	string line;
+	vector<string> lines;
+	while (log->readline(&line)) {
+		lines.push_back(line);
+	}
+	ASSERT_EQ(lines.size(), 5);
+	EXPECT_EQ(lines[0], "[Input]");
+	EXPECT_EQ(lines[2].size(), 13);
+	EXPECT_EQ(count(lines[2].begin(), lines[2].end(), 'A'), 1);
+	EXPECT_EQ(count(lines[2].begin(), lines[2].end(), 'B'), 1);
+	EXPECT_EQ(lines[3], "|..|........|");
+	EXPECT_EQ(lines[4], "[/Input]");
+}
+
+TEST_F(MovieTest, BK2Seek) {
+	{
+		MovieBK2 movie(path, true, 2);
+		movie.loadKeymap("Nes");
+		vector<uint8_t> state(16, 1);
+		movie.setState(state.data(), state.size());
+		for (unsigned f = 0; f < 300; ++f) {
+			for (unsigned p = 0; p < 2; ++p) {
+				movie.setKey(8, pressed(f, 8, p), p);
+				movie.setKey(4, pressed(f, 4, p), p);
+			}
+			movie.step();
+		}
+		EXPECT_EQ(movie.frames(), 300);
+		EXPECT_FALSE(movie.seek(0));
+		movie.close();
+	}
+
+	unique_ptr<Movie> movie = Movie::load(path);
+	ASSERT_TRUE(movie);
+	for (unsigned f = 0; f < 10; ++f) {
+		ASSERT_TRUE(movie->step());
+	}
+	EXPECT_EQ(movie->frames(), 300);
+	for (unsigned start : { 250, 0, 10, 299, 300 }) {
+		ASSERT_TRUE(movie->seek(start));
+		for (unsigned f = start; f < min(start + 20, 300u); ++f) {
+			ASSERT_TRUE(movie->step());
+			EXPECT_EQ(movie->getKey(8, 1), pressed(f, 8, 1)) << "frame " << f;
+			EXPECT_EQ(movie->getKey(4, 0), pressed(f, 4, 0)) << "frame " << f;
+		}
+	}
+	EXPECT_FALSE(movie->step());
+	EXPECT_FALSE(movie->seek(301));
+}
+
+TEST_F(MovieTest, IndexSidecar) {
+	EXPECT_EQ(MovieIndex::sidecarPath("a/b.bk2"), "a/b.bk2.idx");
+	{
+		MovieBK2 movie(path, true, 1);
+		movie.loadKeymap("Nes");
+		movie.step();
+		movie.close();
+	}
+	uint64_t hash = MovieIndex::hashFile(path);
+	EXPECT_NE(hash, MovieIndex::hashFile(path + ".missing"));
+	char name[32];
+	snprintf(name, sizeof(name), "cache/%016llx.idx", static_cast<unsigned long long>(hash));
+	EXPECT_EQ(MovieIndex::sidecarPath(path, "cache"), name);
+
+	// Sidecars are rejected unless they are well-formed and match the movie
+	MovieIndex index;
+	string sidecar = MovieIndex::sidecarPath(path);
+	EXPECT_FALSE(index.load(sidecar, hash));
+	{
+		ofstream out(sidecar, ios::binary);
+		out << "RMI1 not really an index";
+	}
+	EXPECT_FALSE(index.load(sidecar, hash));
+	EXPECT_EQ(index.keyframes(), 0);
+	remove(sidecar.c_str());
+}
+
+static vector<uint8_t> fakeState(unsigned frame) {
+	vector<uint8_t> state(4096, 0x55);
+	for (unsigned i = 0; i < 16; ++i) {
+		state[(frame * 31 + i * 97) % state.size()] = frame + i;
+	}
+	return state;
+}
+
+static void recordRMV(const string& path, unsigned frames, unsigned interval) {
+	MovieRMV movie(path, true, 2, interval);
+	ASSERT_TRUE(movie.ok());
+	movie.setGameName("Test");
+	movie.setPlatform("Nes");
+	vector<uint8_t> initial = fakeState(0);
+	movie.setState(initial.data(), initial.size());
+	for (unsigned f = 0; f < frames; ++f) {
+		if (movie.wantsKeyframe()) {
+			vector<uint8_t> state = fakeState(f);
+			movie.addKeyframe(state.data(), state.size());
+		}
+		for (unsigned p = 0; p < 2; ++p) {
+			for (int k = 0; k < 9; ++k) {
+				movie.setKey(k, k != 1 && pressed(f, k, p), p);
+			}
+		}
+		ASSERT_TRUE(movie.step());
+	}
+	movie.close();
+}
+
+TEST_F(MovieTest, RMVSeek) {
+	path = TempDir() + "movie-test.rmv";
+	recordRMV(path, 1000, 64);
+
+	unique_ptr<Movie> movie = Movie::load(path);
+	ASSERT_TRUE(movie);
+	EXPECT_EQ(movie->players(), 2);
+	EXPECT_EQ(movie->frames(), 1000);
+	EXPECT_EQ(movie->getGameName(), "Test");
+	EXPECT_EQ(movie->getPlatform(), "Nes");
+	vector<uint8_t> state;
+	ASSERT_TRUE(movie->getState(&state));
+	EXPECT_EQ(state, fakeState(0));
+
+	size_t keyframe;
+	for (size_t frame : { 0, 63, 64, 65, 500, 999, 1000 }) {
+		ASSERT_TRUE(movie->getKeyframe(frame, &keyframe, &state));
+		EXPECT_EQ(keyframe, frame / 64 * 64);
+		EXPECT_EQ(state, fakeState(keyframe));
+	}
+
+	ASSERT_TRUE(movie->seek(777));
+	for (unsigned f = 777; f < 1000; ++f) {
+		ASSERT_TRUE(movie->step());
+		EXPECT_EQ(movie->getKey(8, 1), pressed(f, 8, 1));
+		EXPECT_EQ(movie->getKey(3, 0), pressed(f, 3, 0));
+	}
+	EXPECT_FALSE(movie->step());
+	EXPECT_FALSE(movie->seek(1001));
+}
+
+TEST_F(MovieTest, RMVConvert) {
+	string rmv = TempDir() + "movie-test.rmv";
+	string copy = TempDir() + "movie-test-copy.rmv";
+	recordRMV(rmv, 300, 100);
+	ASSERT_TRUE(MovieRMV::convert(rmv, path));
+	ASSERT_TRUE(MovieRMV::convert(path, copy));
+
+	unique_ptr<Movie> original = Movie::load(rmv);
+	unique_ptr<Movie> bk2 = Movie::load(path);
+	unique_ptr<Movie> converted = Movie::load(copy);
+	ASSERT_TRUE(original && bk2 && converted);
+	EXPECT_EQ(bk2->getGameName(), "Test");
+	EXPECT_EQ(converted->getPlatform(), "Nes");
+	EXPECT_EQ(converted->frames(), 300);
+	vector<uint8_t> a;
+	vector<uint8_t> b;
+	ASSERT_TRUE(original->getState(&a));
+	ASSERT_TRUE(converted->getState(&b));
+	EXPECT_EQ(a, b);
+	for (unsigned f = 0; f < 300; ++f) {
+		ASSERT_TRUE(original->step());
+		ASSERT_TRUE(bk2->step());
+		ASSERT_TRUE(converted->step());
+		for (unsigned p = 0; p < 2; ++p) {
+			for (int k = 0; k < 16; ++k) {
+				EXPECT_EQ(bk2->getKey(k, p), original->getKey(k, p));
+				EXPECT_EQ(converted->getKey(k, p), original->getKey(k, p));
+			}
+		}
+	}
+	EXPECT_FALSE(converted->step());
+
+	// Keyframes survive an RMV to RMV copy
+	ASSERT_TRUE(MovieRMV::convert(rmv, copy));
+	converted = Movie::load(copy);
+	size_t keyframe;
+	ASSERT_TRUE(converted->getKeyframe(250, &keyframe, &a));
+	EXPECT_EQ(keyframe, 200);
+	EXPECT_EQ(a, fakeState(200));
+	remove(rmv.c_str());
+	remove(copy.c_str());
+}
+
+TEST_F(MovieTest, RMVCorrupt) {
+	path = TempDir() + "movie-test.rmv";
+	recordRMV(path, 100, 10);
+	FILE* f = fopen(path.c_str(), "r+b");
+	ASSERT_TRUE(f);
+	// Point the input block past the end of the file
+	fseek(f, 47, SEEK_SET);
+	fputc(0x7F, f);
+	fclose(f);
+	EXPECT_FALSE(Movie::load(path));
+}
+}
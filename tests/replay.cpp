@@ -0,0 +1,124 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "coreinfo.h"
+#include "movie-bk2.h"
+#include "replay.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+using namespace ::testing;
+
+namespace Retro {
+
+class ReplayTest : public Test {
+public:
+	virtual void SetUp() override;
+
+	// Records frames of alternating A presses from a fresh boot
+	bool record(const string& path, unsigned frames);
+
+	string rom = "roms/Dr88-FamiconIntro.nes";
+	string prefix;
+};
+
+void ReplayTest::SetUp() {
+	ifstream in("../retro/cores/fceumm.json");
+	ostringstream out;
+	Retro::corePath("../retro/cores");
+	out << in.rdbuf();
+	Retro::loadCoreInfo(out.str());
+	prefix = TempDir() + "replay-test";
+}
+
+bool ReplayTest::record(const string& path, unsigned frames) {
+	Emulator e;
+	if (!e.loadRom(rom)) {
+		return false;
+	}
+	vector<uint8_t> state(e.serializeSize());
+	if (!e.serialize(state.data(), state.size())) {
+		return false;
+	}
+	MovieBK2 movie(path, true, 1);
+	movie.loadKeymap("Nes");
+	movie.setGameName("Test");
+	movie.setState(state.data(), state.size());
+	for (unsigned f = 0; f < frames; ++f) {
+		movie.setKey(8, f & 1);
+		movie.step();
+	}
+	movie.close();
+	return true;
+}
+
+static string readHeader(const string& path) {
+	ifstream in(path, ios::binary);
+	string header(128, '\0');
+	in.read(&header[0], header.size());
+	return header;
+}
+
+TEST_F(ReplayTest, MissingFiles) {
+	Replay replay(2);
+	vector<Replay::Result> results = replay.run({ { "missing.bk2", rom, prefix }, { "missing.fm2", rom, prefix } });
+	ASSERT_EQ(results.size(), 2);
+	for (const auto& result : results) {
+		EXPECT_FALSE(result.ok);
+		EXPECT_THAT(result.error, Not(IsEmpty()));
+		EXPECT_THAT(result.shards, IsEmpty());
+	}
+}
+
+TEST_F(ReplayTest, Shards) {
+	string movie = TempDir() + "replay-test.bk2";
+	ASSERT_TRUE(record(movie, 251));
+
+	Replay replay(2);
+	replay.setChunkFrames(100);
+	replay.setFormat(Replay::Format::NPY);
+	replay.setOutputs(OUTPUT_VIDEO);
+	vector<Replay::Result> results = replay.run({ { movie, rom, prefix + "-a" }, { movie, rom, prefix + "-b" } });
+	ASSERT_EQ(results.size(), 2);
+	for (const auto& result : results) {
+		ASSERT_TRUE(result.ok) << result.error;
+		// The first frame only provides the first observation
+		EXPECT_EQ(result.frames, 250);
+		ASSERT_EQ(result.shards.size(), 3);
+
+		string header = readHeader(result.shards[2] + ".actions.npy");
+		EXPECT_EQ(header.compare(0, 6, "\x93NUMPY"), 0);
+		EXPECT_THAT(header, HasSubstr("'descr': '|b1'"));
+		EXPECT_THAT(header, HasSubstr("'shape': (50, 1, 9)"));
+		EXPECT_THAT(readHeader(result.shards[0] + ".obs.npy"), HasSubstr("'shape': (100, 224, 240, 3)"));
+		EXPECT_THAT(readHeader(result.shards[0] + ".frame.npy"), HasSubstr("'shape': (100,)"));
+
+		ifstream in(result.shards[0] + ".actions.npy", ios::binary | ios::ate);
+		size_t size = in.tellg();
+		EXPECT_EQ(size % 64, 100 * 9 % 64);
+		in.seekg(size - 100 * 9);
+		vector<char> actions(100 * 9);
+		in.read(actions.data(), actions.size());
+		for (unsigned f = 0; f < 100; ++f) {
+			EXPECT_EQ(actions[f * 9 + 8], (f + 1) & 1);
+		}
+	}
+
+	// Both workers replay the same inputs, so they see the same screens
+	ifstream a(results[0].shards[1] + ".obs.npy", ios::binary);
+	ifstream b(results[1].shards[1] + ".obs.npy", ios::binary);
+	EXPECT_TRUE(equal(istreambuf_iterator<char>(a), istreambuf_iterator<char>(), istreambuf_iterator<char>(b)));
+
+	for (const auto& result : results) {
+		for (const auto& shard : result.shards) {
+			for (const char* array : { "frame", "actions", "obs" }) {
+				remove((shard + "." + array + ".npy").c_str());
+			}
+		}
+	}
+	remove(movie.c_str());
+}
+}
@@ -908,4 +908,143 @@ INSTANTIATE_DELTA_TEST_CASE(GreaterGreaterOffset,
 	}
 )
 
+TEST(Search, LongBlocks) {
+	vector<uint8_t> low(40, 0xFF);
+	vector<uint8_t> high(70, 0xFF);
+	low[5] = 0x12;
+	low[17] = 0x12;
+	high[15] = 0x34;
+	high[16] = 0x12;
+	high[69] = 0x12;
+	AddressSpace mem;
+	mem.addBlock(0, low.size(), static_cast<void*>(low.data()));
+	mem.addBlock(0x100, high.size(), static_cast<void*>(high.data()));
+
+	Search search({ "|u1", ">u2" });
+	search.search(mem, 0x12);
+	EXPECT_THAT(search.typedResults(), ElementsAre(
+		TypedSearchResult({ 5, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 17, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x110, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x145, 1, 1, 0 }, DataType("|u1"))));
+
+	search = Search({ ">u2", "<u2" });
+	search.search(mem, 0x3412);
+	EXPECT_THAT(search.typedResults(), ElementsAre(TypedSearchResult({ 0x10F, 1, 1, 0 }, DataType(">u2"))));
+}
+
+TEST(Search, LongDelta) {
+	vector<uint8_t> before(100, 0x10);
+	vector<uint8_t> after = before;
+	after[3] = 0x11;
+	after[50] = 0x0F;
+	after[98] = 0x20;
+	AddressSpace mem;
+	AddressSpace oldMem;
+	mem.addBlock(0x100, after.size(), static_cast<void*>(after.data()));
+	oldMem.addBlock(0x100, before.size(), static_cast<void*>(before.data()));
+
+	Search search({ "|u1", "<u2", ">u2" });
+	search.delta(mem, oldMem, Operation::POSITIVE, 0);
+	EXPECT_THAT(search.typedResults(), ElementsAre(
+		TypedSearchResult({ 0x102, 1, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x102, 1, 1, 0 }, DataType(">u2")),
+		TypedSearchResult({ 0x103, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x103, 1, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x103, 1, 1, 0 }, DataType(">u2")),
+		TypedSearchResult({ 0x161, 1, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x161, 1, 1, 0 }, DataType(">u2")),
+		TypedSearchResult({ 0x162, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x162, 1, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x162, 1, 1, 0 }, DataType(">u2"))));
+
+	search = Search({ "|u1", "<u2", ">u2" });
+	search.delta(mem, oldMem, Operation::NEGATIVE, 0);
+	search.delta(mem, oldMem, Operation::EQUAL, -1);
+	EXPECT_THAT(search.typedResults(), ElementsAre(
+		TypedSearchResult({ 0x131, 1, 1, 0 }, DataType(">u2")),
+		TypedSearchResult({ 0x132, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x132, 1, 1, 0 }, DataType("<u2"))));
+	EXPECT_THAT(search.validTypes(), ElementsAre(DataType("|u1"), DataType("<u2"), DataType(">u2")));
+}
+
+TEST(Search, StuffRemove) {
+	Search search({ "|u1", "<u2" });
+	search.stuff({
+		TypedSearchResult({ 0x20, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x10, 2, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType(">u4")),
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x20, 1, 1, 0 }, DataType("|u1")) });
+	EXPECT_EQ(search.numResults(), 4);
+	EXPECT_THAT(search.typedResults(), ElementsAre(
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType(">u4")),
+		TypedSearchResult({ 0x10, 2, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x20, 1, 1, 0 }, DataType("|u1"))));
+	EXPECT_EQ(search.typedResult(2), TypedSearchResult({ 0x10, 2, 1, 0 }, DataType("<u2")));
+
+	search.remove({
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType(">u4")),
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x30, 1, 1, 0 }, DataType("|u1")) });
+	EXPECT_THAT(search.typedResults(), ElementsAre(
+		TypedSearchResult({ 0x10, 1, 1, 0 }, DataType("|u1")),
+		TypedSearchResult({ 0x10, 2, 1, 0 }, DataType("<u2")),
+		TypedSearchResult({ 0x20, 1, 1, 0 }, DataType("|u1"))));
+	EXPECT_THAT(search.results(), ElementsAre(
+		SearchResult{ 0x10, 1, 1, 0 },
+		SearchResult{ 0x10, 2, 1, 0 },
+		SearchResult{ 0x20, 1, 1, 0 }));
+}
+
+TEST(Search, CandidateSet) {
+	CandidateSet a;
+	CandidateSet b;
+	for (size_t address = 0; address < 5000; address += 3) {
+		a.insert(address, 0);
+		a.insert(address + 1, 1);
+	}
+	a.insert(0x100000, 0);
+	a.insert(0x100000, 0);
+	EXPECT_EQ(a.size(), 3335);
+	EXPECT_TRUE(a.contains(0x100000, 0));
+	EXPECT_FALSE(a.contains(0x100000, 1));
+	EXPECT_FALSE(a.contains(1, 0));
+
+	for (size_t address = 0; address < 5000; address += 2) {
+		b.insert(address, 0);
+		b.insert(address, 1);
+	}
+	a.intersect(b);
+	EXPECT_EQ(a.size(), 1667);
+	EXPECT_TRUE(a.contains(0, 0));
+	EXPECT_TRUE(a.contains(4, 1));
+	EXPECT_FALSE(a.contains(3, 0));
+	EXPECT_FALSE(a.contains(0x100000, 0));
+
+	CandidateSet c;
+	c.insert(0, 0);
+	c.insert(4, 1);
+	c.insert(7, 1);
+	a.difference(c);
+	EXPECT_EQ(a.size(), 1665);
+	EXPECT_FALSE(a.contains(0, 0));
+
+	// Ties are ordered by rank, so form 1 comes first at each address
+	vector<uint32_t> rank{ 1, 0 };
+	vector<CandidateSet::Candidate> visited;
+	a.forEach(rank, [&](const CandidateSet::Candidate& candidate) {
+		visited.emplace_back(candidate);
+		return visited.size() < 4;
+	});
+	EXPECT_THAT(visited, ElementsAre(Pair(6, 0), Pair(10, 1), Pair(12, 0), Pair(16, 1)));
+
+	CandidateSet::Candidate candidate;
+	ASSERT_TRUE(a.at(3, rank, &candidate));
+	EXPECT_EQ(candidate, CandidateSet::Candidate(16, 1));
+	ASSERT_TRUE(a.at(1664, rank, &candidate));
+	EXPECT_EQ(candidate, CandidateSet::Candidate(4998, 0));
+	EXPECT_FALSE(a.at(1665, rank, &candidate));
+}
 }
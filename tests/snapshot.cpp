@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include "snapshot.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace Retro {
+
+static vector<uint8_t> makeState(size_t size, uint8_t seed) {
+	vector<uint8_t> state(size);
+	for (size_t i = 0; i < size; ++i) {
+		state[i] = (i * 131 + seed) >> 3;
+	}
+	return state;
+}
+
+TEST(SnapshotPool, RoundTrip) {
+	SnapshotPool pool(64, 4);
+	vector<uint8_t> state = makeState(1000, 1);
+	auto handle = pool.save(state.data(), state.size());
+	EXPECT_TRUE(pool.valid(handle));
+	EXPECT_EQ(pool.size(handle), state.size());
+	EXPECT_EQ(pool.snapshots(), 1);
+
+	vector<uint8_t> out(state.size());
+	ASSERT_TRUE(pool.load(handle, out.data(), out.size()));
+	EXPECT_EQ(out, state);
+	EXPECT_FALSE(pool.load(handle, out.data(), out.size() - 1));
+	EXPECT_FALSE(pool.load(handle + 1, out.data(), out.size()));
+}
+
+TEST(SnapshotPool, SharesPages) {
+	SnapshotPool pool(64, 4);
+	vector<uint8_t> state = makeState(640, 7);
+	auto first = pool.save(state.data(), state.size());
+	size_t pages = pool.pagesUsed();
+	EXPECT_EQ(pages, 10);
+
+	state[100] ^= 0xFF;
+	auto second = pool.save(state.data(), state.size());
+	EXPECT_EQ(pool.pagesUsed(), pages + 1);
+
+	// Identical pages are found even when they move to another offset
+	vector<uint8_t> shifted(state.begin() + 64, state.end());
+	shifted.insert(shifted.end(), state.begin(), state.begin() + 64);
+	auto third = pool.save(shifted.data(), shifted.size());
+	EXPECT_EQ(pool.pagesUsed(), pages + 1);
+
+	vector<uint8_t> out(state.size());
+	ASSERT_TRUE(pool.load(second, out.data(), out.size()));
+	EXPECT_EQ(out, state);
+	ASSERT_TRUE(pool.load(third, out.data(), out.size()));
+	EXPECT_EQ(out, shifted);
+	ASSERT_TRUE(pool.load(first, out.data(), out.size()));
+	state[100] ^= 0xFF;
+	EXPECT_EQ(out, state);
+}
+
+TEST(SnapshotPool, Release) {
+	SnapshotPool pool(64, 4);
+	vector<uint8_t> a = makeState(300, 1);
+	vector<uint8_t> b = makeState(300, 2);
+	auto first = pool.save(a.data(), a.size());
+	auto second = pool.save(b.data(), b.size());
+	size_t reserved = pool.bytesReserved();
+
+	pool.release(first);
+	EXPECT_FALSE(pool.valid(first));
+	EXPECT_TRUE(pool.valid(second));
+	EXPECT_EQ(pool.snapshots(), 1);
+	EXPECT_EQ(pool.pagesUsed(), 5);
+
+	for (int i = 0; i < 10; ++i) {
+		auto handle = pool.save(a.data(), a.size());
+		EXPECT_EQ(handle, first);
+		pool.release(handle);
+	}
+	EXPECT_EQ(pool.bytesReserved(), reserved);
+
+	vector<uint8_t> out(b.size());
+	ASSERT_TRUE(pool.load(second, out.data(), out.size()));
+	EXPECT_EQ(out, b);
+}
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+
+#include "statedelta.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace Retro {
+
+static vector<uint8_t> makeState(size_t size) {
+	vector<uint8_t> state(size);
+	for (size_t i = 0; i < size; ++i) {
+		state[i] = i * 2654435761U >> 13;
+	}
+	return state;
+}
+
+static vector<uint8_t> roundTrip(const vector<uint8_t>& base, const vector<uint8_t>& state) {
+	vector<uint8_t> delta;
+	encodeStateDelta(base.data(), base.size(), state.data(), state.size(), &delta);
+	vector<uint8_t> out;
+	EXPECT_TRUE(applyStateDelta(base.data(), base.size(), delta.data(), delta.size(), &out));
+	return out;
+}
+
+TEST(StateDelta, Identical) {
+	vector<uint8_t> base = makeState(10000);
+	vector<uint8_t> delta;
+	encodeStateDelta(base.data(), base.size(), base.data(), base.size(), &delta);
+	EXPECT_LT(delta.size(), 16);
+	EXPECT_EQ(roundTrip(base, base), base);
+}
+
+TEST(StateDelta, SparseChanges) {
+	vector<uint8_t> base = makeState(10000);
+	vector<uint8_t> state = base;
+	for (size_t i : { 0, 1, 5, 17, 4000, 4003, 4020, 9999 }) {
+		state[i] ^= 0x5A;
+	}
+	vector<uint8_t> delta;
+	encodeStateDelta(base.data(), base.size(), state.data(), state.size(), &delta);
+	EXPECT_LT(delta.size(), 100);
+	EXPECT_EQ(roundTrip(base, state), state);
+}
+
+TEST(StateDelta, SizeChange) {
+	vector<uint8_t> base = makeState(1000);
+	vector<uint8_t> longer = makeState(1300);
+	vector<uint8_t> shorter(base.begin(), base.begin() + 700);
+	EXPECT_EQ(roundTrip(base, longer), longer);
+	EXPECT_EQ(roundTrip(base, shorter), shorter);
+	EXPECT_EQ(roundTrip({}, base), base);
+	vector<uint8_t> zeroTail = base;
+	zeroTail.resize(1500);
+	EXPECT_EQ(roundTrip(base, zeroTail), zeroTail);
+}
+
+TEST(StateDelta, Invalid) {
+	vector<uint8_t> base = makeState(1000);
+	vector<uint8_t> state = base;
+	state[500] = ~state[500];
+	vector<uint8_t> delta;
+	encodeStateDelta(base.data(), base.size(), state.data(), state.size(), &delta);
+
+	vector<uint8_t> out;
+	EXPECT_FALSE(applyStateDelta(base.data(), base.size() - 1, delta.data(), delta.size(), &out));
+	EXPECT_FALSE(applyStateDelta(base.data(), base.size(), delta.data(), 3, &out));
+	EXPECT_FALSE(applyStateDelta(base.data(), base.size(), delta.data(), delta.size() - 1, &out));
+	delta[0] = 'X';
+	EXPECT_FALSE(applyStateDelta(base.data(), base.size(), delta.data(), delta.size(), &out));
+
+	// A size larger than the delta could describe is rejected before allocating
+	vector<uint8_t> huge{ 'R', 'D', 'L', '1', 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0xE8, 0x07 };
+	EXPECT_FALSE(applyStateDelta(base.data(), base.size(), huge.data(), huge.size(), &out));
+}
+}
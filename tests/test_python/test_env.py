@@ -1,5 +1,7 @@
+import json
 import os
 
+import numpy as np
 import pytest
 
 import retro
@@ -36,13 +38,30 @@ def generate_test_env(request):
 
     yield create
 
-    created_env[0].close()
+    for env in created_env:
+        env.close()
     del created_env
 
     retro.data.get_file_path = get_file_path_fn
     retro.data.get_romfile_path = get_romfile_path_fn
 
 
+@pytest.fixture(
+    params=sorted(os.listdir(os.path.join(os.path.dirname(__file__), "../roms"))),
+)
+def rom_path(request):
+    return os.path.join(os.path.dirname(__file__), "../roms", request.param)
+
+
+def load_emulator(rom, scenario):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    data = retro.data.GameData()
+    emulator = retro.RetroEmulator(rom)
+    emulator.configure_data(data)
+    assert data.load(json_path, scenario)
+    return emulator, data
+
+
 def test_env_create(generate_test_env):
     json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
     assert generate_test_env(info=json_path, scenario=json_path)
@@ -87,3 +106,215 @@ def test_env_data(generate_test_env):
     with pytest.raises(KeyError):
         val = env.data["foo"]
         assert val
+
+
+def test_vec_emulator(rom_path, tmp_path):
+    system = retro.get_romfile_system(rom_path)
+    buttons = len(retro.get_system_info(system)["buttons"])
+    scenario = tmp_path / "scenario.json"
+    scenario.write_text(
+        json.dumps(
+            {
+                "reward": {"variables": {system: {"reward": 1.0}}},
+                "done": {"variables": {system: {"op": "greater-than", "reference": 128}}},
+            },
+        ),
+    )
+    vec_envs = [load_emulator(rom_path, str(scenario)) for _ in range(2)]
+    ref_envs = [load_emulator(rom_path, str(scenario)) for _ in range(2)]
+    vec = retro.VecRetroEmulator(
+        [emulator for emulator, _ in vec_envs],
+        [data for _, data in vec_envs],
+    )
+    assert vec.num_envs() == 2
+
+    rng = np.random.default_rng(0)
+    for _ in range(60):
+        actions = rng.integers(0, 2, (2, 1, buttons), dtype=np.uint8)
+        obs, rewards, dones = vec.step(actions)
+        for i, (emulator, data) in enumerate(ref_envs):
+            emulator.set_button_mask(actions[i, 0], 0)
+            ref_rewards, ref_done = emulator.step(data=data)
+            assert np.array_equal(obs[i], emulator.get_screen())
+            assert rewards[i, 0] == ref_rewards[0]
+            assert dones[i] == ref_done
+
+
+def test_vec_emulator_scripts(rom_path, tmp_path):
+    (tmp_path / "script.lua").write_text("function reward()\n    return 1\nend\n")
+    scenario = tmp_path / "scenario.json"
+    scenario.write_text(
+        json.dumps({"reward": {"script": "lua:reward"}, "scripts": ["script.lua"]}),
+    )
+    envs = [load_emulator(rom_path, str(scenario)) for _ in range(2)]
+
+    # Script contexts are shared, so they can't follow more than one emulator
+    with pytest.raises(RuntimeError):
+        retro.VecRetroEmulator([emulator for emulator, _ in envs], [data for _, data in envs])
+
+    vec = retro.VecRetroEmulator([envs[0][0]], [envs[0][1]])
+    _, rewards, _ = vec.step(np.zeros((1, 1, 0), np.uint8))
+    assert rewards[0, 0] == 1
+
+
+def test_lookup_array_custom_values(rom_path):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    _, data = load_emulator(rom_path, json_path)
+    data.update_ram()
+    values = data.lookup_array()
+    assert len(values) == len(data.variable_index())
+
+    # Custom values have no array slot, so the array can't hold them
+    data.set_value("custom", 3)
+    with pytest.raises(RuntimeError):
+        data.lookup_array()
+
+
+
+def reward_scenario(generate_test_env, tmp_path):
+    # The dummy data maps one byte per system, named after it
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    system = generate_test_env(info=json_path, scenario=json_path, render_mode=None).system
+    scenario = tmp_path / "scenario.json"
+    scenario.write_text(json.dumps({"reward": {"variables": {system: {"reward": 1}}}}))
+    return str(scenario)
+
+
+def area_average(screen, size, grayscale):
+    # Mean over the source pixels each output pixel covers. Gray is the sum of
+    # R + G + B over four times the area, like the native conversion.
+    h, w = screen.shape[:2]
+    oh, ow = size
+    out = np.empty(size if grayscale else size + (3,), np.uint8)
+    for y in range(oh):
+        y0 = y * h // oh
+        y1 = max((y + 1) * h // oh, y0 + 1)
+        for x in range(ow):
+            x0 = x * w // ow
+            x1 = max((x + 1) * w // ow, x0 + 1)
+            block = screen[y0:y1, x0:x1].astype(np.int64)
+            area = (y1 - y0) * (x1 - x0)
+            if grayscale:
+                out[y, x] = block.sum() // (area * 4)
+            else:
+                out[y, x] = block.sum(axis=(0, 1)) // area
+    return out
+
+
+@pytest.mark.parametrize("max_pool", [False, True])
+def test_env_frame_skip(max_pool, generate_test_env, tmp_path):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    scenario = reward_scenario(generate_test_env, tmp_path)
+    env = generate_test_env(
+        info=json_path,
+        scenario=scenario,
+        render_mode="rgb_array",
+        frame_skip=4,
+        max_pool=max_pool,
+    )
+    ref = generate_test_env(info=json_path, scenario=scenario, render_mode="rgb_array")
+    env.reset()
+    ref.reset()
+    env.action_space.seed(0)
+
+    for _ in range(30):
+        action = env.action_space.sample()
+        obs, rew, terminated, _, _ = env.step(action)
+        screens = []
+        total = 0
+        for _ in range(4):
+            screen, ref_rew, ref_terminated, _, _ = ref.step(action)
+            screens.append(screen)
+            total += ref_rew
+        assert rew == total
+        assert terminated == ref_terminated
+        if max_pool:
+            np.testing.assert_array_equal(obs, np.maximum(screens[-2], screens[-1]))
+        else:
+            np.testing.assert_array_equal(obs, screens[-1])
+
+
+@pytest.mark.parametrize("grayscale", [False, True])
+def test_env_obs_size(grayscale, generate_test_env):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    size = (50, 60)
+    env = generate_test_env(
+        info=json_path,
+        scenario=json_path,
+        render_mode="rgb_array",
+        obs_size=size,
+        grayscale=grayscale,
+        frame_stack=3,
+    )
+    ref = generate_test_env(info=json_path, scenario=json_path, render_mode="rgb_array")
+    obs, _ = env.reset()
+    screen, _ = ref.reset()
+    env.action_space.seed(0)
+
+    # The stack starts out filled with the first frame
+    frames = [area_average(screen, size, grayscale)] * 3
+    assert obs in env.observation_space
+    np.testing.assert_array_equal(obs, np.stack(frames))
+    for _ in range(10):
+        action = env.action_space.sample()
+        obs = env.step(action)[0]
+        screen = ref.step(action)[0]
+        frames = frames[1:] + [area_average(screen, size, grayscale)]
+        np.testing.assert_array_equal(obs, np.stack(frames))
+
+
+def test_env_info_array(generate_test_env):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    env = generate_test_env(
+        info=json_path,
+        scenario=json_path,
+        render_mode="rgb_array",
+        info_array=True,
+    )
+    ref = generate_test_env(info=json_path, scenario=json_path, render_mode="rgb_array")
+    env.reset()
+    ref.reset()
+    env.action_space.seed(0)
+    index = env.data.variable_index()
+
+    for _ in range(30):
+        action = env.action_space.sample()
+        values = env.step(action)[4]["variables"]
+        info = ref.step(action)[4]
+        assert len(values) == len(index)
+        # Variables outside mapped memory are left out of the dict and read as 0
+        assert set(info) <= set(index)
+        for name, i in index.items():
+            assert values[i] == info.get(name, 0)
+
+
+def test_env_get_ram(generate_test_env):
+    json_path = os.path.join(os.path.dirname(__file__), "../dummy.json")
+    env = generate_test_env(
+        info=json_path,
+        scenario=json_path,
+        render_mode=None,
+        obs_type=retro.Observations.RAM,
+    )
+    ram, _ = env.reset()
+    env.action_space.seed(0)
+
+    for _ in range(10):
+        blocks = env.data.memory.blocks
+        expected = np.concatenate(
+            [np.frombuffer(blocks[offset], np.uint8) for offset in sorted(blocks)],
+        )
+        np.testing.assert_array_equal(ram, expected)
+
+        # Gathering single addresses reads the same bytes as the blocks
+        addresses = []
+        picked = []
+        for offset in sorted(blocks):
+            for i in (0, len(blocks[offset]) - 1):
+                addresses.append(offset + i)
+                picked.append(blocks[offset][i])
+        out = np.empty(len(addresses), np.uint8)
+        env.data.memory.gather(out, np.array(addresses))
+        assert list(out) == picked
+
+        ram = env.step(env.action_space.sample())[0]
@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+
+#include "threadpool.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace Retro {
+
+TEST(ThreadPool, Serial) {
+	ThreadPool pool(1);
+	EXPECT_EQ(pool.size(), 1);
+	vector<int> out(16);
+	pool.parallelFor(out.size(), [&out](size_t i) { out[i] = i * 2; });
+	for (size_t i = 0; i < out.size(); ++i) {
+		EXPECT_EQ(out[i], i * 2);
+	}
+}
+
+TEST(ThreadPool, Parallel) {
+	ThreadPool pool(4);
+	EXPECT_EQ(pool.size(), 4);
+	for (int round = 0; round < 50; ++round) {
+		vector<int> out(round + 1);
+		atomic<int> calls{ 0 };
+		pool.parallelFor(out.size(), [&](size_t i) {
+			out[i] = i + round;
+			++calls;
+		});
+		EXPECT_EQ(calls, out.size());
+		for (size_t i = 0; i < out.size(); ++i) {
+			EXPECT_EQ(out[i], i + round);
+		}
+	}
+	pool.parallelFor(0, [](size_t) { FAIL(); });
+}
+
+TEST(ThreadPool, Exception) {
+	ThreadPool pool(4);
+	atomic<int> calls{ 0 };
+	EXPECT_THROW(pool.parallelFor(8, [&calls](size_t i) {
+		++calls;
+		if (i == 3) {
+			throw runtime_error("job failed");
+		}
+	}),
+		runtime_error);
+	EXPECT_EQ(calls, 8);
+	pool.parallelFor(8, [&calls](size_t) { ++calls; });
+	EXPECT_EQ(calls, 16);
+}
+}
@@ -0,0 +1,147 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "zipfile.h"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace std;
+using namespace ::testing;
+
+namespace Retro {
+
+class ZipTest : public Test {
+public:
+	virtual void SetUp() override;
+	virtual void TearDown() override;
+
+	void write(const string& name, const string& contents, int level = Zip::DEFAULT_COMPRESSION);
+	size_t archiveSize();
+
+	string path;
+};
+
+void ZipTest::SetUp() {
+	path = TempDir() + "zip-test.zip";
+	remove(path.c_str());
+}
+
+void ZipTest::TearDown() {
+	remove(path.c_str());
+}
+
+void ZipTest::write(const string& name, const string& contents, int level) {
+	Zip zip(path);
+	ASSERT_TRUE(zip.open(true));
+	zip.setCompression(level);
+	Zip::File* file = zip.openFile(name, true);
+	ASSERT_TRUE(file);
+	EXPECT_EQ(file->write(contents.data(), contents.size()), contents.size());
+	zip.close();
+}
+
+size_t ZipTest::archiveSize() {
+	ifstream in(path, ios::binary | ios::ate);
+	return in.tellg();
+}
+
+static string lines(size_t count) {
+	string text;
+	for (size_t i = 0; i < count; ++i) {
+		text += "|..|" + to_string(i) + (i % 2 ? "\r\n" : "\n");
+	}
+	return text;
+}
+
+TEST_F(ZipTest, Readline) {
+	// Enough lines to span several read-ahead refills
+	const size_t count = 50000;
+	write("log.txt", lines(count) + "last");
+
+	Zip zip(path);
+	ASSERT_TRUE(zip.open());
+	Zip::File* file = zip.openFile("log.txt");
+	ASSERT_TRUE(file);
+	string line;
+	for (size_t i = 0; i < count; ++i) {
+		ASSERT_TRUE(file->readline(&line));
+		ASSERT_EQ(line, "|..|" + to_string(i));
+	}
+	EXPECT_TRUE(file->readline(&line));
+	EXPECT_EQ(line, "last");
+	EXPECT_FALSE(file->readline(&line));
+	EXPECT_EQ(line, "");
+}
+
+TEST_F(ZipTest, ReadMixed) {
+	string text = lines(100000);
+	write("log.txt", text);
+
+	Zip zip(path);
+	ASSERT_TRUE(zip.open());
+	Zip::File* file = zip.openFile("log.txt");
+	ASSERT_TRUE(file);
+	EXPECT_EQ(file->size(), text.size());
+
+	// Lines, small reads and reads larger than the read-ahead all interleave
+	EXPECT_EQ(file->readline(), "|..|0");
+	size_t offset = 6;
+	char small[3];
+	ASSERT_EQ(file->read(small, sizeof(small)), sizeof(small));
+	EXPECT_EQ(string(small, sizeof(small)), text.substr(offset, sizeof(small)));
+	offset += sizeof(small);
+	vector<char> large(Zip::File::READ_AHEAD * 2 + 5);
+	ASSERT_EQ(file->read(large.data(), large.size()), large.size());
+	EXPECT_EQ(string(large.begin(), large.end()), text.substr(offset, large.size()));
+	offset += large.size();
+
+	vector<uint8_t> rest;
+	ASSERT_TRUE(file->readAll(&rest));
+	EXPECT_EQ(string(rest.begin(), rest.end()), text.substr(offset));
+	EXPECT_EQ(file->read(small, sizeof(small)), 0);
+}
+
+TEST_F(ZipTest, ReadAll) {
+	string contents(300000, '\0');
+	for (size_t i = 0; i < contents.size(); ++i) {
+		contents[i] = i * 7 % 251;
+	}
+	write("Core.bin", contents);
+
+	Zip zip(path);
+	ASSERT_TRUE(zip.open());
+	Zip::File* file = zip.openFile("Core.bin");
+	ASSERT_TRUE(file);
+	vector<uint8_t> data;
+	ASSERT_TRUE(file->readAll(&data));
+	EXPECT_EQ(string(data.begin(), data.end()), contents);
+	// Known sizes are read into a single exact allocation
+	EXPECT_EQ(data.capacity(), contents.size() + 1);
+}
+
+TEST_F(ZipTest, Compression) {
+	string contents = lines(20000);
+	write("log.txt", contents, Zip::STORE);
+	size_t stored = archiveSize();
+	EXPECT_GT(stored, contents.size());
+
+	remove(path.c_str());
+	write("log.txt", contents, Zip::BEST_SPEED);
+	size_t fast = archiveSize();
+	EXPECT_LT(fast, stored / 2);
+
+	remove(path.c_str());
+	write("log.txt", contents, Zip::BEST_COMPRESSION);
+	EXPECT_LE(archiveSize(), fast);
+
+	// Every level reads back the same
+	Zip zip(path);
+	ASSERT_TRUE(zip.open());
+	Zip::File* file = zip.openFile("log.txt");
+	ASSERT_TRUE(file);
+	vector<uint8_t> data;
+	ASSERT_TRUE(file->readAll(&data));
+	EXPECT_EQ(string(data.begin(), data.end()), contents);
+}
+}